@@ -0,0 +1,217 @@
+// APClient: inbound commands, data package indexing and render_json
+//
+// Frames are fed through APClient::inject_message, so nothing touches the
+// network. The client is set up like the fetcher's: a slot connected to a
+// room of 8 players, with handlers that copy what they get, and a data
+// package that is kept in memory only.
+//
+// Each iteration also pays for one copy of the frame, the same as a frame
+// handed over by wswrap.
+
+#include <benchmark/benchmark.h>
+#include <apclient.hpp>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr int64_t ITEM_BASE = 3860000;
+constexpr int64_t LOCATION_BASE = 3870000;
+constexpr int PLAYERS = 8;
+
+const char* const GAME = "Pokemon Emerald";
+
+class MemoryDataPackageStore final : public APDataPackageStore {
+public:
+    bool load(const std::string&, const std::string&, json&) override
+    {
+        return false;
+    }
+
+    bool save(const std::string&, const json&) override
+    {
+        return true;
+    }
+};
+
+std::string make_data_package_frame(int games, int entries)
+{
+    std::string frame = R"([{"cmd":"DataPackage","data":{"games":{)";
+    for (int g = 0; g < games; ++g) {
+        if (g) frame += ',';
+        std::string game = g ? "Game " + std::to_string(g) : GAME;
+        frame += "\"" + game + R"(":{"item_name_to_id":{)";
+        for (int i = 0; i < entries; ++i) {
+            if (i) frame += ',';
+            frame += "\"Item " + std::to_string(i) + "\":" + std::to_string(ITEM_BASE + i);
+        }
+        frame += R"(},"location_name_to_id":{)";
+        for (int i = 0; i < entries; ++i) {
+            if (i) frame += ',';
+            frame += "\"Location " + std::to_string(i) + "\":" + std::to_string(LOCATION_BASE + i);
+        }
+        frame += R"(},"checksum":"checksum)" + std::to_string(g) + "\"}";
+    }
+    frame += "}}}]";
+    return frame;
+}
+
+std::string make_connected_frame(int locations)
+{
+    std::string checked, missing;
+    for (int i = 0; i < locations; ++i) {
+        std::string& list = (i % 2) ? missing : checked;
+        if (!list.empty()) list += ',';
+        list += std::to_string(LOCATION_BASE + i);
+    }
+    std::string players, slot_info;
+    for (int p = 1; p <= PLAYERS; ++p) {
+        if (p > 1) {
+            players += ',';
+            slot_info += ',';
+        }
+        players += R"({"team":0,"slot":)" + std::to_string(p) + R"(,"alias":"Player)" + std::to_string(p)
+                   + R"(","name":"Player)" + std::to_string(p) + "\"}";
+        slot_info += "\"" + std::to_string(p) + R"(":{"name":"Player)" + std::to_string(p) + R"(","game":")"
+                     + GAME + R"(","type":1,"group_members":[]})";
+    }
+    return R"([{"cmd":"Connected","team":0,"slot":1,"players":[)" + players + R"(],"missing_locations":[)"
+           + missing + R"(],"checked_locations":[)" + checked + R"(],"slot_data":{"goal":0},"slot_info":{)"
+           + slot_info + R"(},"hint_points":0}])";
+}
+
+std::string make_print_json_frame()
+{
+    return R"([{"cmd":"PrintJSON","type":"ItemSend","receiving":2,)"
+           R"("item":{"item":3860042,"location":3870042,"player":1,"flags":1},)"
+           R"("data":[{"type":"player_id","text":"1"},{"text":" sent "},)"
+           R"({"type":"item_id","text":"3860042","player":2,"flags":1},{"text":" to "},)"
+           R"({"type":"player_id","text":"2"},{"text":" ("},)"
+           R"x({"type":"location_id","text":"3870042","player":1},{"text":")"}]}])x";
+}
+
+std::string make_received_items_frame(int count)
+{
+    std::string frame = R"([{"cmd":"ReceivedItems","index":0,"items":[)";
+    for (int i = 0; i < count; ++i) {
+        if (i) frame += ',';
+        frame += R"({"item":)" + std::to_string(ITEM_BASE + i % 500) + R"(,"location":)"
+                 + std::to_string(LOCATION_BASE + i) + R"(,"player":)" + std::to_string(1 + i % PLAYERS)
+                 + R"(,"flags":)" + std::to_string(i % 3) + "}";
+    }
+    return frame + "]}]";
+}
+
+std::string make_frame(const std::string& cmd)
+{
+    if (cmd == "ReceivedItems")
+        return make_received_items_frame(1);
+    if (cmd == "ReceivedItems_bulk")
+        return make_received_items_frame(1000);
+    if (cmd == "PrintJSON")
+        return make_print_json_frame();
+    if (cmd == "RoomUpdate")
+        return R"([{"cmd":"RoomUpdate","checked_locations":[3870001],"hint_points":3}])";
+    if (cmd == "Bounced")
+        return R"([{"cmd":"Bounced","tags":["DeathLink"],"data":{"time":1700000000.5,"source":"Player2","cause":"fell"}}])";
+    if (cmd == "SetReply")
+        return R"([{"cmd":"SetReply","key":"_read_hints_0_1","value":[],"original_value":[],"slot":1}])";
+    if (cmd == "Retrieved")
+        return R"([{"cmd":"Retrieved","keys":{"_read_hints_0_1":[],"_read_client_status_0_1":10}}])";
+    if (cmd == "Connected")
+        return make_connected_frame(1000);
+    return "";
+}
+
+struct Client {
+    MemoryDataPackageStore store;
+    std::unique_ptr<APClient> client;
+    std::vector<APClient::NetworkItem> items;
+    std::list<int64_t> checked;
+    size_t events = 0;
+
+    Client()
+    {
+        client.reset(new APClient("bench", GAME, "", "", &store)); // no uri: never connects
+        client->set_items_received_handler([this](const std::list<APClient::NetworkItem>& received) {
+            items.insert(items.end(), received.begin(), received.end());
+        });
+        client->set_location_checked_handler([this](const std::list<int64_t>& locations) {
+            checked = locations;
+        });
+        client->set_print_json_handler([this](const APClient::PrintJSONArgs& args) {
+            events += args.data.size();
+        });
+        client->set_bounced_handler([this](const json& data) {
+            events += data.size();
+        });
+        client->set_set_reply_handler([this](const json& data) {
+            events += data.size();
+        });
+        client->set_retrieved_handler([this](const std::map<std::string, json>& keys) {
+            events += keys.size();
+        });
+        client->inject_message(make_data_package_frame(1, 500));
+        client->inject_message(make_connected_frame(1000));
+    }
+};
+
+void BM_OnMessage(benchmark::State& state, const char* cmd)
+{
+    Client c;
+    const std::string frame = make_frame(cmd);
+    for (auto _ : state) {
+        c.client->inject_message(frame);
+        if (c.items.size() > 100000)
+            c.items.clear();
+    }
+    benchmark::DoNotOptimize(c.events);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+
+// DataPackage: args are the number of games and the number of items (and locations) per game
+void BM_DataPackage(benchmark::State& state)
+{
+    Client c;
+    const std::string frame = make_data_package_frame(static_cast<int>(state.range(0)),
+                                                      static_cast<int>(state.range(1)));
+    for (auto _ : state) {
+        c.client->inject_message(frame);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+
+void BM_RenderJson(benchmark::State& state)
+{
+    Client c;
+    const json frame = json::parse(make_print_json_frame());
+    std::list<APClient::TextNode> msg;
+    for (const auto& node : frame[0]["data"]) {
+        msg.push_back(APClient::TextNode::from_json(node));
+    }
+    const auto fmt = static_cast<APClient::RenderFormat>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(c.client->render_json(msg, fmt));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(msg.size()));
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_OnMessage, ReceivedItems,      "ReceivedItems");
+BENCHMARK_CAPTURE(BM_OnMessage, ReceivedItems_bulk, "ReceivedItems_bulk");
+BENCHMARK_CAPTURE(BM_OnMessage, PrintJSON,          "PrintJSON");
+BENCHMARK_CAPTURE(BM_OnMessage, RoomUpdate,         "RoomUpdate");
+BENCHMARK_CAPTURE(BM_OnMessage, Bounced,            "Bounced");
+BENCHMARK_CAPTURE(BM_OnMessage, SetReply,           "SetReply");
+BENCHMARK_CAPTURE(BM_OnMessage, Retrieved,          "Retrieved");
+BENCHMARK_CAPTURE(BM_OnMessage, Connected,          "Connected");
+BENCHMARK(BM_DataPackage)->Args({1, 300})->Args({1, 5000})->Args({20, 5000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RenderJson)
+    ->Arg(static_cast<int>(APClient::RenderFormat::TEXT))
+    ->Arg(static_cast<int>(APClient::RenderFormat::ANSI));
@@ -0,0 +1,124 @@
+// permessage-deflate settings: bytes on the wire and memory per connection
+//
+// Runs a session's worth of server frames (one large DataPackage, then many
+// small PrintJSON/ReceivedItems frames) through wswrap's deflate_codec the way
+// the websocket processor does: compress, strip the 00 00 ff ff tail, and on
+// the receiving side inflate with the tail appended again.
+//
+// Args: window bits (both directions), mem level, no context takeover.
+
+#include <benchmark/benchmark.h>
+#include <wswrap_deflate.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const WORDS[] = {
+    "Route", "Cave", "Forest", "Tower", "Island", "Hidden", "Item", "Ball", "Potion",
+    "Rare", "Candy", "Gym", "Badge", "Trainer", "North", "South", "Floor", "Room",
+};
+
+std::string make_name(uint32_t n)
+{
+    std::string name;
+    for (int i = 0; i < 3; ++i) {
+        if (i) name += ' ';
+        name += WORDS[(n >> (i * 4)) % (sizeof(WORDS) / sizeof(WORDS[0]))];
+    }
+    return name + " " + std::to_string(n);
+}
+
+std::vector<std::string> make_session()
+{
+    std::vector<std::string> frames;
+
+    std::string dp = R"([{"cmd":"DataPackage","data":{"games":{"Pokemon Emerald":{"item_name_to_id":{)";
+    for (uint32_t i = 0; i < 5000; ++i) {
+        if (i) dp += ',';
+        dp += "\"" + make_name(i) + "\":" + std::to_string(3860000 + i);
+    }
+    dp += R"(},"location_name_to_id":{)";
+    for (uint32_t i = 0; i < 5000; ++i) {
+        if (i) dp += ',';
+        dp += "\"" + make_name(i * 7 + 3) + "\":" + std::to_string(3870000 + i);
+    }
+    dp += R"(},"checksum":"0123456789abcdef"}}}}])";
+    frames.push_back(dp);
+
+    for (uint32_t i = 0; i < 500; ++i) {
+        frames.push_back(R"([{"cmd":"PrintJSON","type":"ItemSend","receiving":)" + std::to_string(i % 8)
+                         + R"(,"item":{"item":)" + std::to_string(3860000 + i) + R"(,"location":)"
+                         + std::to_string(3870000 + i) + R"(,"player":1,"flags":1},"data":[{"type":"player_id","text":"1"},)"
+                         + R"({"text":" sent "},{"type":"item_id","text":")" + std::to_string(3860000 + i)
+                         + R"(","player":2,"flags":1},{"text":" to "},{"type":"player_id","text":"2"}]}])");
+        frames.push_back(R"([{"cmd":"ReceivedItems","index":)" + std::to_string(i)
+                         + R"(,"items":[{"item":)" + std::to_string(3860000 + i) + R"(,"location":)"
+                         + std::to_string(3870000 + i) + R"(,"player":1,"flags":0}]}])");
+    }
+    return frames;
+}
+
+void BM_DeflateSession(benchmark::State& state)
+{
+    const int window_bits = static_cast<int>(state.range(0));
+    const int mem_level = static_cast<int>(state.range(1));
+    const bool no_context_takeover = state.range(2) != 0;
+    static const std::vector<std::string> frames = make_session();
+    static const uint8_t tail[4] = {0x00, 0x00, 0xff, 0xff};
+
+    size_t raw_bytes = 0;
+    size_t wire_bytes = 0;
+    size_t sender_memory = 0;
+    size_t receiver_memory = 0;
+    for (auto _ : state) {
+        wswrap::deflate_codec sender;
+        wswrap::deflate_codec receiver;
+        if (!sender.init(window_bits, window_bits, mem_level, no_context_takeover)
+                || !receiver.init(window_bits, window_bits, mem_level, no_context_takeover)) {
+            state.SkipWithError("zlib init failed");
+            return;
+        }
+        raw_bytes = wire_bytes = 0;
+        std::string wire, out;
+        for (const auto& frame : frames) {
+            wire.clear();
+            out.clear();
+            sender.compress(frame, wire);
+            wire.resize(wire.size() - 4);
+            if (!receiver.decompress(reinterpret_cast<const uint8_t*>(wire.data()), wire.size(), out)
+                    || !receiver.decompress(tail, sizeof(tail), out) || out.size() != frame.size()) {
+                state.SkipWithError("round trip failed");
+                return;
+            }
+            raw_bytes += frame.size();
+            wire_bytes += wire.size();
+        }
+        sender_memory = sender.memory_usage();
+        receiver_memory = receiver.memory_usage();
+    }
+    state.counters["raw_bytes"] = static_cast<double>(raw_bytes);
+    state.counters["wire_bytes"] = static_cast<double>(wire_bytes);
+    state.counters["ratio"] = static_cast<double>(wire_bytes) / static_cast<double>(raw_bytes);
+    // a client connection holds one compressor and one decompressor
+    state.counters["conn_memory"] = static_cast<double>(sender_memory + receiver_memory) / 2;
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(raw_bytes));
+}
+
+void deflate_settings(benchmark::internal::Benchmark* b)
+{
+    for (int window_bits : {9, 12, 15}) {
+        for (int mem_level : {1, 4, 8}) {
+            for (int no_context_takeover : {0, 1}) {
+                b->Args({window_bits, mem_level, no_context_takeover});
+            }
+        }
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_DeflateSession)->Apply(deflate_settings)->Unit(benchmark::kMillisecond);
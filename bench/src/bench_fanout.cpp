@@ -0,0 +1,138 @@
+// Event fan-out to subscribed bots (fetcher.fanout)
+//
+// Publish measures what the network thread pays per event with N subscribers
+// connected, and the counters what reaches them: one reader thread drains every
+// socket, the way N bots on the same machine would. The time to empty the queues
+// after the loop counts in delivered_Bps. SerializePerSubscriber is the cost the
+// fan-out avoids: one dump() of the event per subscriber.
+
+#include <benchmark/benchmark.h>
+#include <fanout.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using nlohmann::json;
+
+json items_event()
+{
+    json items = json::array();
+    for (int i = 0; i < 3; i++) {
+        items.push_back({
+            {"index", 100 + i},
+            {"item", 3860346},
+            {"location", 3870000 + i},
+            {"player", 2},
+            {"flags", 1},
+            {"item_name", "HM08 Dive"},
+            {"location_name", "Route 124 - Hidden Item Under The Bridge"},
+            {"from_player", "TheLovenityJade"},
+            {"key", true},
+        });
+    }
+    return {{"items", items}, {"item_count", 103}};
+}
+
+int connect_subscriber(const std::string& path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct Readers {
+    std::vector<int> fds;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> bytes{0};
+    std::thread thread;
+
+    void run()
+    {
+        std::vector<pollfd> polled;
+        for (int fd : fds)
+            polled.push_back({fd, POLLIN, 0});
+        char buf[65536];
+        while (!stop.load()) {
+            if (::poll(polled.data(), polled.size(), 50) <= 0)
+                continue;
+            for (const pollfd& p : polled) {
+                if (!(p.revents & POLLIN))
+                    continue;
+                ssize_t n = ::recv(p.fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (n > 0)
+                    bytes += (uint64_t)n;
+            }
+        }
+    }
+};
+
+void BM_Fanout_Publish(benchmark::State& state)
+{
+    const std::string path = "/tmp/ap_bench_fanout_" + std::to_string(::getpid()) + ".sock";
+    fanout::Config config;
+    if (!fanout::start(path, config)) {
+        state.SkipWithError("unable to create the socket");
+        return;
+    }
+    Readers readers;
+    for (int i = 0; i < state.range(0); i++)
+        readers.fds.push_back(connect_subscriber(path));
+    // attendre que le serveur les ait tous acceptés
+    while (fanout::stats()["subscribers"].get<int64_t>() < state.range(0))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    readers.thread = std::thread([&readers]() { readers.run(); });
+
+    const json event = items_event();
+    const uint64_t resyncs_before = fanout::stats()["resyncs"].get<uint64_t>();
+    const auto start = std::chrono::steady_clock::now();
+    for (auto _ : state)
+        fanout::publish("items", event);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (fanout::stats()["queued"].get<uint64_t>() > 0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    readers.stop = true;
+    readers.thread.join();
+    state.counters["delivered_Bps"] = (double)readers.bytes.load() / seconds;
+    state.counters["resyncs"] = (double)(fanout::stats()["resyncs"].get<uint64_t>() - resyncs_before);
+    state.SetItemsProcessed(state.iterations());
+    for (int fd : readers.fds)
+        ::close(fd);
+    fanout::stop();
+}
+BENCHMARK(BM_Fanout_Publish)->Arg(1)->Arg(10)->Arg(100)->UseRealTime();
+
+void BM_Fanout_SerializePerSubscriber(benchmark::State& state)
+{
+    const json event = {{"event", "items"}, {"seq", 1}, {"data", items_event()}};
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); i++) {
+            std::string line = event.dump();
+            benchmark::DoNotOptimize(line.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Fanout_SerializePerSubscriber)->Arg(1)->Arg(100);
+
+} // namespace
@@ -0,0 +1,75 @@
+// save_state_to_file: full state.json rewrite for a slot with N received items
+//
+// The slot has N locations, half of them checked, so the checked location
+// runs and the legacy list grow with the items. The file goes to the working
+// directory and is removed at the end.
+
+#include <benchmark/benchmark.h>
+#include "state.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int64_t ITEM_BASE = 3860000;
+constexpr int64_t LOCATION_BASE = 3870000;
+
+const char* const STATE_FILE = "ap_bench_state.json";
+
+void fill_state(int64_t n)
+{
+    g_config = json::object();
+    g_config["paths"]["state_file"] = STATE_FILE;
+    g_config["archipelago"]["game"] = "Pokemon Emerald";
+
+    g_state = FetcherState();
+    g_state.room_name = "bench";
+    g_state.seed = "12345678901234567890";
+    g_state.slot_name = "Player1";
+    g_state.game = "Pokemon Emerald";
+    g_state.slot_id = 1;
+
+    std::vector<int64_t> universe;
+    universe.reserve(static_cast<size_t>(n));
+    for (int64_t i = 0; i < n; ++i) {
+        universe.push_back(LOCATION_BASE + i);
+    }
+    g_state.checked_locations.set_universe(universe);
+    for (int64_t i = 0; i < n; i += 2) {
+        g_state.checked_locations.insert(LOCATION_BASE + i);
+    }
+
+    g_state.items.reserve(static_cast<size_t>(n));
+    for (int64_t i = 0; i < n; ++i) {
+        FetcherState::ItemEvent ev;
+        ev.index = i;
+        ev.item = ITEM_BASE + i % 500;
+        ev.location = LOCATION_BASE + i;
+        ev.player = 1 + static_cast<int>(i % 8);
+        ev.flags = static_cast<unsigned>(i % 3);
+        ev.timestamp = 1700000000 + i;
+        g_state.items.push_back(ev);
+    }
+}
+
+void BM_SaveStateToFile(benchmark::State& state)
+{
+    fill_state(state.range(0));
+    for (auto _ : state) {
+        save_state_to_file();
+    }
+    std::ifstream file(STATE_FILE, std::ios::binary | std::ios::ate);
+    const auto bytes = static_cast<int64_t>(file.tellg());
+    file.close();
+    std::remove(STATE_FILE);
+    state.counters["bytes"] = static_cast<double>(bytes);
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(BM_SaveStateToFile)->Arg(100)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
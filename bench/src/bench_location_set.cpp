@@ -0,0 +1,184 @@
+// Checked locations: std::set<int64_t> vs LocationSet
+//
+// A slot's locations are a mostly contiguous range of ids. The benchmarks check
+// a random half of that universe in random order, then walk or serialize the
+// result the way save_state_to_file does.
+
+#include <benchmark/benchmark.h>
+#include <locationset.hpp>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int64_t BASE_ID = 3860000;
+
+std::vector<int64_t> make_universe(int64_t n)
+{
+    std::vector<int64_t> universe;
+    universe.reserve(static_cast<size_t>(n));
+    for (int64_t i = 0; i < n; ++i) {
+        universe.push_back(BASE_ID + i);
+    }
+    return universe;
+}
+
+std::vector<int64_t> make_checks(const std::vector<int64_t>& universe)
+{
+    std::vector<int64_t> checks = universe;
+    std::mt19937 rng(42);
+    std::shuffle(checks.begin(), checks.end(), rng);
+    checks.resize(checks.size() / 2);
+    return checks;
+}
+
+std::set<int64_t> fill_set(const std::vector<int64_t>& checks)
+{
+    return std::set<int64_t>(checks.begin(), checks.end());
+}
+
+LocationSet fill_location_set(const std::vector<int64_t>& universe, const std::vector<int64_t>& checks)
+{
+    LocationSet set;
+    set.set_universe(universe);
+    for (auto loc : checks) {
+        set.insert(loc);
+    }
+    return set;
+}
+
+void BM_Insert_StdSet(benchmark::State& state)
+{
+    auto checks = make_checks(make_universe(state.range(0)));
+    for (auto _ : state) {
+        std::set<int64_t> set;
+        for (auto loc : checks) {
+            set.insert(loc);
+        }
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(checks.size()));
+}
+
+void BM_Insert_LocationSet(benchmark::State& state)
+{
+    auto universe = make_universe(state.range(0));
+    auto checks = make_checks(universe);
+    LocationSet set;
+    set.set_universe(universe);
+    for (auto _ : state) {
+        set.clear();
+        for (auto loc : checks) {
+            set.insert(loc);
+        }
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(checks.size()));
+}
+
+void BM_Contains_StdSet(benchmark::State& state)
+{
+    auto universe = make_universe(state.range(0));
+    auto set = fill_set(make_checks(universe));
+    for (auto _ : state) {
+        size_t n = 0;
+        for (auto loc : universe) {
+            n += set.count(loc);
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(universe.size()));
+}
+
+void BM_Contains_LocationSet(benchmark::State& state)
+{
+    auto universe = make_universe(state.range(0));
+    auto set = fill_location_set(universe, make_checks(universe));
+    for (auto _ : state) {
+        size_t n = 0;
+        for (auto loc : universe) {
+            n += set.count(loc);
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(universe.size()));
+}
+
+void BM_Iterate_StdSet(benchmark::State& state)
+{
+    auto set = fill_set(make_checks(make_universe(state.range(0))));
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (auto loc : set) {
+            sum += loc;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(set.size()));
+}
+
+void BM_Iterate_LocationSet(benchmark::State& state)
+{
+    auto universe = make_universe(state.range(0));
+    auto set = fill_location_set(universe, make_checks(universe));
+    for (auto _ : state) {
+        int64_t sum = 0;
+        set.for_each([&sum](int64_t loc) { sum += loc; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(set.size()));
+}
+
+// Serialize: the plain id list written to state.json before, vs the runs written now
+void BM_Serialize_StdSet(benchmark::State& state)
+{
+    auto set = fill_set(make_checks(make_universe(state.range(0))));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::string out = "[";
+        for (auto loc : set) {
+            out += std::to_string(loc);
+            out += ',';
+        }
+        out.back() = ']';
+        bytes = out.size();
+        benchmark::DoNotOptimize(out);
+    }
+    state.counters["bytes"] = static_cast<double>(bytes);
+}
+
+void BM_Serialize_LocationSetRuns(benchmark::State& state)
+{
+    auto universe = make_universe(state.range(0));
+    auto set = fill_location_set(universe, make_checks(universe));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::string out = "[";
+        for (const auto& run : set.runs()) {
+            out += '[';
+            out += std::to_string(run.first);
+            out += ',';
+            out += std::to_string(run.second);
+            out += "],";
+        }
+        out.back() = ']';
+        bytes = out.size();
+        benchmark::DoNotOptimize(out);
+    }
+    state.counters["bytes"] = static_cast<double>(bytes);
+}
+
+} // namespace
+
+BENCHMARK(BM_Insert_StdSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Insert_LocationSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Contains_StdSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Contains_LocationSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Iterate_StdSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Iterate_LocationSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Serialize_StdSet)->Arg(300)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_Serialize_LocationSetRuns)->Arg(300)->Arg(10000)->Arg(100000);
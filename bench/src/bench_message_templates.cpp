@@ -0,0 +1,162 @@
+// Announcement text: compiled MessageTemplates vs naive "%name" substitution
+//
+// The naive version is what MessageManager.format_message does in the bot: copy
+// the template, then replace every "%name" for each value, converting numbers to
+// strings on the way. The template is config/messages.en.json's item_auto.
+
+#include <benchmark/benchmark.h>
+#include <message_templates.hpp>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const char* const ITEM_AUTO =
+    "%player a obtenu %item_name (%location_name) – %a / %b checks (%c%) complétés – %d restants.";
+
+struct Announcement {
+    std::string player = "TheLovenityJade";
+    std::string item_name = "HM08 Dive";
+    std::string location_name = "Route 124 - Hidden Item Under The Bridge";
+    int64_t done = 0;
+    int64_t total = 295;
+};
+
+std::string naive_render(const std::string& tmpl, const std::vector<std::pair<std::string, std::string>>& values)
+{
+    std::string msg = tmpl;
+    for (const auto& kv : values) {
+        const std::string placeholder = "%" + kv.first;
+        size_t pos = 0;
+        while ((pos = msg.find(placeholder, pos)) != std::string::npos) {
+            msg.replace(pos, placeholder.size(), kv.second);
+            pos += kv.second.size();
+        }
+    }
+    return msg;
+}
+
+void BM_Render_Naive(benchmark::State& state)
+{
+    const std::string tmpl = ITEM_AUTO;
+    Announcement a;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        a.done = (a.done + 1) % a.total;
+        char percent[16];
+        std::snprintf(percent, sizeof(percent), "%.1f", a.done * 100.0 / a.total);
+        std::string msg = naive_render(tmpl, {
+            {"player", a.player},
+            {"item_name", a.item_name},
+            {"location_name", a.location_name},
+            {"a", std::to_string(a.done)},
+            {"b", std::to_string(a.total)},
+            {"c", percent},
+            {"d", std::to_string(a.total - a.done)},
+        });
+        bytes += msg.size();
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_Render_Compiled(benchmark::State& state)
+{
+    MessageTemplates templates;
+    templates.add("item_auto", ITEM_AUTO);
+    const int id = templates.find("item_auto");
+    const int player = templates.placeholder("player");
+    const int item_name = templates.placeholder("item_name");
+    const int location_name = templates.placeholder("location_name");
+    const int a_id = templates.placeholder("a");
+    const int b_id = templates.placeholder("b");
+    const int c_id = templates.placeholder("c");
+    const int d_id = templates.placeholder("d");
+
+    Announcement a;
+    MessageTemplates::Args args = templates.make_args();
+    std::string out;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        a.done = (a.done + 1) % a.total;
+        args.set(player, a.player);
+        args.set(item_name, a.item_name);
+        args.set(location_name, a.location_name);
+        args.set(a_id, a.done);
+        args.set(b_id, a.total);
+        args.set(c_id, a.done * 100.0 / a.total);
+        args.set(d_id, a.total - a.done);
+        templates.render(id, args, out);
+        bytes += out.size();
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+
+// A !lastitem-style reply: a few short lines and one long line of accented text
+std::string make_reply()
+{
+    std::string text = "Derniers items:\n";
+    for (int i = 0; i < 5; i++) {
+        text += "TheLovenityJade: Poké Ball @ Route 10" + std::to_string(i) + " – Pokémon Center   \n";
+    }
+    for (int i = 0; i < 120; i++) {
+        text += "Écluse ";
+    }
+    return text;
+}
+
+// Python-style split: slice by code points, one std::string per message
+void BM_Split_Copy(benchmark::State& state)
+{
+    const std::string text = make_reply();
+    for (auto _ : state) {
+        std::vector<std::string> messages;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t eol = text.find('\n', pos);
+            if (eol == std::string::npos)
+                eol = text.size();
+            std::string line = text.substr(pos, eol - pos);
+            pos = eol + 1;
+            while (!line.empty() && line.back() == ' ')
+                line.pop_back();
+            while (!line.empty()) {
+                size_t chars = 0, cut = 0;
+                while (cut < line.size() && chars < MAX_TWITCH_MESSAGE_LENGTH) {
+                    cut++;
+                    while (cut < line.size() && ((unsigned char)line[cut] & 0xC0) == 0x80)
+                        cut++;
+                    chars++;
+                }
+                messages.push_back(line.substr(0, cut));
+                line.erase(0, cut);
+            }
+        }
+        benchmark::DoNotOptimize(messages);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+}
+
+void BM_Split_Views(benchmark::State& state)
+{
+    const std::string text = make_reply();
+    std::vector<std::string_view> messages;
+    for (auto _ : state) {
+        split_chat_lines(text, MAX_TWITCH_MESSAGE_LENGTH, messages);
+        benchmark::DoNotOptimize(messages);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+}
+
+} // namespace
+
+BENCHMARK(BM_Render_Naive);
+BENCHMARK(BM_Render_Compiled);
+BENCHMARK(BM_Split_Copy);
+BENCHMARK(BM_Split_Views);
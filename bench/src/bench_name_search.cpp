@@ -0,0 +1,103 @@
+// Fuzzy name lookup: NameSearch's trigram index vs a linear scan
+//
+// The linear scan scores every name with the same Dice coefficient, from trigram
+// lists computed once up front; it is what the bot would do to go past its exact
+// get_item_id match. 10k synthetic location-like names, typo'd query.
+
+#include <benchmark/benchmark.h>
+#include <name_search.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const char* const AREAS[] = {"Route", "Petalburg Woods", "Granite Cave", "Meteor Falls", "Safari Zone",
+                             "Mt Pyre", "Victory Road", "Seafloor Cavern", "Sky Pillar", "Abandoned Ship"};
+const char* const SPOTS[] = {"Hidden Item", "Item Ball", "NPC Gift", "Trainer Reward", "Berry Tree"};
+const char* const THINGS[] = {"Potion", "Rare Candy", "TM", "Nugget", "Full Heal", "Ultra Ball", "PP Up", "Star Piece"};
+
+std::vector<std::pair<int64_t, std::string>> synthetic_names(size_t count)
+{
+    std::vector<std::pair<int64_t, std::string>> names;
+    for (size_t i = 0; names.size() < count; i++) {
+        std::string name = std::string(AREAS[i % 10]) + " " + std::to_string(i / 400 + 101) + " - " + SPOTS[(i / 10) % 5] +
+                           " " + THINGS[(i / 50) % 8] + " " + std::to_string(i % 7);
+        names.emplace_back((int64_t)(3860000 + i), name);
+    }
+    return names;
+}
+
+std::vector<uint32_t> sorted_trigrams(const std::string& normalized)
+{
+    const std::string padded = " " + normalized + " ";
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i + 3 <= padded.size(); i++)
+        out.push_back(((uint32_t)(unsigned char)padded[i] << 16) | ((uint32_t)(unsigned char)padded[i + 1] << 8) |
+                      (uint32_t)(unsigned char)padded[i + 2]);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+const char* const QUERY = "meteor fals 112 trainer rewrd nuget";
+
+void BM_Search_Linear(benchmark::State& state)
+{
+    const auto names = synthetic_names((size_t)state.range(0));
+    std::vector<std::vector<uint32_t>> tris;
+    for (const auto& n : names)
+        tris.push_back(sorted_trigrams(NameSearch::normalize(n.second)));
+
+    for (auto _ : state) {
+        const std::vector<uint32_t> q = sorted_trigrams(NameSearch::normalize(QUERY));
+        std::vector<std::pair<double, size_t>> scored;
+        for (size_t i = 0; i < names.size(); i++) {
+            size_t common = 0;
+            for (size_t a = 0, b = 0; a < q.size() && b < tris[i].size();) {
+                if (q[a] < tris[i][b]) {
+                    a++;
+                } else if (tris[i][b] < q[a]) {
+                    b++;
+                } else {
+                    common++, a++, b++;
+                }
+            }
+            if (common)
+                scored.emplace_back(2.0 * common / (double)(q.size() + tris[i].size()), i);
+        }
+        std::partial_sort(scored.begin(), scored.begin() + std::min<size_t>(5, scored.size()), scored.end(),
+                          [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                              return a.first > b.first;
+                          });
+        benchmark::DoNotOptimize(scored.data());
+    }
+}
+BENCHMARK(BM_Search_Linear)->Arg(1000)->Arg(10000);
+
+void BM_Search_Index(benchmark::State& state)
+{
+    NameSearch index;
+    index.build(synthetic_names((size_t)state.range(0)));
+    for (auto _ : state) {
+        auto matches = index.search(QUERY, 5);
+        benchmark::DoNotOptimize(matches.data());
+    }
+    state.counters["index_bytes"] = (double)index.memory_bytes();
+}
+BENCHMARK(BM_Search_Index)->Arg(1000)->Arg(10000);
+
+void BM_Build_Index(benchmark::State& state)
+{
+    const auto names = synthetic_names((size_t)state.range(0));
+    for (auto _ : state) {
+        NameSearch index;
+        index.build(names);
+        benchmark::DoNotOptimize(index.size());
+    }
+}
+BENCHMARK(BM_Build_Index)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,42 @@
+// Replay of a recorded fetcher session (fetcher.capture_file)
+//
+// Only registered when AP_BENCH_CAPTURE points to a capture, e.g.
+//   AP_BENCH_CAPTURE=session.apcap ./ap_bench --benchmark_filter=Replay
+// Each iteration replays the whole capture as fast as possible into a new
+// APClient, so results are comparable between builds for the same capture.
+
+#include <benchmark/benchmark.h>
+#include "capture.hpp"
+#include "replay.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+void BM_Replay(benchmark::State& state, const std::vector<CaptureFrame>* frames)
+{
+    ReplayDriver driver(*frames);
+    ReplayStats stats;
+    for (auto _ : state) {
+        stats = driver.run();
+    }
+    state.counters["frames"] = static_cast<double>(stats.frames_received);
+    state.counters["frame_max_ms"] = stats.frame_max_ms;
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(stats.bytes_received));
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(stats.frames_received));
+}
+
+const bool registered = []() {
+    const char* path = std::getenv("AP_BENCH_CAPTURE");
+    if (!path || !*path)
+        return false;
+    static std::vector<CaptureFrame> frames;
+    if (!load_capture(path, frames))
+        return false;
+    benchmark::RegisterBenchmark("BM_Replay", BM_Replay, &frames)->Unit(benchmark::kMillisecond);
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,198 @@
+#include "memory_report.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// ------------------------------------------------------------
+// Compte les octets vivants alloués par operator new, pour le
+// rapport mémoire, y compris les surcharges alignées (C++17).
+// malloc_usable_size() donne la taille à la libération, donc
+// seulement avec la glibc. Les allocations faites par malloc
+// (zlib, OpenSSL) n'y sont pas: voir le RSS.
+// ------------------------------------------------------------
+
+#if defined(__GLIBC__)
+
+#include <malloc.h>
+
+namespace {
+
+std::atomic<uint64_t> g_live_bytes{0};
+std::atomic<uint64_t> g_peak_bytes{0};
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_frees{0};
+
+void* counted(void* p) noexcept
+{
+    if (p) {
+        const size_t usable = malloc_usable_size(p);
+        uint64_t live = g_live_bytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        // racy but only ever low: good enough for a report
+        if (live > g_peak_bytes.load(std::memory_order_relaxed)) {
+            g_peak_bytes.store(live, std::memory_order_relaxed);
+        }
+    }
+    return p;
+}
+
+void* counted_alloc(std::size_t size) noexcept
+{
+    return counted(std::malloc(size ? size : 1));
+}
+
+void* counted_alloc(std::size_t size, std::align_val_t align) noexcept
+{
+    // aligned_alloc() wants a size that is a multiple of the alignment
+    const std::size_t alignment = static_cast<std::size_t>(align);
+    const std::size_t rounded = size ? (size + alignment - 1) / alignment * alignment : alignment;
+    return counted(std::aligned_alloc(alignment, rounded));
+}
+
+void counted_free(void* p) noexcept
+{
+    if (p) {
+        g_live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(p);
+    }
+}
+
+template <typename... Align>
+void* throwing_alloc(std::size_t size, Align... align)
+{
+    for (;;) {
+        void* p = counted_alloc(size, align...);
+        if (p) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    return throwing_alloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return throwing_alloc(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    return throwing_alloc(size, align);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+    return throwing_alloc(size, align);
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size, align);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size, align);
+}
+
+void operator delete(void* p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    counted_free(p);
+}
+
+memory_report::HeapStats memory_report::heap_stats()
+{
+    HeapStats stats;
+    stats.available   = true;
+    stats.live_bytes  = g_live_bytes.load(std::memory_order_relaxed);
+    stats.peak_bytes  = g_peak_bytes.load(std::memory_order_relaxed);
+    stats.allocations = g_allocations.load(std::memory_order_relaxed);
+    stats.frees       = g_frees.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#else
+
+memory_report::HeapStats memory_report::heap_stats()
+{
+    return HeapStats();
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include "announce.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include "state.hpp"
+
+namespace announce {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+constexpr size_t MAX_RELEASED = 256; // kept for bots that poll late
+
+struct Announcer {
+    std::mutex mutex;
+    Config config;
+    MessageTemplates templates;
+    int t_item = -1, t_key = -1, t_batch = -1, t_source = -1;
+    int p_player = -1, p_item_name = -1, p_location_name = -1, p_from_player = -1;
+    int p_count = -1, p_sources = -1, p_a = -1, p_b = -1, p_c = -1, p_d = -1;
+
+    // fenêtre en cours
+    std::vector<Item> window;
+    TimePoint window_end;
+
+    // token bucket
+    double tokens = 0;
+    double refill_per_sec = 0;
+    TimePoint last_refill;
+
+    std::deque<std::string> pending;
+    std::deque<std::pair<int64_t, std::string>> released;
+    int64_t seq = 0;
+
+    uint64_t items = 0;
+    uint64_t windows = 0;
+    uint64_t lines = 0;
+    uint64_t dropped = 0;
+};
+
+Announcer& announcer()
+{
+    static Announcer* a = new Announcer();
+    return *a;
+}
+
+struct Progress {
+    int64_t done = 0;
+    int64_t total = 0;
+};
+
+Progress read_progress()
+{
+    std::lock_guard<std::mutex> lock(g_state_mutex);
+    Progress p;
+    p.done = static_cast<int64_t>(g_state.checked_locations.size());
+    p.total = location_count_locked();
+    return p;
+}
+
+void queue_line(Announcer& a, const std::string& text)
+{
+    std::vector<std::string_view> pieces;
+    split_chat_lines(text, MAX_TWITCH_MESSAGE_LENGTH, pieces);
+    for (auto piece : pieces) {
+        if (a.pending.size() >= a.config.max_queue) {
+            a.pending.pop_front();
+            a.dropped++;
+        }
+        a.pending.emplace_back(piece);
+    }
+}
+
+void set_progress(Announcer& a, MessageTemplates::Args& args, const Progress& p)
+{
+    args.set(a.p_a, p.done);
+    if (p.total > 0) {
+        args.set(a.p_b, p.total);
+        args.set(a.p_c, p.done * 100.0 / p.total);
+        args.set(a.p_d, std::max<int64_t>(p.total - p.done, 0));
+    } else {
+        args.set(a.p_b, std::string_view("?"));
+        args.set(a.p_c, std::string_view("?"));
+        args.set(a.p_d, std::string_view("?"));
+    }
+}
+
+// Caller holds a.mutex
+void close_window(Announcer& a, const Progress& progress)
+{
+    MessageTemplates::Args args = a.templates.make_args();
+    std::string text;
+    args.set(a.p_player, a.config.player);
+    set_progress(a, args, progress);
+
+    size_t others = 0;
+    for (const Item& it : a.window)
+        others += it.key ? 0 : 1;
+    const bool summarize = others > a.config.max_individual;
+
+    // items clés toujours seuls, dans l'ordre de réception
+    for (const Item& it : a.window) {
+        if (!it.key && summarize)
+            continue;
+        args.set(a.p_item_name, it.item_name);
+        args.set(a.p_location_name, it.location_name);
+        args.set(a.p_from_player, it.from_player);
+        a.templates.render(it.key ? a.t_key : a.t_item, args, text);
+        queue_line(a, text);
+    }
+
+    if (summarize) {
+        // "37 de Alice, 5 de Bob", dans l'ordre où les joueurs apparaissent
+        std::vector<std::pair<std::string, int64_t>> sources;
+        for (const Item& it : a.window) {
+            if (it.key)
+                continue;
+            auto src = std::find_if(sources.begin(), sources.end(),
+                                    [&it](const std::pair<std::string, int64_t>& s) { return s.first == it.from_player; });
+            if (src == sources.end())
+                sources.emplace_back(it.from_player, 1);
+            else
+                src->second++;
+        }
+        std::string list;
+        MessageTemplates::Args source_args = a.templates.make_args();
+        for (const auto& src : sources) {
+            source_args.set(a.p_from_player, src.first);
+            source_args.set(a.p_count, src.second);
+            a.templates.render(a.t_source, source_args, text);
+            if (!list.empty())
+                list += ", ";
+            list += text;
+        }
+        args.set(a.p_count, static_cast<int64_t>(others));
+        args.set(a.p_sources, list);
+        a.templates.render(a.t_batch, args, text);
+        queue_line(a, text);
+    }
+
+    a.window.clear();
+    a.windows++;
+}
+
+// Caller holds a.mutex
+void release(Announcer& a, TimePoint now)
+{
+    const double capacity = std::max(a.config.burst, 1.0);
+    const double elapsed = std::chrono::duration<double>(now - a.last_refill).count();
+    a.tokens = std::min(capacity, a.tokens + elapsed * a.refill_per_sec);
+    a.last_refill = now;
+    while (!a.pending.empty() && a.tokens >= 1) {
+        a.tokens -= 1;
+        a.released.emplace_back(++a.seq, std::move(a.pending.front()));
+        a.pending.pop_front();
+        a.lines++;
+        if (a.released.size() > MAX_RELEASED)
+            a.released.pop_front();
+    }
+}
+
+} // namespace
+
+void start(const Config& config, MessageTemplates templates)
+{
+    Announcer& a = announcer();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    a.config = config;
+    a.config.max_queue = std::max<size_t>(a.config.max_queue, 1);
+    a.templates = std::move(templates);
+    a.t_item = a.templates.find("item_auto");
+    a.t_key = a.templates.find("item_auto_key");
+    a.t_batch = a.templates.find("item_batch");
+    a.t_source = a.templates.find("item_batch_source");
+    a.p_player = a.templates.placeholder("player");
+    a.p_item_name = a.templates.placeholder("item_name");
+    a.p_location_name = a.templates.placeholder("location_name");
+    a.p_from_player = a.templates.placeholder("from_player");
+    a.p_count = a.templates.placeholder("count");
+    a.p_sources = a.templates.placeholder("sources");
+    a.p_a = a.templates.placeholder("a");
+    a.p_b = a.templates.placeholder("b");
+    a.p_c = a.templates.placeholder("c");
+    a.p_d = a.templates.placeholder("d");
+
+    // Twitch compte sur une fenêtre glissante: burst + refill * période ne dépasse jamais rate_messages
+    const double period = std::max(config.rate_period_sec, 1.0);
+    a.refill_per_sec = std::max(config.rate_messages - config.burst, 1.0) / period;
+    a.tokens = std::max(config.burst, 1.0);
+    a.last_refill = std::chrono::steady_clock::now();
+    detail::enabled = true;
+}
+
+void add_items(std::vector<Item> items, TimePoint now)
+{
+    if (items.empty())
+        return;
+    Announcer& a = announcer();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    if (a.window.empty())
+        a.window_end = now + std::chrono::milliseconds(a.config.window_ms);
+    a.items += items.size();
+    a.window.insert(a.window.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+}
+
+void tick(TimePoint now)
+{
+    Announcer& a = announcer();
+    bool window_over;
+    {
+        std::lock_guard<std::mutex> lock(a.mutex);
+        window_over = !a.window.empty() && now >= a.window_end;
+        if (!window_over) {
+            release(a, now);
+            return;
+        }
+    }
+
+    // jamais g_state_mutex et a.mutex en même temps
+    const Progress progress = read_progress();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    if (!a.window.empty())
+        close_window(a, progress);
+    release(a, now);
+}
+
+nlohmann::json released_after(int64_t seq)
+{
+    Announcer& a = announcer();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    nlohmann::json lines = nlohmann::json::array();
+    for (const auto& line : a.released) {
+        if (line.first > seq)
+            lines.push_back({{"seq", line.first}, {"text", line.second}});
+    }
+    return {{"seq", a.seq}, {"lines", lines}};
+}
+
+int64_t last_seq()
+{
+    Announcer& a = announcer();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    return a.seq;
+}
+
+nlohmann::json stats()
+{
+    Announcer& a = announcer();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    return {
+        {"items", a.items},
+        {"windows", a.windows},
+        {"lines", a.lines},
+        {"pending", a.pending.size()},
+        {"dropped", a.dropped},
+    };
+}
+
+} // namespace announce
@@ -0,0 +1,76 @@
+#ifndef _FETCHER_ANNOUNCE_HPP
+#define _FETCHER_ANNOUNCE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <nlohmann/json.hpp>
+
+#include "message_templates.hpp"
+
+// ------------------------------------------------------------
+// Annonces des items pour le chat (fetcher.announce)
+//
+//   Les items reçus dans une même fenêtre (window_ms après le premier)
+//   sont regroupés: les items clés ont chacun leur ligne, les autres
+//   sont résumés ("37 items de X") au-delà de max_individual. Les
+//   lignes rendues passent ensuite par un token bucket réglé sur les
+//   limites de Twitch (rate_messages par rate_period_sec, burst compris)
+//   et le bot n'a plus qu'à envoyer ce qui sort (query "announcements").
+// ------------------------------------------------------------
+
+namespace announce {
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+struct Config {
+    unsigned window_ms = 2000;
+    unsigned max_individual = 3; // above this, non-key items of a window are summarized
+    double rate_messages = 20;   // Twitch: 20 messages per 30 s (100 for moderators)
+    double rate_period_sec = 30;
+    double burst = 5;
+    size_t max_queue = 100;      // lines waiting for a token, oldest dropped beyond
+    std::string player;          // %player, the slot name
+};
+
+struct Item {
+    int64_t item = 0;
+    int64_t location = 0;
+    std::string item_name;
+    std::string location_name;
+    std::string from_player; // who found it
+    bool key = false;
+};
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Templates used: item_auto, item_auto_key, item_batch, item_batch_source
+void start(const Config& config, MessageTemplates templates);
+
+// Adds received items to the current window. Don't call with g_state_mutex held.
+void add_items(std::vector<Item> items, TimePoint now);
+
+// Closes the window once it is over, then releases the lines the rate allows.
+// Locks g_state_mutex to read the progress when a window closes.
+void tick(TimePoint now);
+
+// Lines released after seq: {"seq": last, "lines": [{"seq": n, "text": "..."}]}
+nlohmann::json released_after(int64_t seq);
+int64_t last_seq();
+
+// Counters for state.json's fetcher section
+nlohmann::json stats();
+
+} // namespace announce
+
+#endif // _FETCHER_ANNOUNCE_HPP
@@ -0,0 +1,241 @@
+#ifndef _FETCHER_CAPTURE_HPP
+#define _FETCHER_CAPTURE_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <zlib.h>
+
+// ------------------------------------------------------------
+// Capture de session websocket (.apcap)
+//
+//   Flux gzip contenant:
+//     magic "APCAP", 0, 0, version (8 octets)
+//     puis pour chaque frame:
+//       u64 time_us   – horloge monotone, µs depuis le début de la capture
+//       u8  direction – 0 = reçue du serveur, 1 = envoyée par le client
+//       u32 size      – suivi de size octets de frame (texte JSON)
+//   Entiers en little endian.
+//
+//   Écrit par le fetcher (fetcher.capture_file), rejoué par ap_replay.
+// ------------------------------------------------------------
+
+struct CaptureFrame {
+    enum Direction : uint8_t {
+        RECEIVED = 0,
+        SENT = 1,
+    };
+
+    uint64_t time_us = 0;
+    Direction direction = RECEIVED;
+    std::string data;
+};
+
+namespace capture_detail {
+
+constexpr uint8_t VERSION = 1;
+constexpr size_t MAGIC_SIZE = 8;
+constexpr size_t FRAME_HEADER_SIZE = 13;
+constexpr uint32_t MAX_FRAME_SIZE = 1u << 30; // refuse garbage sizes instead of allocating them
+
+inline const char* magic()
+{
+    static const char m[MAGIC_SIZE] = {'A', 'P', 'C', 'A', 'P', 0, 0, (char)VERSION};
+    return m;
+}
+
+inline void put_le(uint8_t* dst, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+        dst[i] = (uint8_t)(value >> (8 * i));
+}
+
+inline uint64_t get_le(const uint8_t* src, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++)
+        value |= (uint64_t)src[i] << (8 * i);
+    return value;
+}
+
+} // namespace capture_detail
+
+class CaptureWriter {
+public:
+    CaptureWriter() = default;
+
+    ~CaptureWriter()
+    {
+        close();
+    }
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // level: gzip level 1..9
+    bool open(const std::string& path, int level = 6)
+    {
+        close();
+        if (level < 1 || level > 9)
+            level = 6;
+        const char mode[] = {'w', 'b', (char)('0' + level), 0};
+        _gz = gzopen(path.c_str(), mode);
+        if (!_gz)
+            return false;
+        _start = std::chrono::steady_clock::now();
+        _frames = 0;
+        _bytes = 0;
+        if (gzwrite(_gz, capture_detail::magic(), capture_detail::MAGIC_SIZE) != (int)capture_detail::MAGIC_SIZE) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool is_open() const
+    {
+        return _gz != nullptr;
+    }
+
+    // Stops recording on write errors (disk full, ...) rather than writing a corrupt file
+    void write(CaptureFrame::Direction direction, const std::string& data)
+    {
+        if (!_gz || data.size() > capture_detail::MAX_FRAME_SIZE)
+            return;
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        uint8_t header[capture_detail::FRAME_HEADER_SIZE];
+        capture_detail::put_le(header, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), 8);
+        header[8] = direction;
+        capture_detail::put_le(header + 9, data.size(), 4);
+        if (gzwrite(_gz, header, sizeof(header)) != (int)sizeof(header)
+                || (!data.empty() && gzwrite(_gz, data.data(), (unsigned)data.size()) != (int)data.size())) {
+            close();
+            return;
+        }
+        _frames++;
+        _bytes += data.size();
+    }
+
+    // Make what was written so far readable, e.g. if the fetcher gets killed
+    void flush()
+    {
+        if (_gz)
+            gzflush(_gz, Z_SYNC_FLUSH);
+    }
+
+    void close()
+    {
+        if (_gz) {
+            gzclose(_gz);
+            _gz = nullptr;
+        }
+    }
+
+    uint64_t frames() const
+    {
+        return _frames;
+    }
+
+    uint64_t bytes() const
+    {
+        return _bytes;
+    }
+
+private:
+    gzFile _gz = nullptr;
+    std::chrono::steady_clock::time_point _start;
+    uint64_t _frames = 0;
+    uint64_t _bytes = 0;
+};
+
+class CaptureReader {
+public:
+    CaptureReader() = default;
+
+    ~CaptureReader()
+    {
+        close();
+    }
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    bool open(const std::string& path)
+    {
+        close();
+        _truncated = false;
+        _gz = gzopen(path.c_str(), "rb");
+        if (!_gz)
+            return false;
+        char m[capture_detail::MAGIC_SIZE];
+        if (gzread(_gz, m, sizeof(m)) != (int)sizeof(m)
+                || std::string(m, sizeof(m)) != std::string(capture_detail::magic(), capture_detail::MAGIC_SIZE)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // false at the end of the capture. truncated() tells if it ended in the middle of a frame.
+    bool next(CaptureFrame& frame)
+    {
+        if (!_gz)
+            return false;
+        uint8_t header[capture_detail::FRAME_HEADER_SIZE];
+        int n = gzread(_gz, header, sizeof(header));
+        if (n != (int)sizeof(header)) {
+            _truncated = n != 0;
+            return false;
+        }
+        uint32_t size = (uint32_t)capture_detail::get_le(header + 9, 4);
+        if (header[8] > CaptureFrame::SENT || size > capture_detail::MAX_FRAME_SIZE) {
+            _truncated = true;
+            return false;
+        }
+        frame.time_us = capture_detail::get_le(header, 8);
+        frame.direction = (CaptureFrame::Direction)header[8];
+        frame.data.resize(size);
+        if (size && gzread(_gz, &frame.data[0], size) != (int)size) {
+            _truncated = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool truncated() const
+    {
+        return _truncated;
+    }
+
+    void close()
+    {
+        if (_gz) {
+            gzclose(_gz);
+            _gz = nullptr;
+        }
+    }
+
+private:
+    gzFile _gz = nullptr;
+    bool _truncated = false;
+};
+
+// Read a whole capture into memory. Returns false if the file could not be opened or is not a capture.
+// A truncated capture (fetcher killed while writing) still returns the complete frames.
+inline bool load_capture(const std::string& path, std::vector<CaptureFrame>& frames, bool* truncated = nullptr)
+{
+    CaptureReader reader;
+    if (!reader.open(path))
+        return false;
+    frames.clear();
+    CaptureFrame frame;
+    while (reader.next(frame))
+        frames.push_back(std::move(frame));
+    if (truncated)
+        *truncated = reader.truncated();
+    return true;
+}
+
+#endif // _FETCHER_CAPTURE_HPP
@@ -0,0 +1,382 @@
+#include "fanout.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fanout {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr size_t MAX_BATCH = 16;     // lines per sendmsg()
+constexpr size_t MIN_QUEUE = 2 * MAX_BATCH;
+
+typedef std::shared_ptr<const std::string> Line;
+
+struct Subscriber {
+    int fd = -1;
+    // guarded by Fanout::mutex
+    std::deque<Line> queue;
+    size_t offset = 0;    // bytes of queue.front() already written
+    size_t in_flight = 0; // lines at the front being written, kept by a resync
+    bool closing = false;
+};
+
+struct Fanout {
+    std::mutex publish_mutex; // keeps seq order in the queues, taken before mutex
+    uint64_t seq = 0;
+
+    std::mutex mutex;
+    Config config;
+    std::vector<std::unique_ptr<Subscriber>> subscribers; // removed by the server thread only
+    std::map<std::string, Line> retained;
+    uint64_t published = 0;
+    uint64_t connected = 0;
+    uint64_t resyncs = 0;
+    uint64_t dropped = 0;
+
+    std::mutex server_mutex;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> wake_pending{false}; // a byte is already in the wake pipe
+    int listen_fd = -1;
+    int wake[2] = {-1, -1};
+    std::string path;
+};
+
+Fanout& fanout()
+{
+    static Fanout* f = new Fanout();
+    return *f;
+}
+
+Line make_line(const char* event, uint64_t seq, const nlohmann::json& data)
+{
+    nlohmann::json msg = {{"event", event}, {"seq", seq}, {"data", data}};
+    // names come from the network, don't let invalid UTF-8 make dump() throw
+    auto line = std::make_shared<std::string>(msg.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+    line->push_back('\n');
+    return line;
+}
+
+// Caller holds f.mutex
+void queue_retained_locked(Fanout& f, Subscriber& s)
+{
+    for (const auto& kv : f.retained)
+        s.queue.push_back(kv.second);
+}
+
+// Caller holds f.mutex. The lines being written stay, the rest is replaced.
+void resync_locked(Fanout& f, Subscriber& s, uint64_t seq)
+{
+    const size_t keep = std::min(s.queue.size(), std::max<size_t>(s.in_flight, s.offset ? 1 : 0));
+    const size_t skipped = s.queue.size() - keep;
+    s.queue.erase(s.queue.begin() + (long)keep, s.queue.end());
+    s.queue.push_back(make_line("resync", seq, {{"skipped", skipped}}));
+    queue_retained_locked(f, s);
+    f.resyncs++;
+}
+
+void wake_server(Fanout& f)
+{
+    if (f.wake_pending.exchange(true))
+        return;
+    const char c = 0;
+    ssize_t n = ::write(f.wake[1], &c, 1); // pipe full: the server is already awake
+    (void)n;
+}
+
+// Writes up to MAX_BATCH lines. Returns false if the subscriber is gone.
+// more is set when lines are left and the socket took everything it was given.
+bool write_batch(Fanout& f, Subscriber& s, bool& more)
+{
+    more = false;
+    Line batch[MAX_BATCH];
+    iovec iov[MAX_BATCH];
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(f.mutex);
+        count = std::min(s.queue.size(), MAX_BATCH);
+        for (size_t i = 0; i < count; i++) {
+            batch[i] = s.queue[i];
+            const size_t skip = i == 0 ? s.offset : 0;
+            iov[i].iov_base = const_cast<char*>(batch[i]->data() + skip);
+            iov[i].iov_len = batch[i]->size() - skip;
+        }
+        s.in_flight = count;
+    }
+    if (count == 0)
+        return true;
+
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    ssize_t n = ::sendmsg(s.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    std::lock_guard<std::mutex> lock(f.mutex);
+    s.in_flight = 0;
+    if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    size_t written = (size_t)n;
+    while (written > 0) {
+        const size_t left = s.queue.front()->size() - s.offset;
+        if (written < left) {
+            s.offset += written;
+            break;
+        }
+        written -= left;
+        s.queue.pop_front();
+        s.offset = 0;
+    }
+    more = written == 0 && s.offset == 0 && !s.queue.empty();
+    return true;
+}
+
+// Writes until the queue is empty or the socket is full, a few batches at most
+// so that one subscriber can't keep the others waiting
+bool write_subscriber(Fanout& f, Subscriber& s)
+{
+    bool more = true;
+    for (int i = 0; i < 8 && more; i++) {
+        if (!write_batch(f, s, more))
+            return false;
+    }
+    return true;
+}
+
+void accept_subscriber(Fanout& f)
+{
+    int fd = ::accept(f.listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        return;
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    std::lock_guard<std::mutex> publish_lock(f.publish_mutex); // hello's seq is the last one queued before it
+    std::lock_guard<std::mutex> lock(f.mutex);
+    if (f.subscribers.size() >= f.config.max_subscribers) {
+        ::close(fd);
+        return;
+    }
+    std::unique_ptr<Subscriber> s(new Subscriber());
+    s->fd = fd;
+    s->queue.push_back(make_line("hello", f.seq, {{"max_queue", f.config.max_queue}, {"resync", f.config.resync}}));
+    queue_retained_locked(f, *s);
+    f.subscribers.push_back(std::move(s));
+    f.connected++;
+}
+
+void serve(Fanout& f)
+{
+    std::vector<pollfd> fds;
+    std::vector<Subscriber*> polled;
+    while (!f.stop.load()) {
+        fds.clear();
+        polled.clear();
+        fds.push_back({f.listen_fd, POLLIN, 0});
+        fds.push_back({f.wake[0], POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(f.mutex);
+            auto gone = std::remove_if(f.subscribers.begin(), f.subscribers.end(), [](const std::unique_ptr<Subscriber>& s) {
+                if (s->closing)
+                    ::close(s->fd);
+                return s->closing;
+            });
+            f.subscribers.erase(gone, f.subscribers.end());
+            for (const auto& s : f.subscribers) {
+                fds.push_back({s->fd, (short)(POLLIN | (s->queue.empty() ? 0 : POLLOUT)), 0});
+                polled.push_back(s.get());
+            }
+        }
+        if (::poll(fds.data(), fds.size(), 200) <= 0)
+            continue;
+
+        if (fds[1].revents & POLLIN) {
+            f.wake_pending = false;
+            char buf[256];
+            while (::read(f.wake[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+
+        for (size_t i = 0; i < polled.size(); i++) {
+            Subscriber& s = *polled[i];
+            const short revents = fds[i + 2].revents;
+            bool alive = !(revents & (POLLHUP | POLLERR | POLLNVAL));
+            if (alive && (revents & POLLIN)) {
+                // les abonnés n'envoient rien: on vide, 0 = fermé
+                char buf[256];
+                alive = ::recv(s.fd, buf, sizeof(buf), MSG_DONTWAIT) != 0;
+            }
+            if (alive && (revents & POLLOUT))
+                alive = write_subscriber(f, s);
+            if (!alive) {
+                std::lock_guard<std::mutex> lock(f.mutex);
+                s.closing = true;
+            }
+        }
+
+        if (fds[0].revents & POLLIN)
+            accept_subscriber(f);
+    }
+
+    std::lock_guard<std::mutex> lock(f.mutex);
+    for (const auto& s : f.subscribers)
+        ::close(s->fd);
+    f.subscribers.clear();
+}
+
+} // namespace
+
+bool start(const std::string& path, const Config& config)
+{
+    Fanout& f = fanout();
+    std::lock_guard<std::mutex> server_lock(f.server_mutex);
+    if (f.listen_fd >= 0)
+        return true;
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    ::unlink(path.c_str()); // left over by a previous run
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 64) != 0 || ::pipe(f.wake) != 0) {
+        ::close(fd);
+        return false;
+    }
+    ::chmod(path.c_str(), 0600); // only the bot's user
+    ::fcntl(f.wake[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(f.wake[1], F_SETFL, O_NONBLOCK);
+
+    {
+        std::lock_guard<std::mutex> lock(f.mutex);
+        f.config = config;
+        f.config.max_queue = std::max(f.config.max_queue, MIN_QUEUE);
+    }
+    f.listen_fd = fd;
+    f.path = path;
+    f.stop = false;
+    f.thread = std::thread(serve, std::ref(f));
+    detail::enabled = true;
+    return true;
+}
+
+void stop()
+{
+    Fanout& f = fanout();
+    std::lock_guard<std::mutex> server_lock(f.server_mutex);
+    if (f.listen_fd < 0)
+        return;
+    detail::enabled = false;
+    f.stop = true;
+    f.thread.join();
+    ::close(f.listen_fd);
+    ::close(f.wake[0]);
+    ::close(f.wake[1]);
+    ::unlink(f.path.c_str());
+    f.listen_fd = -1;
+}
+
+void publish(const char* event, const nlohmann::json& data, bool retain)
+{
+    if (!enabled())
+        return;
+    Fanout& f = fanout();
+    std::lock_guard<std::mutex> publish_lock(f.publish_mutex);
+    const uint64_t seq = ++f.seq;
+    Line line = make_line(event, seq, data);
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(f.mutex);
+        f.published++;
+        if (retain)
+            f.retained[event] = line;
+        for (const auto& s : f.subscribers) {
+            if (s->closing)
+                continue;
+            if (s->queue.size() >= f.config.max_queue) {
+                if (!f.config.resync) {
+                    s->closing = true;
+                    f.dropped++;
+                    wake = true;
+                    continue;
+                }
+                resync_locked(f, *s, seq);
+            }
+            wake |= s->queue.empty();
+            s->queue.push_back(line);
+        }
+    }
+    // une file déjà non vide est déjà surveillée en POLLOUT
+    if (wake)
+        wake_server(f);
+}
+
+nlohmann::json stats()
+{
+    Fanout& f = fanout();
+    std::lock_guard<std::mutex> lock(f.mutex);
+    size_t queued = 0;
+    for (const auto& s : f.subscribers)
+        queued += s->queue.size();
+    return {
+        {"subscribers", f.subscribers.size()},
+        {"connected", f.connected},
+        {"published", f.published},
+        {"queued", queued},
+        {"resyncs", f.resyncs},
+        {"dropped", f.dropped},
+    };
+}
+
+#else
+
+bool start(const std::string&, const Config&)
+{
+    return false;
+}
+
+void stop()
+{
+}
+
+void publish(const char*, const nlohmann::json&, bool)
+{
+}
+
+nlohmann::json stats()
+{
+    return nlohmann::json::object();
+}
+
+#endif
+
+} // namespace fanout
@@ -0,0 +1,58 @@
+#ifndef _FETCHER_FANOUT_HPP
+#define _FETCHER_FANOUT_HPP
+
+#include <atomic>
+#include <string>
+#include <stddef.h>
+
+#include <nlohmann/json.hpp>
+
+// ------------------------------------------------------------
+// Diffusion des événements aux bots abonnés (fetcher.fanout)
+//
+//   Socket Unix, une ligne JSON par événement, du fetcher vers
+//   l'abonné seulement:
+//     <- {"event":"items","seq":12,"data":{"items":[...],...}}
+//   Chaque événement est sérialisé une fois, puis la même ligne
+//   (shared_ptr) est mise dans la file de chaque abonné. Un thread
+//   à part écrit les files sur des sockets non bloquants: le thread
+//   réseau ne fait jamais que copier des pointeurs.
+//
+//   Un abonné dont la file atteint max_queue est resynchronisé (file
+//   vidée, événement "resync" puis les événements retenus, comme
+//   "progress") ou déconnecté si resync est désactivé.
+// ------------------------------------------------------------
+
+namespace fanout {
+
+struct Config {
+    size_t max_subscribers = 128;
+    size_t max_queue = 256; // events waiting per subscriber
+    bool resync = true;     // false: disconnect subscribers that fall behind
+};
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Serves subscribers on a Unix socket at path, on a background thread.
+// Returns false if the socket could not be created (or on platforms without them).
+bool start(const std::string& path, const Config& config);
+void stop();
+
+// Queues {"event": event, "seq": n, "data": data} for every subscriber. Never waits
+// for one. A retained event is also sent to new subscribers and after a resync, the
+// last one of each name only.
+void publish(const char* event, const nlohmann::json& data, bool retain = false);
+
+// Counters for state.json's fetcher section
+nlohmann::json stats();
+
+} // namespace fanout
+
+#endif // _FETCHER_FANOUT_HPP
@@ -0,0 +1,109 @@
+#ifndef _FETCHER_ITEM_LATENCY_HPP
+#define _FETCHER_ITEM_LATENCY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+
+#include <nlohmann/json.hpp>
+
+// ------------------------------------------------------------
+// Latence des items, de la frame reçue jusqu'à ce que le bot
+// puisse les voir:
+//   handled  – fin du handler ReceivedItems (item dans g_state)
+//   snapshot – item inclus dans un state.json en construction
+//   written  – state.json contenant l'item écrit sur disque
+// Chaque étape garde les dernières mesures pour p50/p99 et compte
+// les items au-dessus du SLO (fetcher.item_latency_slo_ms).
+// ------------------------------------------------------------
+
+class ItemLatency {
+public:
+    enum Stage {
+        HANDLED,
+        SNAPSHOT,
+        WRITTEN,
+        STAGE_COUNT
+    };
+
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    explicit ItemLatency(size_t window = 1024, double slo_ms = 500)
+        : window_(std::max<size_t>(window, 1)), slo_ms_(slo_ms)
+    {
+    }
+
+    void set_slo_ms(double slo_ms)
+    {
+        slo_ms_ = slo_ms;
+    }
+
+    double slo_ms() const
+    {
+        return slo_ms_;
+    }
+
+    // Returns the latency in ms
+    double record(Stage stage, time_point received_at, time_point now)
+    {
+        double ms = std::chrono::duration<double, std::milli>(now - received_at).count();
+        StageStats& s = stages_[stage];
+        if (s.recent.size() < window_) {
+            s.recent.push_back(ms);
+        } else {
+            s.recent[s.next] = ms;
+        }
+        s.next = (s.next + 1) % window_;
+        s.count++;
+        if (ms > slo_ms_)
+            s.over_slo++;
+        s.max_ms = std::max(s.max_ms, ms);
+        return ms;
+    }
+
+    static const char* stage_name(Stage stage)
+    {
+        static const char* const names[STAGE_COUNT] = {"handled", "snapshot", "written"};
+        return names[stage];
+    }
+
+    nlohmann::json to_json() const
+    {
+        nlohmann::json j = nlohmann::json::object();
+        j["slo_ms"] = slo_ms_;
+        for (size_t i = 0; i < STAGE_COUNT; i++) {
+            const StageStats& s = stages_[i];
+            std::vector<double> sorted = s.recent;
+            std::sort(sorted.begin(), sorted.end());
+            auto pct = [&sorted](size_t p) -> nlohmann::json {
+                if (sorted.empty())
+                    return nullptr;
+                return sorted[(sorted.size() - 1) * p / 100];
+            };
+            j[stage_name((Stage)i)] = {
+                {"count", s.count},
+                {"over_slo", s.over_slo},
+                {"p50_ms", pct(50)},
+                {"p99_ms", pct(99)},
+                {"max_ms", s.count ? nlohmann::json(s.max_ms) : nlohmann::json(nullptr)},
+            };
+        }
+        return j;
+    }
+
+private:
+    struct StageStats {
+        std::vector<double> recent; // last window_ latencies, ring
+        size_t next = 0;
+        uint64_t count = 0;
+        uint64_t over_slo = 0;
+        double max_ms = 0;
+    };
+
+    size_t window_;
+    double slo_ms_;
+    StageStats stages_[STAGE_COUNT];
+};
+
+#endif // _FETCHER_ITEM_LATENCY_HPP
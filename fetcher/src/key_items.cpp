@@ -0,0 +1,65 @@
+#include "key_items.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "state.hpp"
+
+namespace key_items {
+
+namespace {
+
+struct Catalog {
+    const char* game;
+    const int64_t* ids; // sorted
+    size_t count;
+};
+
+#include "key_item_catalog.inc"
+
+constexpr bool sorted(const Catalog& c)
+{
+    for (size_t i = 1; i < c.count; i++) {
+        if (c.ids[i - 1] >= c.ids[i])
+            return false;
+    }
+    return true;
+}
+
+constexpr bool all_sorted()
+{
+    for (const Catalog& c : CATALOGS) {
+        if (!sorted(c))
+            return false;
+    }
+    return true;
+}
+
+static_assert(all_sorted(), "key item catalogs must be sorted and without duplicates");
+
+const Catalog* find_catalog(const std::string& game)
+{
+    for (const Catalog& c : CATALOGS) {
+        if (std::strcmp(c.game, game.c_str()) == 0)
+            return &c;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+size_t catalog_size(const std::string& game)
+{
+    const Catalog* c = find_catalog(game);
+    return c ? c->count : 0;
+}
+
+bool is_key_item(const std::string& game, int64_t item_id, const std::string& item_name)
+{
+    const Catalog* c = find_catalog(game);
+    if (!c)
+        return is_probable_key_item(item_name);
+    return std::binary_search(c->ids, c->ids + c->count, item_id);
+}
+
+} // namespace key_items
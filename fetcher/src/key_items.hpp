@@ -0,0 +1,27 @@
+#ifndef _FETCHER_KEY_ITEMS_HPP
+#define _FETCHER_KEY_ITEMS_HPP
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// Key items par jeu
+//
+//   Tables d'ids triées, générées au build depuis les mondes de
+//   third_party/archipelago_py/worlds (fetcher/tools/gen_key_item_catalog.py)
+//   pour Pokemon Emerald et Pokemon Red and Blue. Les autres jeux
+//   gardent l'heuristique sur le nom (is_probable_key_item).
+// ------------------------------------------------------------
+
+namespace key_items {
+
+// Number of key items in game's catalog, 0 if the game has none
+size_t catalog_size(const std::string& game);
+
+// Binary search in game's catalog, or the name heuristic for games without one
+bool is_key_item(const std::string& game, int64_t item_id, const std::string& item_name);
+
+} // namespace key_items
+
+#endif // _FETCHER_KEY_ITEMS_HPP
@@ -9,59 +9,32 @@
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 
 #include <nlohmann/json.hpp>
 
 // apclientpp
 #include "apclient.hpp"
 #include "apuuid.hpp"
-
-using json = nlohmann::json;
-
-// ------------------------------------------------------------
-// Global config & state
-// ------------------------------------------------------------
-
-json g_config;
-std::mutex g_state_mutex;
-
-struct FetcherState {
-    // Room / seed info
-    std::string room_name;
-    std::string seed;
-    std::string server_version;
-    std::string generator_version;
-    int hint_points = 0;
-    int hint_cost_percent = 0;
-    int hint_cost_points = 0;
-
-    // Slot / player info
-    std::string slot_name;
-    std::string game;
-    int slot_id = -1;
-    int team_id = -1;
-    int player_number = -1;
-    int team_number = -1;
-
-    // Locations checked
-    std::set<int64_t> checked_locations;
-
-    // Items reçus
-    struct ItemEvent {
-        int64_t index = -1;
-        int64_t item = 0;
-        int64_t location = 0;
-        int player = 0;
-        unsigned flags = 0;
-        std::time_t timestamp = 0;
-    };
-    std::vector<ItemEvent> items;
-
-    // Misc data storage / datapackage
-    json data_storage = json::object();
-};
-
-FetcherState g_state;
+#include "compileddatapackagestore.hpp"
+
+#include "state.hpp"
+#include "capture.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "memory_report.hpp"
+#include "query_server.hpp"
+#include "announce.hpp"
+#include "state_snapshot.hpp"
+#include "name_search.hpp"
+#include "key_items.hpp"
+#include "fanout.hpp"
 
 // ------------------------------------------------------------
 // Helpers
@@ -74,134 +47,223 @@ static std::string version_to_string(const APClient::Version& v)
            std::to_string(v.build);
 }
 
-void log_to_file(const std::string& msg)
-{
-    try {
-        if (!g_config.contains("paths") || !g_config["paths"].contains("fetcher_log")) {
-            return;
+// Runs a task every `interval` on a background thread until destroyed.
+class PeriodicTask {
+public:
+    PeriodicTask(std::chrono::seconds interval, std::function<void()> task)
+        : interval_(interval), task_(std::move(task))
+    {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~PeriodicTask()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
         }
-        const std::string log_path = g_config["paths"]["fetcher_log"].get<std::string>();
+        cv_.notify_all();
+        thread_.join();
+    }
 
-        std::ofstream out(log_path, std::ios::app);
-        if (!out) {
-            return;
+    PeriodicTask(const PeriodicTask&) = delete;
+    PeriodicTask& operator=(const PeriodicTask&) = delete;
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            lock.unlock();
+            task_();
+            lock.lock();
+            cv_.wait_for(lock, interval_, [this]() { return stop_; });
         }
+    }
 
-        std::time_t now = std::time(nullptr);
-        char buf[64];
-        std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    std::chrono::seconds interval_;
+    std::function<void()> task_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
 
-        out << "[" << buf << "] " << msg << '\n';
-    }
-    catch (...) {
-        // Logging must never throw
+static json cache_stats_to_json(const DefaultDataPackageStore::CacheStats& stats)
+{
+    json j = json::object();
+    j["hits"]          = stats.hits;
+    j["misses"]        = stats.misses;
+    j["bytes_read"]    = stats.bytesRead;
+    j["bytes_written"] = stats.bytesWritten;
+    j["evicted_files"] = stats.evictedFiles;
+    j["evicted_bytes"] = stats.evictedBytes;
+    j["cache_files"]   = stats.cacheFiles;
+    j["cache_bytes"]   = stats.cacheBytes;
+    return j;
+}
+
+static json connect_timings_to_json(const APClient::ConnectTimings& t)
+{
+    // ms depuis le début de la (re)connexion, null si la phase n'a pas encore eu lieu
+    auto phase = [&t](APClient::ConnectTimings::time_point p) -> json {
+        if (p == APClient::ConnectTimings::time_point() || t.started == APClient::ConnectTimings::time_point())
+            return nullptr;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(p - t.started).count();
+    };
+    json j = json::object();
+    j["attempts"]           = t.attempts;
+    j["reconnects"]         = t.reconnects;
+    j["socket_open"]        = phase(t.socket_open);
+    j["room_info"]          = phase(t.room_info);
+    j["data_package_ready"] = phase(t.data_package_ready);
+    j["connected"]          = phase(t.connected);
+    j["items_synced"]       = phase(t.items_synced);
+    return j;
+}
+
+// SIGUSR2: écrire les traces (fetcher.trace) au prochain tour de boucle
+static volatile std::sig_atomic_t g_trace_dump_requested = 0;
+
+static void request_trace_dump(int)
+{
+    g_trace_dump_requested = 1;
+}
+
+// SIGUSR1: écrire un rapport mémoire (fetcher.memory_report) au prochain tour de boucle
+static volatile std::sig_atomic_t g_memory_report_requested = 0;
+
+static void request_memory_report(int)
+{
+    g_memory_report_requested = 1;
+}
+
+static void write_memory_report(const std::string& path, const memory_report::Sources& sources)
+{
+    json report = memory_report::build(sources);
+    if (!memory_report::append(path, report)) {
+        log_to_file("[WARN] Unable to write memory report: " + path);
+        return;
     }
+    log_to_file("[INFO] Memory report: rss " + std::to_string(report["process"].value("rss_bytes", 0ULL) / 1024) +
+                " KiB, estimated " + std::to_string(report["estimated_bytes"].get<uint64_t>() / 1024) +
+                " KiB, written to " + path);
 }
 
-void save_state_to_file()
+static void dump_trace(const std::string& path)
 {
-    try {
-        if (!g_config.contains("paths") || !g_config["paths"].contains("state_file")) {
-            return;
-        }
-        const std::string state_path = g_config["paths"]["state_file"].get<std::string>();
+    long spans = trace::dump(path);
+    if (spans < 0) {
+        log_to_file("[WARN] Unable to write trace file: " + path);
+    } else {
+        log_to_file("[INFO] Wrote " + std::to_string(spans) + " trace spans to " + path);
+    }
+}
 
-        json out = json::object();
-        {
-            std::lock_guard<std::mutex> lock(g_state_mutex);
+// Plus haut index de ReceivedItems déjà annoncé ou publié, pour une room et un slot.
+// Le serveur renvoie tout l'historique depuis l'index 0 à chaque connexion.
+struct AnnouncedItems {
+    std::string seed;
+    std::string slot;
+    int64_t index = -1;
+};
 
-            // Room/meta
-            json room = json::object();
-            room["room_name"]          = g_state.room_name;
-            room["seed"]               = g_state.seed;
-            room["server_version"]     = g_state.server_version;
-            room["generator_version"]  = g_state.generator_version;
-            room["hint_points"]        = g_state.hint_points;
-            room["hint_cost_percent"]  = g_state.hint_cost_percent;
-            room["hint_cost_points"]   = g_state.hint_cost_points;
-
-            // Total des locations (si le DataPackage est disponible)
-            int total_locations = 0;
-            try {
-                auto it_dp = g_state.data_storage.find("data_package");
-                if (it_dp != g_state.data_storage.end()) {
-                    const json& dp = it_dp.value();
-
-                    if (dp.contains("games") && dp["games"].contains(g_state.game)) {
-                        const json& game_obj = dp["games"][g_state.game];
-                        if (game_obj.contains("locations") && game_obj["locations"].is_object()) {
-                            total_locations = static_cast<int>(game_obj["locations"].size());
-                        }
-                    }
-                }
-            } catch (const std::exception& e) {
-                log_to_file(std::string("[WARN] Failed to compute location_count: ") + e.what());
-            }
-            room["location_count"] = total_locations;
-
-            out["room"] = room;
-
-            // Slot / me
-            json me = json::object();
-            me["slot_name"]     = g_state.slot_name;
-            me["game"]          = g_state.game;
-            me["slot_id"]       = g_state.slot_id;
-            me["team_id"]       = g_state.team_id;
-            me["player_number"] = g_state.player_number;
-            me["team_number"]   = g_state.team_number;
-            out["me"] = me;
-
-            // Checked locations
-            json checks = json::array();
-            for (auto loc : g_state.checked_locations) {
-                checks.push_back(loc);
-            }
-            out["checked_locations"] = checks;
-
-            // Items
-            json items = json::array();
-            for (const auto& it : g_state.items) {
-                json ji;
-                ji["index"]    = it.index;
-                ji["item"]     = it.item;
-                ji["location"] = it.location;
-                ji["player"]   = it.player;
-                ji["flags"]    = it.flags;
-                ji["time"]     = it.timestamp;
-                items.push_back(ji);
+// Reprend le state.json du run précédent, pour ne pas réannoncer son historique
+// quand le fetcher redémarre (à lire avant la première sauvegarde).
+static AnnouncedItems load_announced_items()
+{
+    AnnouncedItems announced;
+    if (!g_config.contains("paths") || !g_config["paths"].contains("state_file")) {
+        return announced;
+    }
+    std::ifstream f(g_config["paths"]["state_file"].get<std::string>());
+    const json state = json::parse(f, nullptr, false);
+    if (state.is_discarded() || !state.is_object()) {
+        return announced;
+    }
+    if (state.contains("room") && state["room"].is_object()) {
+        announced.seed = state["room"].value("seed", "");
+    }
+    if (state.contains("me") && state["me"].is_object()) {
+        announced.slot = state["me"].value("slot_name", "");
+    }
+    if (state.contains("items") && state["items"].is_array()) {
+        for (const auto& it : state["items"]) {
+            if (it.is_object() && it.contains("index") && it["index"].is_number_integer()) {
+                announced.index = std::max(announced.index, it["index"].get<int64_t>());
             }
-            out["items"] = items;
-            
-            // Data storage / datapackage snapshot
-            out["data_storage"] = g_state.data_storage;
         }
+    }
+    return announced;
+}
 
-        // Copy some config bits that are useful for the bot
-        if (g_config.contains("archipelago")) {
-            out["archipelago"] = g_config["archipelago"];
+// ap_fetcher --lookup <item|location> <text...> [--limit N]
+// Ranks the names of the DataPackage saved in state.json, without connecting.
+static int run_lookup(int argc, char** argv)
+{
+    std::string kind;
+    std::string text;
+    size_t limit = 5;
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--limit" && i + 1 < argc) {
+            limit = (size_t)std::max(1, std::atoi(argv[++i]));
+        } else if (kind.empty()) {
+            kind = arg;
+        } else {
+            text += (text.empty() ? "" : " ") + arg;
         }
+    }
+    if ((kind != "item" && kind != "location") || text.empty()) {
+        std::cerr << "usage: ap_fetcher --lookup <item|location> <text...> [--limit N]" << std::endl;
+        return 2;
+    }
 
-        std::ofstream state_file(state_path, std::ios::trunc);
-        if (!state_file) {
-            log_to_file("[ERROR] Unable to open state file for writing: " + state_path);
-            return;
-        }
-        state_file << out.dump(2);
-        state_file.close();
+    std::string state_path = "data/state.json";
+    if (g_config.contains("paths") && g_config["paths"].contains("state_file")) {
+        state_path = g_config["paths"]["state_file"].get<std::string>();
     }
-    catch (const std::exception& e) {
-        log_to_file(std::string("[ERROR] save_state_to_file: ") + e.what());
+    std::ifstream f(state_path);
+    const json state = json::parse(f, nullptr, false);
+    if (state.is_discarded() || !state.contains("data_storage") || !state["data_storage"].contains("data_package")) {
+        std::cerr << "[FETCHER] No DataPackage in " << state_path << " (run the fetcher once first)" << std::endl;
+        return 1;
     }
-    catch (...) {
-        log_to_file("[ERROR] save_state_to_file: unknown exception");
+
+    std::vector<std::pair<int64_t, std::string>> names;
+    {
+        std::lock_guard<std::mutex> lock(g_state_mutex);
+        g_state.data_storage["data_package"] = state["data_storage"]["data_package"];
+        if (state.contains("me") && state["me"].contains("game") && state["me"]["game"].is_string()) {
+            g_state.game = state["me"]["game"].get<std::string>();
+        }
+        const GameNames& game_names = slot_names_locked();
+        names = kind == "item" ? game_names.items : game_names.locations;
     }
+
+    auto t0 = std::chrono::steady_clock::now();
+    NameSearch index;
+    index.build(std::move(names));
+    auto t1 = std::chrono::steady_clock::now();
+    const std::vector<NameSearch::Match> matches = index.search(text, limit);
+    auto t2 = std::chrono::steady_clock::now();
+
+    for (const NameSearch::Match& m : matches) {
+        char score[16];
+        std::snprintf(score, sizeof(score), "%.3f", m.score);
+        std::cout << score << '\t' << m.id << '\t' << *m.name << '\n';
+    }
+    std::cerr << "[FETCHER] " << index.size() << " " << kind << " names, index built in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() << " us, search in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() << " us" << std::endl;
+    return matches.empty() ? 1 : 0;
 }
 
 // ------------------------------------------------------------
 // Main
 // ------------------------------------------------------------
 
-int main()
+int main(int argc, char** argv)
 {
     try {
         // ----------------------------
@@ -220,6 +282,10 @@ int main()
             cfg >> g_config;
         }
 
+        if (argc >= 2 && std::string(argv[1]) == "--lookup") {
+            return run_lookup(argc, argv);
+        }
+
         if (!g_config.contains("archipelago")) {
             std::cerr << "[FETCHER] Missing 'archipelago' section in config" << std::endl;
             return 1;
@@ -250,13 +316,271 @@ int main()
             uuid.clear(); // empty uuid is allowed by apclientpp
         }
 
+        // ws:// ou wss:// qui a marché la dernière fois pour cet hôte, à côté du fichier UUID
+        std::string scheme_file = uuid_file.substr(0, uuid_file.find_last_of("/\\") + 1) + "ap_schemes.txt";
+        if (g_config.contains("paths") && g_config["paths"].contains("scheme_file")) {
+            scheme_file = g_config["paths"]["scheme_file"].get<std::string>();
+        }
+
         log_to_file("[AP] Starting fetcher");
         log_to_file("[AP] Connecting to " + uri + " game=" + game + " slot=" + slot_name);
 
+        // ------------------------------------------------
+        // Data package cache
+        // ------------------------------------------------
+        // By default a compiled binary copy is kept next to each cached json,
+        // so known games load without parsing the json on every start.
+        bool compiled_dp_cache = true;
+        unsigned dp_load_threads = 4;
+        int dp_max_size_mb = 512;
+        int dp_max_age_days = 90;
+        int dp_evict_interval = 3600;
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("datapackage_cache")) {
+            const json& dp_cfg = g_config["fetcher"]["datapackage_cache"];
+            compiled_dp_cache = dp_cfg.value("compiled", true);
+            dp_load_threads   = dp_cfg.value("load_threads", 4u);
+            dp_max_size_mb    = dp_cfg.value("max_size_mb", 512);
+            dp_max_age_days   = dp_cfg.value("max_age_days", 90);
+            dp_evict_interval = dp_cfg.value("evict_interval_sec", 3600);
+        }
+
+        std::unique_ptr<DefaultDataPackageStore> dp_store;
+        if (compiled_dp_cache) {
+            dp_store.reset(new CompiledDataPackageStore());
+        } else {
+            dp_store.reset(new DefaultDataPackageStore());
+        }
+        dp_store->set_cache_budget(static_cast<uint64_t>(std::max(dp_max_size_mb, 0)) * 1024 * 1024,
+                                   std::chrono::hours(24) * std::max(dp_max_age_days, 0));
+
+        // Eviction scans the whole cache folder, keep it off the network thread
+        std::unique_ptr<PeriodicTask> dp_evict_task;
+        if (dp_evict_interval > 0) {
+            dp_evict_task.reset(new PeriodicTask(std::chrono::seconds(dp_evict_interval), [&dp_store]() {
+                trace::Span span("datapackage_evict", "cache");
+                if (!dp_store->evict()) {
+                    return;
+                }
+                auto stats = dp_store->get_stats();
+                log_to_file("[AP] Data package cache: " + std::to_string(stats.cacheFiles) + " files, " +
+                            std::to_string(stats.cacheBytes / 1024) + " KiB, evicted " +
+                            std::to_string(stats.evictedFiles) + " files so far");
+            }));
+        }
+
+        // ------------------------------------------------
+        // Session capture (fetcher.capture_file), rejouable avec ap_replay
+        // ------------------------------------------------
+        CaptureWriter capture;
+        std::string capture_file;
+        if (g_config.contains("fetcher")) {
+            capture_file = g_config["fetcher"].value("capture_file", std::string(""));
+        }
+        if (!capture_file.empty() && !capture.open(capture_file)) {
+            log_to_file("[WARN] Unable to open capture file: " + capture_file);
+        }
+
         // ------------------------------------------------
         // Instantiate APClient
         // ------------------------------------------------
-        APClient client(uuid, game, uri);
+        APClient client(uuid, game, uri, "", dp_store.get(), scheme_file);
+
+        // ------------------------------------------------
+        // Métriques Prometheus (fetcher.metrics), désactivées par défaut
+        // ------------------------------------------------
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("metrics")) {
+            const json& m_cfg = g_config["fetcher"]["metrics"];
+            if (m_cfg.value("enabled", false)) {
+                const std::string m_bind = m_cfg.value("bind", std::string("127.0.0.1"));
+                const int m_port = m_cfg.value("port", 9464);
+                if (metrics::start_server(m_bind, m_port)) {
+                    log_to_file("[INFO] Metrics on http://" + m_bind + ":" + std::to_string(m_port) + "/metrics");
+                } else {
+                    log_to_file("[WARN] Unable to serve metrics on " + m_bind + ":" + std::to_string(m_port));
+                }
+            }
+        }
+
+        // ------------------------------------------------
+        // Serveur de requêtes pour le bot (fetcher.query), désactivé par défaut
+        // ------------------------------------------------
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("query")) {
+            const json& q_cfg = g_config["fetcher"]["query"];
+            if (q_cfg.value("enabled", false)) {
+                const std::string q_socket = q_cfg.value("socket", std::string("data/fetcher.sock"));
+                if (query::start_server(q_socket)) {
+                    log_to_file("[INFO] Answering queries on " + q_socket);
+                } else {
+                    log_to_file("[WARN] Unable to serve queries on " + q_socket);
+                }
+            }
+        }
+
+        // ------------------------------------------------
+        // Événements poussés aux bots abonnés (fetcher.fanout), désactivé par défaut
+        // ------------------------------------------------
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("fanout")) {
+            const json& f_cfg = g_config["fetcher"]["fanout"];
+            if (f_cfg.value("enabled", false)) {
+                fanout::Config fc;
+                fc.max_subscribers = f_cfg.value("max_subscribers", fc.max_subscribers);
+                fc.max_queue       = f_cfg.value("max_queue", fc.max_queue);
+                fc.resync          = f_cfg.value("slow_subscribers", std::string("resync")) != "drop";
+                const std::string f_socket = f_cfg.value("socket", std::string("data/fetcher-events.sock"));
+                if (fanout::start(f_socket, fc)) {
+                    log_to_file("[INFO] Publishing events on " + f_socket);
+                } else {
+                    log_to_file("[WARN] Unable to publish events on " + f_socket);
+                }
+            }
+        }
+
+        // ------------------------------------------------
+        // Annonces des items pour le chat (fetcher.announce), lues par le bot via fetcher.query
+        // ------------------------------------------------
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("announce")) {
+            const json& a_cfg = g_config["fetcher"]["announce"];
+            if (a_cfg.value("enabled", false)) {
+                announce::Config ac;
+                ac.window_ms       = a_cfg.value("window_ms", ac.window_ms);
+                ac.max_individual  = a_cfg.value("max_individual", ac.max_individual);
+                ac.rate_messages   = a_cfg.value("rate_messages", ac.rate_messages);
+                ac.rate_period_sec = a_cfg.value("rate_period_sec", ac.rate_period_sec);
+                ac.burst           = a_cfg.value("burst", ac.burst);
+                ac.max_queue       = a_cfg.value("max_queue", ac.max_queue);
+                ac.player          = slot_name;
+
+                // Même fichier que le bot (bot_settings.language), ces textes servent si une clé manque
+                MessageTemplates templates;
+                templates.add("item_auto", "%player a obtenu %item_name (%location_name) – %a / %b checks (%c%) complétés – %d restants.");
+                templates.add("item_auto_key", "%player a obtenu %item_name (%location_name) – %a / %b checks (%c%) complétés – %d restants.");
+                templates.add("item_batch", "%player a obtenu %count items (%sources) – %a / %b checks (%c%) complétés – %d restants.");
+                templates.add("item_batch_source", "%count de %from_player");
+                std::string language = "en";
+                if (g_config.contains("bot_settings")) {
+                    language = g_config["bot_settings"].value("language", language);
+                }
+                const std::string messages_file = "config/messages." + language + ".json";
+                std::string error;
+                if (!templates.load_file(messages_file, error)) {
+                    log_to_file("[WARN] Announcements use the default texts: " + error);
+                }
+                announce::start(ac, std::move(templates));
+                log_to_file("[INFO] Announcing items, " + std::to_string(ac.window_ms) + " ms windows");
+            }
+        }
+
+        // ------------------------------------------------
+        // Traces Chrome (fetcher.trace), écrites sur SIGUSR2 ou !aptrace
+        // ------------------------------------------------
+        std::string trace_file = "logs/fetcher_trace.json";
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("trace")) {
+            const json& t_cfg = g_config["fetcher"]["trace"];
+            trace_file = t_cfg.value("file", trace_file);
+            if (t_cfg.value("enabled", false)) {
+                trace::start(t_cfg.value("buffer_events", 16384u));
+                trace::set_thread_name("poll");
+#ifdef SIGUSR2
+                std::signal(SIGUSR2, request_trace_dump);
+#endif
+                log_to_file("[INFO] Tracing enabled, dump with SIGUSR2 or !aptrace to " + trace_file);
+            }
+        }
+        // le bot (!aptrace) crée ce fichier pour demander un dump
+        const std::string trace_request_file = trace_file + ".request";
+
+        if (metrics::enabled() || trace::enabled()) {
+            client.set_profile_handler([](APClient::ProfilePhase phase, const std::string& cmd,
+                                          APClient::ProfileTime start, APClient::ProfileTime end) {
+                switch (phase) {
+                case APClient::ProfilePhase::PARSE:
+                    metrics::observe(metrics::PARSE_SECONDS, end - start);
+                    trace::complete("parse", "apclient", start, end);
+                    break;
+                case APClient::ProfilePhase::VALIDATE:
+                    // la validation d'une commande est comptée dans handler_seconds
+                    if (cmd.empty()) {
+                        metrics::observe(metrics::VALIDATE_SECONDS, end - start);
+                    }
+                    trace::complete(cmd.empty() ? std::string("packet") : cmd, "validate", start, end);
+                    break;
+                case APClient::ProfilePhase::COMMAND:
+                    metrics::add_command(false, cmd);
+                    metrics::observe(metrics::HANDLER_SECONDS, end - start, cmd);
+                    trace::complete(cmd, "command", start, end);
+                    break;
+                case APClient::ProfilePhase::DATA_PACKAGE:
+                    trace::complete(cmd, "datapackage", start, end);
+                    break;
+                }
+            });
+        }
+
+        if (capture.is_open()) {
+            log_to_file("[INFO] Recording session to " + capture_file);
+        }
+        if (capture.is_open() || metrics::enabled()) {
+            client.set_frame_handler([&capture](bool outgoing, const std::string& frame) {
+                metrics::record_frame(outgoing, frame);
+                if (!capture.is_open()) {
+                    return;
+                }
+                if (!outgoing) {
+                    capture.write(CaptureFrame::RECEIVED, frame);
+                } else if (frame.find("\"password\"") != std::string::npos) {
+                    // ne jamais écrire le mot de passe de la room dans une capture
+                    json packet = json::parse(frame, nullptr, false);
+                    if (packet.is_array()) {
+                        for (auto& command : packet) {
+                            if (command.is_object() && command.contains("password")) {
+                                command["password"] = "";
+                            }
+                        }
+                    }
+                    capture.write(CaptureFrame::SENT, packet.is_discarded() ? std::string("[]") : packet.dump());
+                } else {
+                    capture.write(CaptureFrame::SENT, frame);
+                }
+            });
+        }
+
+        memory_report::Sources mem_sources;
+        mem_sources.client = &client;
+        mem_sources.capture_open = capture.is_open();
+
+        // permessage-deflate: des fenêtres plus petites réduisent la mémoire zlib par connexion,
+        // au prix d'une moins bonne compression des gros DataPackage.
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("compression")) {
+            const json& z_cfg = g_config["fetcher"]["compression"];
+            wswrap::compression_options compression;
+            compression.enabled                    = z_cfg.value("enabled", true);
+            compression.server_max_window_bits     = z_cfg.value("server_max_window_bits", 15);
+            compression.client_max_window_bits     = z_cfg.value("client_max_window_bits", 15);
+            compression.client_no_context_takeover = z_cfg.value("client_no_context_takeover", false);
+            client.set_compression_options(compression);
+        }
+
+        // Cached data packages are loaded in the background on RoomInfo so
+        // ConnectSlot goes out right away, even for rooms with many games.
+        client.set_data_package_load_threads(dp_load_threads);
+
+        // Les commandes envoyées pendant un poll() partent dans une seule frame.
+        if (g_config.contains("fetcher")) {
+            client.set_batch_commands(g_config["fetcher"].value("batch_commands", false));
+        }
+
+        // Reconnexion: backoff exponentiel avec jitter, et mode rapide juste après
+        // une coupure (ex: redémarrage du serveur) pour revenir au plus vite.
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("reconnect")) {
+            const json& r_cfg = g_config["fetcher"]["reconnect"];
+            client.set_reconnect_backoff(r_cfg.value("min_ms", 1500UL),
+                                         r_cfg.value("max_ms", 15000UL),
+                                         r_cfg.value("jitter", 0.0));
+            client.set_fast_reconnect(r_cfg.value("fast_interval_ms", 0UL),
+                                      r_cfg.value("fast_window_sec", 0UL) * 1000);
+        }
+
+        AnnouncedItems announced = load_announced_items();
 
         // ------------------------------------------------
         // Handlers
@@ -264,19 +588,23 @@ int main()
 
         // Socket-level events
         client.set_socket_connected_handler([&]() {
+            trace::Span span("on_socket_connected", "handler");
             log_to_file("[AP] Socket connected");
         });
 
         client.set_socket_error_handler([&](const std::string& err) {
+            trace::Span span("on_socket_error", "handler");
             log_to_file(std::string("[AP] Socket error: ") + err);
         });
 
         client.set_socket_disconnected_handler([&]() {
+            trace::Span span("on_socket_disconnected", "handler");
             log_to_file("[AP] Socket disconnected");
         });
 
         // RoomInfo: called once we know the room, seed, versions, etc.
         client.set_room_info_handler([&]() {
+            trace::Span span("on_room_info", "handler");
             log_to_file("[AP] RoomInfo received");
 
             {   
@@ -287,6 +615,7 @@ int main()
                 g_state.hint_points       = client.get_hint_points();
                 g_state.hint_cost_percent = client.get_hint_cost_percent();
                 // room_name non exposé directement, on pourra l’ajouter plus tard via datapackage
+                g_state_generation++;
             }
 
             // IMPORTANT : on sauvegarde en dehors du lock
@@ -322,6 +651,7 @@ int main()
 
         // SlotConnected: we now know who we are (slot/team/etc.)
         client.set_slot_connected_handler([&](const json& slot_data) {
+            trace::Span span("on_slot_connected", "handler");
             log_to_file("[AP] SlotConnected");
 
             {
@@ -345,8 +675,15 @@ int main()
                     g_state.team_id = slot_data["team"].get<int>();
                 }
 
+                // Toutes les locations du slot: checked + missing
+                std::vector<int64_t> universe = client.get_checked_location_set().to_vector();
+                std::vector<int64_t> missing = client.get_missing_location_set().to_vector();
+                universe.insert(universe.end(), missing.begin(), missing.end());
+                g_state.checked_locations.set_universe(std::move(universe));
+
                 // On garde le JSON brut pour le bot si besoin
                 g_state.data_storage["slot_data"] = slot_data;
+                g_state_generation++;
             }
 
             // Sauvegarde en dehors du lock
@@ -354,45 +691,122 @@ int main()
         });
 
         client.set_slot_disconnected_handler([&]() {
+            trace::Span span("on_slot_disconnected", "handler");
             log_to_file("[AP] SlotDisconnected");
         });
 
         // Data package: texts, item/location names, etc.
         client.set_data_package_changed_handler([&](const json& dp) {
+            trace::Span span("on_data_package_changed", "handler");
             log_to_file("[AP] DataPackageChanged");
             {
                 std::lock_guard<std::mutex> lock(g_state_mutex);
                 g_state.data_storage["data_package"] = dp;
+                g_state.data_package_generation++;
+                g_state_generation++;
             }
             save_state_to_file();
         });
 
         // Location checks (our local checks, or sync)
         client.set_location_checked_handler([&](const std::list<int64_t>& locations) {
+            trace::Span span("on_location_checked", "handler");
             std::lock_guard<std::mutex> lock(g_state_mutex);
             for (auto loc : locations) {
                 g_state.checked_locations.insert(loc);
             }
+            g_state_generation++;
             log_to_file("[AP] LocationChecked: +" + std::to_string(locations.size()));
             // Le flush disque se fait dans la boucle principale pour éviter de spammer.
         });
 
         // ItemsReceived: all items that go to this slot
         client.set_items_received_handler([&](const std::list<APClient::NetworkItem>& items) {
+            trace::Span span("on_items_received", "handler");
             std::time_t now = std::time(nullptr);
+            const auto received_at = client.get_frame_time();
+            const double server_time = client.get_server_time();
 
+            size_t item_count = 0;
             {
                 std::lock_guard<std::mutex> lock(g_state_mutex);
                 for (const auto& it : items) {
                     FetcherState::ItemEvent evt;
-                    evt.index     = it.index;
-                    evt.item      = it.item;
-                    evt.location  = it.location;
-                    evt.player    = it.player;
-                    evt.flags     = it.flags;
-                    evt.timestamp = now;
+                    evt.index       = it.index;
+                    evt.item        = it.item;
+                    evt.location    = it.location;
+                    evt.player      = it.player;
+                    evt.flags       = it.flags;
+                    evt.timestamp   = now;
+                    evt.server_time = server_time;
+                    evt.received_at = received_at;
                     g_state.items.push_back(evt);
                 }
+                item_count = g_state.items.size();
+                g_state_generation++;
+                const auto handled_at = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < items.size(); i++) {
+                    record_item_latency(ItemLatency::HANDLED, received_at, handled_at);
+                }
+            }
+
+            // seulement les items pas encore annoncés: pas l'historique renvoyé à la connexion
+            std::vector<const APClient::NetworkItem*> fresh;
+            if (client.get_seed() != announced.seed || client.get_slot() != announced.slot) {
+                announced.seed  = client.get_seed();
+                announced.slot  = client.get_slot();
+                announced.index = -1;
+            }
+            for (const auto& it : items) {
+                if (it.index > announced.index) {
+                    fresh.push_back(&it);
+                    announced.index = it.index;
+                }
+            }
+
+            if ((announce::enabled() || fanout::enabled()) && !fresh.empty()) {
+                const std::string& my_game = client.get_game();
+                std::vector<announce::Item> batch;
+                batch.reserve(fresh.size());
+                for (const APClient::NetworkItem* item : fresh) {
+                    const auto& it = *item;
+                    announce::Item a;
+                    a.item          = it.item;
+                    a.location      = it.location;
+                    a.item_name     = client.get_item_name(it.item, my_game);
+                    a.location_name = client.get_location_name(it.location, client.get_player_game(it.player));
+                    a.from_player   = client.get_player_alias(it.player);
+                    // même repli que le bot quand le DataPackage ne connaît pas l'id
+                    if (a.item_name == "Unknown")
+                        a.item_name = "Item " + std::to_string(it.item);
+                    if (a.location_name == "Unknown")
+                        a.location_name = "Loc " + std::to_string(it.location);
+                    a.key = key_items::is_key_item(my_game, it.item, a.item_name);
+                    batch.push_back(std::move(a));
+                }
+                if (fanout::enabled()) {
+                    json list = json::array();
+                    size_t i = 0;
+                    for (const APClient::NetworkItem* item : fresh) {
+                        const auto& it = *item;
+                        const announce::Item& a = batch[i++];
+                        list.push_back({
+                            {"index", it.index},
+                            {"item", it.item},
+                            {"location", it.location},
+                            {"player", it.player},
+                            {"flags", it.flags},
+                            {"item_name", a.item_name},
+                            {"location_name", a.location_name},
+                            {"from_player", a.from_player},
+                            {"key", a.key},
+                        });
+                    }
+                    fanout::publish("items", {{"items", list}, {"item_count", item_count}});
+                }
+                if (announce::enabled()) {
+                    announce::add_items(std::move(batch), std::chrono::steady_clock::now());
+                }
             }
 
             log_to_file("[AP] ReceivedItems: +" + std::to_string(items.size()));
@@ -401,15 +815,21 @@ int main()
 
         // Chat / print JSON: on log tout, le bot pourra parser si besoin
         client.set_print_json_handler([&](const json& msg) {
+            trace::Span span("on_print_json", "handler");
             log_to_file(std::string("[AP] PrintJSON: ") + msg.dump());
         });
 
         // Retrieved handler (DataStorage Get replies) – gardé pour plus tard
         client.set_retrieved_handler([&](const std::map<std::string, json>& map) {
-            std::lock_guard<std::mutex> lock(g_state_mutex);
-            for (const auto& kv : map) {
-                g_state.data_storage["retrieved"][kv.first] = kv.second;
+            trace::Span span("on_retrieved", "handler");
+            {
+                std::lock_guard<std::mutex> lock(g_state_mutex);
+                for (const auto& kv : map) {
+                    g_state.data_storage["retrieved"][kv.first] = kv.second;
+                }
+                g_state_generation++;
             }
+            // save_state_to_file() prend le lock lui-même
             save_state_to_file();
         });
 
@@ -425,15 +845,138 @@ int main()
             }
         }
 
+        // Objectif de latence des items (frame reçue -> state.json écrit), voir fetcher.item_latency
+        if (g_config.contains("fetcher")) {
+            std::lock_guard<std::mutex> lock(g_state_mutex);
+            g_state.item_latency.set_slo_ms(g_config["fetcher"].value("item_latency_slo_ms", 500.0));
+        }
+
+        // ------------------------------------------------
+        // Rapport mémoire: périodique (interval_sec, 0 = jamais) et sur SIGUSR1
+        // ------------------------------------------------
+        std::string memory_report_file = "logs/fetcher_memory.jsonl";
+        int memory_report_interval = 0;
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("memory_report")) {
+            const json& mr_cfg = g_config["fetcher"]["memory_report"];
+            memory_report_file     = mr_cfg.value("file", memory_report_file);
+            memory_report_interval = mr_cfg.value("interval_sec", 0);
+        }
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, request_memory_report);
+#endif
+
+        // ------------------------------------------------
+        // Snapshot binaire pour libapstate (fetcher.state_snapshot), écrit avec state.json
+        // ------------------------------------------------
+        std::string snapshot_file;
+        if (g_config.contains("fetcher") && g_config["fetcher"].contains("state_snapshot")) {
+            const json& s_cfg = g_config["fetcher"]["state_snapshot"];
+            if (s_cfg.value("enabled", false)) {
+                snapshot_file = s_cfg.value("file", std::string("data/state.apstate"));
+                log_to_file("[INFO] Writing the state snapshot to " + snapshot_file);
+            }
+        }
+        uint64_t snapshot_generation = 0;
+        bool snapshot_written = false;
+        bool snapshot_failed = false;
+
+        // Derniers événements publiés par fanout (progress, announce)
+        uint64_t fanout_generation = 0;
+        int64_t fanout_announce_seq = announce::enabled() ? announce::last_seq() : 0;
+
         using clock = std::chrono::steady_clock;
         auto last_flush = clock::now();
+        auto last_memory_report = clock::now();
 
         while (true) {
             client.poll();
 
+            if (metrics::enabled()) {
+                metrics::set(metrics::CONNECTION_STATE, static_cast<int64_t>(client.get_state()));
+                metrics::set(metrics::RECONNECTS, client.get_connect_timings().reconnects);
+                metrics::set(metrics::OUTGOING_QUEUE, static_cast<int64_t>(client.get_batch_size()));
+                std::lock_guard<std::mutex> lock(g_state_mutex);
+                metrics::set(metrics::STATE_ITEMS, static_cast<int64_t>(g_state.items.size()));
+            }
+
+            if (announce::enabled()) {
+                announce::tick(clock::now());
+            }
+
+            if (fanout::enabled()) {
+                if (announce::enabled() && announce::last_seq() != fanout_announce_seq) {
+                    json released = announce::released_after(fanout_announce_seq);
+                    fanout_announce_seq = released["seq"].get<int64_t>();
+                    {
+                        // comme la query "announcements", pour reprendre avec state.json
+                        std::lock_guard<std::mutex> lock(g_state_mutex);
+                        released["item_count"] = g_state.items.size();
+                    }
+                    fanout::publish("announce", released);
+                }
+                const uint64_t generation = g_state_generation.load();
+                if (generation != fanout_generation) {
+                    json progress;
+                    {
+                        std::lock_guard<std::mutex> lock(g_state_mutex);
+                        progress = {
+                            {"generation", generation},
+                            {"checks_done", g_state.checked_locations.size()},
+                            {"location_count", location_count_locked()},
+                            {"item_count", g_state.items.size()},
+                        };
+                    }
+                    fanout::publish("progress", progress, true);
+                    fanout_generation = generation;
+                }
+            }
+
+            if (g_trace_dump_requested) {
+                g_trace_dump_requested = 0;
+                dump_trace(trace_file);
+            }
+
             auto now = clock::now();
+            if (g_memory_report_requested ||
+                (memory_report_interval > 0 &&
+                 std::chrono::duration_cast<std::chrono::seconds>(now - last_memory_report).count() >= memory_report_interval)) {
+                g_memory_report_requested = 0;
+                write_memory_report(memory_report_file, mem_sources);
+                last_memory_report = now;
+            }
             if (std::chrono::duration_cast<std::chrono::seconds>(now - last_flush).count() >= flush_interval) {
+                {
+                    auto dp_stats = dp_store->get_stats();
+                    const json announce_stats = announce::enabled() ? announce::stats() : json();
+                    const json fanout_stats = fanout::enabled() ? fanout::stats() : json();
+                    metrics::set(metrics::DATAPACKAGE_CACHE_HITS, static_cast<int64_t>(dp_stats.hits));
+                    metrics::set(metrics::DATAPACKAGE_CACHE_MISSES, static_cast<int64_t>(dp_stats.misses));
+                    std::lock_guard<std::mutex> lock(g_state_mutex);
+                    g_state.fetcher["datapackage_cache"] = cache_stats_to_json(dp_stats);
+                    g_state.fetcher["connection"] = connect_timings_to_json(client.get_connect_timings());
+                    if (!announce_stats.is_null()) {
+                        g_state.fetcher["announce"] = announce_stats;
+                    }
+                    if (!fanout_stats.is_null()) {
+                        g_state.fetcher["fanout"] = fanout_stats;
+                    }
+                }
+                capture.flush();
                 save_state_to_file();
+                if (!snapshot_file.empty() && (!snapshot_written || g_state_generation.load() != snapshot_generation)) {
+                    const uint64_t generation = g_state_generation.load();
+                    if (write_state_snapshot(snapshot_file)) {
+                        snapshot_generation = generation;
+                        snapshot_written = true;
+                        snapshot_failed = false;
+                    } else if (!snapshot_failed) {
+                        log_to_file("[WARN] Unable to write the state snapshot: " + snapshot_file);
+                        snapshot_failed = true;
+                    }
+                }
+                if (trace::enabled() && std::remove(trace_request_file.c_str()) == 0) {
+                    dump_trace(trace_file);
+                }
                 last_flush = now;
             }
 
@@ -0,0 +1,114 @@
+#include "memory_report.hpp"
+
+#include <ctime>
+#include <fstream>
+#include <mutex>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "state.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+namespace memory_report {
+
+uint64_t rss_bytes()
+{
+#ifndef _WIN32
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    if (statm >> size >> resident) {
+        return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+size_t deflate_bytes(int window_bits, int mem_level)
+{
+    // zconf.h: (1 << (windowBits+2)) + (1 << (memLevel+9)), plus ~6 KiB of state
+    return ((size_t)1 << (window_bits + 2)) + ((size_t)1 << (mem_level + 9)) + 6 * 1024;
+}
+
+json build(const Sources& sources)
+{
+    json report = json::object();
+    report["time"] = std::time(nullptr);
+
+    HeapStats heap = heap_stats();
+    json process = json::object();
+    process["rss_bytes"] = rss_bytes();
+    if (heap.available) {
+        process["heap_live_bytes"]   = heap.live_bytes;
+        process["heap_peak_bytes"]   = heap.peak_bytes;
+        process["heap_allocations"]  = heap.allocations;
+        process["heap_frees"]        = heap.frees;
+    }
+    report["process"] = process;
+
+    uint64_t total = 0;
+    auto put = [&total](json& section, const char* key, uint64_t bytes) {
+        section[key] = bytes;
+        total += bytes;
+    };
+
+    if (sources.client) {
+        APClient::MemoryUsage usage = sources.client->get_memory_usage();
+        json apclient = json::object();
+        put(apclient, "data_package", usage.dataPackage);
+        put(apclient, "name_maps", usage.nameMaps);
+        put(apclient, "name_indexes", usage.nameIndexes);
+        put(apclient, "locations", usage.locations);
+        put(apclient, "players", usage.players);
+        put(apclient, "queues", usage.queues);
+        report["apclient"] = apclient;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_state_mutex);
+        json state = json::object();
+        uint64_t data_package = 0;
+        uint64_t slot_data = 0;
+        auto it_dp = g_state.data_storage.find("data_package");
+        if (it_dp != g_state.data_storage.end()) {
+            data_package = APClient::estimate_json_bytes(*it_dp);
+        }
+        auto it_slot = g_state.data_storage.find("slot_data");
+        if (it_slot != g_state.data_storage.end()) {
+            slot_data = APClient::estimate_json_bytes(*it_slot);
+        }
+        put(state, "data_package", data_package);
+        put(state, "slot_data", slot_data);
+        put(state, "data_storage_other", APClient::estimate_json_bytes(g_state.data_storage) - data_package - slot_data);
+        put(state, "items", g_state.items.capacity() * sizeof(FetcherState::ItemEvent));
+        put(state, "checked_locations", g_state.checked_locations.memory_bytes());
+        put(state, "fetcher", APClient::estimate_json_bytes(g_state.fetcher));
+        report["state"] = state;
+    }
+
+    json buffers = json::object();
+    // counted by wswrap's zlib allocator, not estimated
+    put(buffers, "zlib", APClient::get_compression_memory_usage());
+    // gzopen() defaults: 15 bits window, memLevel 8, 8 KiB input and 16 KiB output buffers
+    put(buffers, "capture", sources.capture_open ? deflate_bytes(15, 8) + 24 * 1024 : 0);
+    put(buffers, "trace", trace::memory_bytes());
+    put(buffers, "metrics", metrics::memory_bytes());
+    report["buffers"] = buffers;
+
+    report["estimated_bytes"] = total;
+    return report;
+}
+
+bool append(const std::string& path, const json& report)
+{
+    std::ofstream out(path, std::ios::app);
+    if (!out) {
+        return false;
+    }
+    out << report.dump() << '\n';
+    return (bool)out;
+}
+
+} // namespace memory_report
@@ -0,0 +1,55 @@
+#ifndef _FETCHER_MEMORY_REPORT_HPP
+#define _FETCHER_MEMORY_REPORT_HPP
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nlohmann/json.hpp>
+
+// apclientpp
+#include "apclient.hpp"
+
+// ------------------------------------------------------------
+// Rapport mémoire du fetcher (fetcher.memory_report)
+//
+//   Estime les octets par composant (DataPackage en json, tables
+//   de noms d'APClient, state, buffers zlib/trace/métriques) et les
+//   met à côté du RSS et des octets vivants alloués par operator new
+//   (alloc_hook.cpp). Une ligne JSON par rapport, pour suivre une
+//   fuite sur plusieurs jours.
+// ------------------------------------------------------------
+
+namespace memory_report {
+
+// Counted by the operator new/delete replacements in alloc_hook.cpp
+struct HeapStats {
+    bool available = false; // false where the hook can't size allocations
+    uint64_t live_bytes = 0;
+    uint64_t peak_bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+};
+
+HeapStats heap_stats();
+
+// Resident set size from /proc, 0 if unknown
+uint64_t rss_bytes();
+
+// zlib's documented memory use of one deflate stream
+size_t deflate_bytes(int window_bits, int mem_level);
+
+struct Sources {
+    const APClient* client = nullptr;
+    bool capture_open = false;
+};
+
+// Builds a report. Locks g_state_mutex while sizing the fetcher state.
+nlohmann::json build(const Sources& sources);
+
+// Appends the report to path as one line. Returns false if the file could not be written.
+bool append(const std::string& path, const nlohmann::json& report);
+
+} // namespace memory_report
+
+#endif // _FETCHER_MEMORY_REPORT_HPP
@@ -0,0 +1,183 @@
+#include "message_templates.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+bool is_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool is_trailing_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+} // namespace
+
+bool MessageTemplates::load_file(const std::string& path, std::string& error)
+{
+    std::ifstream f(path);
+    if (!f) {
+        error = "unable to open " + path;
+        return false;
+    }
+    nlohmann::json j = nlohmann::json::parse(f, nullptr, false);
+    if (!j.is_object()) {
+        error = path + " is not a JSON object";
+        return false;
+    }
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        if (it.key().empty() || it.key()[0] == '_' || !it.value().is_string())
+            continue;
+        add(it.key(), it.value().get<std::string>());
+    }
+    return true;
+}
+
+int MessageTemplates::intern(const std::string& name)
+{
+    auto it = placeholder_ids_.find(name);
+    if (it != placeholder_ids_.end())
+        return it->second;
+    int id = (int)placeholder_names_.size();
+    placeholder_names_.push_back(name);
+    placeholder_ids_.emplace(name, id);
+    return id;
+}
+
+void MessageTemplates::add(const std::string& key, const std::string& text)
+{
+    Template t;
+    t.text = text;
+
+    // "%nom" = '%' suivi de [A-Za-z0-9_]+, le reste est littéral ("%c%)" -> %c puis "%)")
+    size_t literal_start = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        if (text[i] != '%' || i + 1 >= text.size() || !is_name_char(text[i + 1])) {
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < text.size() && is_name_char(text[end]))
+            end++;
+        if (i > literal_start)
+            t.tokens.push_back({(uint32_t)literal_start, (uint32_t)(i - literal_start), -1});
+        t.tokens.push_back({(uint32_t)i, (uint32_t)(end - i), intern(text.substr(i + 1, end - i - 1))});
+        literal_start = i = end;
+    }
+    if (text.size() > literal_start)
+        t.tokens.push_back({(uint32_t)literal_start, (uint32_t)(text.size() - literal_start), -1});
+
+    auto it = ids_.find(key);
+    if (it != ids_.end()) {
+        templates_[it->second] = std::move(t);
+    } else {
+        ids_.emplace(key, (int)templates_.size());
+        templates_.push_back(std::move(t));
+    }
+}
+
+int MessageTemplates::find(const std::string& key) const
+{
+    auto it = ids_.find(key);
+    return it == ids_.end() ? -1 : it->second;
+}
+
+int MessageTemplates::placeholder(const std::string& name) const
+{
+    auto it = placeholder_ids_.find(name);
+    return it == placeholder_ids_.end() ? -1 : it->second;
+}
+
+bool MessageTemplates::render(int id, const Args& args, std::string& out) const
+{
+    out.clear();
+    if (id < 0 || (size_t)id >= templates_.size())
+        return false;
+
+    const Template& t = templates_[id];
+    char num[64];
+    for (const Token& token : t.tokens) {
+        const Value* v = token.placeholder < 0 ? nullptr : args.get(token.placeholder);
+        if (!v || v->kind == Value::NONE) {
+            // littéral, ou placeholder sans valeur laissé tel quel
+            out.append(t.text, token.offset, token.length);
+            continue;
+        }
+        switch (v->kind) {
+        case Value::TEXT:
+            out.append(v->text.data(), v->text.size());
+            break;
+        case Value::INT: {
+            auto res = std::to_chars(num, num + sizeof(num), v->i);
+            out.append(num, res.ptr);
+            break;
+        }
+        case Value::FLOAT: {
+            int n = std::snprintf(num, sizeof(num), "%.*f", v->precision, v->f);
+            if (n > 0)
+                out.append(num, std::min<size_t>((size_t)n, sizeof(num) - 1));
+            break;
+        }
+        case Value::NONE:
+            break;
+        }
+    }
+    return true;
+}
+
+void split_chat_lines(std::string_view text, size_t max_chars, std::vector<std::string_view>& out)
+{
+    out.clear();
+    if (max_chars == 0)
+        max_chars = MAX_TWITCH_MESSAGE_LENGTH;
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos)
+            eol = text.size();
+        std::string_view line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        // "\r\n", ou un "\r" seul comme splitlines()
+        size_t cr = line.find('\r');
+        if (cr != std::string_view::npos) {
+            pos -= line.size() - cr;
+            if (cr + 1 == line.size())
+                pos++;
+            line = line.substr(0, cr);
+        }
+
+        while (!line.empty() && is_trailing_space(line.back()))
+            line.remove_suffix(1);
+
+        // Coupe tous les max_chars points de code, jamais au milieu d'une séquence UTF-8
+        while (!line.empty()) {
+            if (line.size() <= max_chars) { // au moins un octet par caractère
+                out.push_back(line);
+                break;
+            }
+            size_t chars = 0;
+            size_t cut = line.size();
+            for (size_t i = 0; i < line.size(); i++) {
+                if (((unsigned char)line[i] & 0xC0) == 0x80)
+                    continue; // octet de continuation
+                if (chars == max_chars) {
+                    cut = i;
+                    break;
+                }
+                chars++;
+            }
+            out.push_back(line.substr(0, cut));
+            line.remove_prefix(cut);
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef _FETCHER_MESSAGE_TEMPLATES_HPP
+#define _FETCHER_MESSAGE_TEMPLATES_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// Templates de messages (config/messages.<langue>.json)
+//
+//   Même syntaxe que MessageManager côté Python: "%nom" est remplacé
+//   par la valeur fournie, un %nom sans valeur reste tel quel. Chaque
+//   template est compilé une fois au chargement en une liste de
+//   morceaux (texte littéral / placeholder) pour que le rendu ne fasse
+//   que des copies dans un buffer réutilisé.
+//
+//   split_chat_lines() découpe comme _send_split du bot: une ligne par
+//   message, 450 caractères max, sans couper un caractère UTF-8.
+// ------------------------------------------------------------
+
+constexpr size_t MAX_TWITCH_MESSAGE_LENGTH = 450;
+
+class MessageTemplates {
+public:
+    // A placeholder value. Text is not copied: it must outlive the render call.
+    struct Value {
+        enum Kind { NONE, TEXT, INT, FLOAT } kind = NONE;
+        std::string_view text;
+        int64_t i = 0;
+        double f = 0;
+        int precision = 1; // FLOAT: digits after the point, like "{:.1f}" in the bot
+    };
+
+    // Values indexed by placeholder id, reusable between renders
+    class Args {
+    public:
+        void set(int id, std::string_view text)
+        {
+            if (Value* v = slot(id)) {
+                v->kind = Value::TEXT;
+                v->text = text;
+            }
+        }
+
+        void set(int id, int64_t i)
+        {
+            if (Value* v = slot(id)) {
+                v->kind = Value::INT;
+                v->i = i;
+            }
+        }
+
+        void set(int id, int i)
+        {
+            set(id, static_cast<int64_t>(i));
+        }
+
+        void set(int id, double f, int precision = 1)
+        {
+            if (Value* v = slot(id)) {
+                v->kind = Value::FLOAT;
+                v->f = f;
+                v->precision = precision;
+            }
+        }
+
+        void clear()
+        {
+            for (auto& v : values_)
+                v.kind = Value::NONE;
+        }
+
+        const Value* get(int id) const
+        {
+            return id >= 0 && (size_t)id < values_.size() ? &values_[id] : nullptr;
+        }
+
+    private:
+        friend class MessageTemplates;
+
+        Value* slot(int id)
+        {
+            if (id < 0) // unknown placeholder: nothing uses it
+                return nullptr;
+            if ((size_t)id >= values_.size())
+                values_.resize((size_t)id + 1);
+            return &values_[id];
+        }
+
+        std::vector<Value> values_;
+    };
+
+    // Loads a messages JSON object. Keys starting with '_' (like "_meta") and
+    // non-string values are skipped. Returns false and sets error on failure.
+    bool load_file(const std::string& path, std::string& error);
+
+    // Compiles text as template key, replacing any previous one
+    void add(const std::string& key, const std::string& text);
+
+    // Template id for key, or -1
+    int find(const std::string& key) const;
+
+    // Placeholder id for a name without '%' ("item_name"), or -1 if no template uses it
+    int placeholder(const std::string& name) const;
+
+    size_t size() const
+    {
+        return templates_.size();
+    }
+
+    Args make_args() const
+    {
+        Args args;
+        args.values_.resize(placeholder_names_.size());
+        return args;
+    }
+
+    // Renders template id into out (cleared first, capacity kept). Returns false for an unknown id.
+    bool render(int id, const Args& args, std::string& out) const;
+
+private:
+    struct Token {
+        uint32_t offset;    // literal: offset in text, placeholder: offset of the '%'
+        uint32_t length;    // literal: length, placeholder: length including the '%'
+        int placeholder;    // -1 for a literal
+    };
+
+    struct Template {
+        std::string text;
+        std::vector<Token> tokens;
+    };
+
+    int intern(const std::string& name);
+
+    std::vector<Template> templates_;
+    std::unordered_map<std::string, int> ids_;
+    std::unordered_map<std::string, int> placeholder_ids_;
+    std::vector<std::string> placeholder_names_;
+};
+
+// Splits text into chat messages like the bot's _send_split: one per line, trailing
+// whitespace removed, empty lines skipped, at most max_chars code points each.
+// Pieces point into text. out is cleared first.
+void split_chat_lines(std::string_view text, size_t max_chars, std::vector<std::string_view>& out);
+
+#endif // _FETCHER_MESSAGE_TEMPLATES_HPP
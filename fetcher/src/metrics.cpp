@@ -0,0 +1,445 @@
+#include "metrics.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace metrics {
+
+namespace {
+
+// Index 0 is "no command" (per-frame series), the last one catches unknown commands
+const char* const COMMANDS[] = {
+    "",
+    // server -> client
+    "RoomInfo", "ConnectionRefused", "Connected", "ReceivedItems", "LocationInfo", "RoomUpdate",
+    "PrintJSON", "DataPackage", "Bounced", "InvalidPacket", "Retrieved", "SetReply",
+    // client -> server
+    "Connect", "ConnectUpdate", "Sync", "LocationChecks", "LocationScouts", "CreateHints", "UpdateHint",
+    "StatusUpdate", "Say", "GetDataPackage", "Bounce", "Get", "Set", "SetNotify",
+    "other",
+};
+constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// Upper bounds of the histogram buckets, in ns (10µs .. 10s), plus +Inf
+const uint64_t BUCKETS_NS[] = {
+    10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+    100000000, 250000000, 500000000, 1000000000, 2500000000ULL, 5000000000ULL, 10000000000ULL,
+};
+constexpr size_t BUCKET_COUNT = sizeof(BUCKETS_NS) / sizeof(BUCKETS_NS[0]) + 1;
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+
+const CounterInfo COUNTER_INFO[COUNTER_COUNT] = {
+    {"frames_received_total", "Websocket frames received from the server"},
+    {"frames_sent_total", "Websocket frames sent to the server"},
+    {"bytes_received_total", "Payload bytes received from the server"},
+    {"bytes_sent_total", "Payload bytes sent to the server"},
+    {"state_flushes_total", "state.json writes"},
+    {"state_flush_bytes_total", "Bytes written to state.json"},
+};
+
+struct HistogramInfo {
+    const char* name;
+    const char* help;
+    bool per_command;
+};
+
+const HistogramInfo HISTOGRAM_INFO[HISTOGRAM_COUNT] = {
+    {"parse_seconds", "Time to parse a received frame", false},
+    {"validate_seconds", "Time to validate a received frame against the packet schema", false},
+    {"handler_seconds", "Time to validate and handle a received command", true},
+    {"state_flush_seconds", "Time to write state.json", false},
+    {"item_handled_seconds", "Time from receiving an item to storing it in the fetcher state", false},
+    {"item_snapshot_seconds", "Time from receiving an item to building a state.json that has it", false},
+    {"item_written_seconds", "Time from receiving an item to writing a state.json that has it", false},
+};
+
+struct GaugeInfo {
+    const char* name;
+    const char* type;
+    const char* help;
+};
+
+const GaugeInfo GAUGE_INFO[GAUGE_COUNT] = {
+    {"connection_state", "gauge", "APClient state: 0 disconnected, 1 socket connecting, 2 socket connected, 3 room info, 4 slot connected"},
+    {"reconnects_total", "counter", "Socket reconnects since start"},
+    {"outgoing_queue", "gauge", "Commands waiting for the next batched frame"},
+    {"state_items", "gauge", "Items received and kept in the state"},
+    {"datapackage_cache_hits_total", "counter", "Data packages loaded from the local cache"},
+    {"datapackage_cache_misses_total", "counter", "Data packages that had to be downloaded"},
+};
+
+// Everything one thread recorded. Only that thread writes to it, so updates are a
+// relaxed load and store; the scraper reads whatever is there.
+struct Shard {
+    std::atomic<bool> in_use{false};
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<uint64_t> commands[2][COMMAND_COUNT];
+    std::atomic<uint64_t> buckets[HISTOGRAM_COUNT][COMMAND_COUNT][BUCKET_COUNT];
+    std::atomic<uint64_t> sum_ns[HISTOGRAM_COUNT][COMMAND_COUNT];
+};
+
+inline void bump(std::atomic<uint64_t>& value, uint64_t n)
+{
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Shards are never freed: a thread that exits hands its shard to the next new thread,
+// so what it recorded stays in the totals.
+struct Registry {
+    std::mutex mutex;
+    std::vector<Shard*> shards;
+};
+
+Registry& registry()
+{
+    static Registry* r = new Registry(); // outlives thread_local leases at exit
+    return *r;
+}
+
+Shard* acquire_shard()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (Shard* shard : r.shards) {
+        if (!shard->in_use.load(std::memory_order_acquire)) {
+            shard->in_use.store(true, std::memory_order_relaxed);
+            return shard;
+        }
+    }
+    Shard* shard = new Shard(); // value-initialized: all zero
+    shard->in_use.store(true, std::memory_order_relaxed);
+    r.shards.push_back(shard);
+    return shard;
+}
+
+struct ShardLease {
+    Shard* shard = nullptr;
+
+    ~ShardLease()
+    {
+        if (shard)
+            shard->in_use.store(false, std::memory_order_release);
+    }
+};
+
+Shard& local_shard()
+{
+    thread_local ShardLease lease;
+    if (!lease.shard)
+        lease.shard = acquire_shard();
+    return *lease.shard;
+}
+
+std::atomic<int64_t> g_gauges[GAUGE_COUNT];
+
+void write_value(std::ostringstream& out, const std::string& name, const std::string& labels, uint64_t value)
+{
+    out << name;
+    if (!labels.empty())
+        out << '{' << labels << '}';
+    out << ' ' << value << '\n';
+}
+
+std::string cmd_label(size_t cmd)
+{
+    return std::string("cmd=\"") + COMMANDS[cmd] + "\"";
+}
+
+} // namespace
+
+namespace detail {
+
+std::atomic<bool> enabled{false};
+
+void add(Counter counter, uint64_t n)
+{
+    bump(local_shard().counters[counter], n);
+}
+
+void add_command(bool sent, size_t cmd)
+{
+    bump(local_shard().commands[sent ? 1 : 0][cmd], 1);
+}
+
+void observe(Histogram histogram, uint64_t ns, size_t cmd)
+{
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && ns > BUCKETS_NS[bucket])
+        bucket++;
+    Shard& shard = local_shard();
+    bump(shard.buckets[histogram][cmd][bucket], 1);
+    bump(shard.sum_ns[histogram][cmd], ns);
+}
+
+void set(Gauge gauge, int64_t value)
+{
+    g_gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+void record_frame(bool sent, const std::string& frame)
+{
+    Shard& shard = local_shard();
+    bump(shard.counters[sent ? FRAMES_SENT : FRAMES_RECEIVED], 1);
+    bump(shard.counters[sent ? BYTES_SENT : BYTES_RECEIVED], frame.size());
+    if (!sent)
+        return;
+    // Sent frames come from json::dump(), so "cmd":" only appears as a key
+    static const char key[] = "\"cmd\":\"";
+    const size_t key_len = sizeof(key) - 1;
+    size_t p = frame.find(key);
+    while (p != std::string::npos) {
+        p += key_len;
+        size_t q = frame.find('"', p);
+        if (q == std::string::npos)
+            break;
+        bump(shard.commands[1][command_index(frame.substr(p, q - p))], 1);
+        p = frame.find(key, q);
+    }
+}
+
+} // namespace detail
+
+size_t command_index(const std::string& cmd)
+{
+    for (size_t i = 1; i < COMMAND_COUNT - 1; i++) {
+        if (cmd == COMMANDS[i])
+            return i;
+    }
+    return COMMAND_COUNT - 1;
+}
+
+size_t memory_bytes()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.shards.size() * sizeof(Shard);
+}
+
+std::string render()
+{
+    const std::string prefix = "ap_fetcher_";
+
+    // Sum the shards. A scrape may see a thread halfway through a record, never a torn value.
+    std::vector<uint64_t> counters(COUNTER_COUNT, 0);
+    std::vector<uint64_t> commands(2 * COMMAND_COUNT, 0);
+    std::vector<uint64_t> buckets(HISTOGRAM_COUNT * COMMAND_COUNT * BUCKET_COUNT, 0);
+    std::vector<uint64_t> sums(HISTOGRAM_COUNT * COMMAND_COUNT, 0);
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const Shard* shard : r.shards) {
+            for (size_t c = 0; c < COUNTER_COUNT; c++)
+                counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            for (size_t d = 0; d < 2; d++)
+                for (size_t i = 0; i < COMMAND_COUNT; i++)
+                    commands[d * COMMAND_COUNT + i] += shard->commands[d][i].load(std::memory_order_relaxed);
+            for (size_t h = 0; h < HISTOGRAM_COUNT; h++) {
+                for (size_t i = 0; i < COMMAND_COUNT; i++) {
+                    for (size_t b = 0; b < BUCKET_COUNT; b++)
+                        buckets[(h * COMMAND_COUNT + i) * BUCKET_COUNT + b] +=
+                            shard->buckets[h][i][b].load(std::memory_order_relaxed);
+                    sums[h * COMMAND_COUNT + i] += shard->sum_ns[h][i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    std::ostringstream out;
+    for (size_t c = 0; c < COUNTER_COUNT; c++) {
+        const std::string name = prefix + COUNTER_INFO[c].name;
+        out << "# HELP " << name << ' ' << COUNTER_INFO[c].help << '\n'
+            << "# TYPE " << name << " counter\n";
+        write_value(out, name, "", counters[c]);
+    }
+
+    const char* const command_names[2] = {"commands_received_total", "commands_sent_total"};
+    const char* const command_help[2] = {"Commands received from the server", "Commands sent to the server"};
+    for (size_t d = 0; d < 2; d++) {
+        const std::string name = prefix + command_names[d];
+        out << "# HELP " << name << ' ' << command_help[d] << '\n'
+            << "# TYPE " << name << " counter\n";
+        for (size_t i = 1; i < COMMAND_COUNT; i++) {
+            if (commands[d * COMMAND_COUNT + i])
+                write_value(out, name, cmd_label(i), commands[d * COMMAND_COUNT + i]);
+        }
+    }
+
+    out.precision(9);
+    for (size_t h = 0; h < HISTOGRAM_COUNT; h++) {
+        const HistogramInfo& info = HISTOGRAM_INFO[h];
+        const std::string name = prefix + info.name;
+        out << "# HELP " << name << ' ' << info.help << '\n'
+            << "# TYPE " << name << " histogram\n";
+        for (size_t i = info.per_command ? 1 : 0; i < (info.per_command ? COMMAND_COUNT : 1); i++) {
+            const uint64_t* b = &buckets[(h * COMMAND_COUNT + i) * BUCKET_COUNT];
+            uint64_t count = 0;
+            for (size_t k = 0; k < BUCKET_COUNT; k++)
+                count += b[k];
+            if (info.per_command && count == 0)
+                continue;
+            const std::string label = info.per_command ? cmd_label(i) + "," : std::string();
+            uint64_t cumulative = 0;
+            for (size_t k = 0; k < BUCKET_COUNT; k++) {
+                cumulative += b[k];
+                out << name << "_bucket{" << label << "le=\"";
+                if (k < BUCKET_COUNT - 1)
+                    out << (double)BUCKETS_NS[k] / 1e9;
+                else
+                    out << "+Inf";
+                out << "\"} " << cumulative << '\n';
+            }
+            out << name << "_sum";
+            if (info.per_command)
+                out << '{' << cmd_label(i) << '}';
+            out << ' ' << (double)sums[h * COMMAND_COUNT + i] / 1e9 << '\n';
+            write_value(out, name + "_count", info.per_command ? cmd_label(i) : std::string(), count);
+        }
+    }
+
+    for (size_t g = 0; g < GAUGE_COUNT; g++) {
+        const std::string name = prefix + GAUGE_INFO[g].name;
+        out << "# HELP " << name << ' ' << GAUGE_INFO[g].help << '\n'
+            << "# TYPE " << name << ' ' << GAUGE_INFO[g].type << '\n'
+            << name << ' ' << g_gauges[g].load(std::memory_order_relaxed) << '\n';
+    }
+    return out.str();
+}
+
+// ------------------------------------------------------------
+// HTTP: juste assez pour un scrape Prometheus (GET, une requête
+// par connexion), sur un thread à part du poll loop.
+// ------------------------------------------------------------
+
+#ifndef _WIN32
+
+namespace {
+
+std::mutex g_server_mutex;
+std::thread g_server_thread;
+std::atomic<bool> g_server_stop{false};
+int g_listen_fd = -1;
+
+void send_all(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        sent += (size_t)n;
+    }
+}
+
+void serve_client(int fd)
+{
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[1024];
+    while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            break;
+        request.append(buf, (size_t)n);
+    }
+
+    std::string status = "404 Not Found";
+    std::string body = "Not found, try /metrics\n";
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+        status = "200 OK";
+        body = render();
+    }
+    send_all(fd, "HTTP/1.1 " + status + "\r\n"
+                 "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                 "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                 "Connection: close\r\n\r\n" + body);
+}
+
+void serve(int listen_fd)
+{
+    while (!g_server_stop.load()) {
+        pollfd pfd = {listen_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 200) <= 0)
+            continue;
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        serve_client(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+bool start_server(const std::string& bind, int port)
+{
+    std::lock_guard<std::mutex> lock(g_server_mutex);
+    if (g_listen_fd >= 0)
+        return true;
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, bind.c_str(), &addr.sin_addr) != 1)
+        return false;
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    g_listen_fd = fd;
+    g_server_stop = false;
+    detail::enabled = true;
+    g_server_thread = std::thread(serve, fd);
+    return true;
+}
+
+void stop_server()
+{
+    std::lock_guard<std::mutex> lock(g_server_mutex);
+    if (g_listen_fd < 0)
+        return;
+    g_server_stop = true;
+    g_server_thread.join();
+    ::close(g_listen_fd);
+    g_listen_fd = -1;
+}
+
+#else
+
+bool start_server(const std::string&, int)
+{
+    return false;
+}
+
+void stop_server()
+{
+}
+
+#endif
+
+} // namespace metrics
@@ -0,0 +1,120 @@
+#ifndef _FETCHER_METRICS_HPP
+#define _FETCHER_METRICS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// Métriques du fetcher, servies au format texte Prometheus
+// sur http://<bind>:<port>/metrics (fetcher.metrics).
+//
+//   Les compteurs et histogrammes sont tenus par thread (un seul
+//   écrivain par shard, atomics relaxed, pas de lock) et additionnés
+//   au moment du scrape. Désactivé, chaque appel coûte un test.
+// ------------------------------------------------------------
+
+namespace metrics {
+
+enum Counter {
+    FRAMES_RECEIVED,
+    FRAMES_SENT,
+    BYTES_RECEIVED,
+    BYTES_SENT,
+    STATE_FLUSHES,
+    STATE_FLUSH_BYTES,
+    COUNTER_COUNT
+};
+
+enum Histogram {
+    PARSE_SECONDS,       // json parsing, per received frame
+    VALIDATE_SECONDS,    // schema validation, per received frame
+    HANDLER_SECONDS,     // handling, per received command (labelled by cmd)
+    STATE_FLUSH_SECONDS, // save_state_to_file()
+    ITEM_HANDLED_SECONDS,  // item frame received -> item in g_state
+    ITEM_SNAPSHOT_SECONDS, // item frame received -> item in a state.json being built
+    ITEM_WRITTEN_SECONDS,  // item frame received -> state.json with the item written
+    HISTOGRAM_COUNT
+};
+
+// Last value wins, set from the poll loop
+enum Gauge {
+    CONNECTION_STATE,         // APClient::State
+    RECONNECTS,
+    OUTGOING_QUEUE,           // commands waiting for the next batch flush
+    STATE_ITEMS,              // g_state.items
+    DATAPACKAGE_CACHE_HITS,
+    DATAPACKAGE_CACHE_MISSES,
+    GAUGE_COUNT
+};
+
+namespace detail {
+
+extern std::atomic<bool> enabled;
+
+void add(Counter counter, uint64_t n);
+void add_command(bool sent, size_t cmd);
+void observe(Histogram histogram, uint64_t ns, size_t cmd);
+void set(Gauge gauge, int64_t value);
+void record_frame(bool sent, const std::string& frame);
+
+} // namespace detail
+
+// Index of an Archipelago command for the per-command series, "other" if unknown
+size_t command_index(const std::string& cmd);
+
+inline bool enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+inline void add(Counter counter, uint64_t n = 1)
+{
+    if (enabled())
+        detail::add(counter, n);
+}
+
+// One command received from or sent to the server
+inline void add_command(bool sent, const std::string& cmd)
+{
+    if (enabled())
+        detail::add_command(sent, command_index(cmd));
+}
+
+inline void observe(Histogram histogram, std::chrono::nanoseconds duration, const std::string& cmd = std::string())
+{
+    if (enabled())
+        detail::observe(histogram, (uint64_t)std::max<int64_t>(duration.count(), 0),
+                        cmd.empty() ? 0 : command_index(cmd));
+}
+
+inline void set(Gauge gauge, int64_t value)
+{
+    if (enabled())
+        detail::set(gauge, value);
+}
+
+// Frame and byte counts of one websocket frame. Commands of sent frames are counted
+// from the frame text; received commands are counted by the caller once parsed.
+inline void record_frame(bool sent, const std::string& frame)
+{
+    if (enabled())
+        detail::record_frame(sent, frame);
+}
+
+// Prometheus text exposition of everything recorded so far
+std::string render();
+
+// Bytes held by the per-thread shards
+size_t memory_bytes();
+
+// Enables recording and serves GET /metrics on a background thread.
+// Returns false if the port could not be bound (or on platforms without it).
+bool start_server(const std::string& bind, int port);
+void stop_server();
+
+} // namespace metrics
+
+#endif // _FETCHER_METRICS_HPP
@@ -0,0 +1,197 @@
+#include "name_search.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// U+00C0..U+00FF (0xC3 0x80..0xBF en UTF-8) sans accent, ' ' pour × et ÷
+const char LATIN1_FOLD[65] = "aaaaaaaceeeeiiiidnooooo ouuuuytsaaaaaaaceeeeiiiidnooooo ouuuuyty";
+
+uint32_t trigram(const std::string& s, size_t i)
+{
+    return ((uint32_t)(unsigned char)s[i] << 16) | ((uint32_t)(unsigned char)s[i + 1] << 8) |
+           (uint32_t)(unsigned char)s[i + 2];
+}
+
+// Distinct trigrams of " normalized ", sorted
+void trigrams(const std::string& normalized, std::vector<uint32_t>& out)
+{
+    out.clear();
+    const std::string padded = " " + normalized + " ";
+    for (size_t i = 0; i + 3 <= padded.size(); i++)
+        out.push_back(trigram(padded, i));
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+} // namespace
+
+std::string NameSearch::normalize(const std::string& name)
+{
+    std::string out;
+    out.reserve(name.size());
+    bool space = true; // pas d'espace au début ni en double
+    auto push = [&out, &space](char c) {
+        if (c == ' ') {
+            if (!space)
+                out.push_back(' ');
+            space = true;
+        } else {
+            out.push_back(c);
+            space = false;
+        }
+    };
+
+    for (size_t i = 0; i < name.size(); i++) {
+        const unsigned char c = (unsigned char)name[i];
+        if (c >= 'A' && c <= 'Z') {
+            push((char)(c - 'A' + 'a'));
+        } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            push((char)c);
+        } else if (c == '\'' || c == '.') {
+            // "Oak's Parcel" -> "oaks parcel", "S.S. Ticket" -> "ss ticket"
+        } else if (c < 0x80) {
+            push(' ');
+        } else if (c == 0xC3 && i + 1 < name.size() && ((unsigned char)name[i + 1] & 0xC0) == 0x80) {
+            push(LATIN1_FOLD[(unsigned char)name[++i] & 0x3F]);
+        } else if (c == 0xE2 && i + 2 < name.size() && (unsigned char)name[i + 1] == 0x80 &&
+                   (unsigned char)name[i + 2] == 0x99) {
+            i += 2; // ’ comme '
+        } else {
+            push((char)c); // autres caractères UTF-8 gardés tels quels (♀, ♂, ...)
+        }
+    }
+    if (!out.empty() && out.back() == ' ')
+        out.pop_back();
+    return out;
+}
+
+void NameSearch::build(std::vector<std::pair<int64_t, std::string>> names)
+{
+    names_.clear();
+    names_.reserve(names.size());
+    std::vector<std::pair<uint32_t, uint32_t>> pairs; // (trigram, entry)
+    std::vector<uint32_t> tris;
+    for (auto& n : names) {
+        Entry e;
+        e.id = n.first;
+        e.name = std::move(n.second);
+        e.normalized = normalize(e.name);
+        trigrams(e.normalized, tris);
+        e.trigrams = (uint32_t)tris.size();
+        for (uint32_t t : tris)
+            pairs.emplace_back(t, (uint32_t)names_.size());
+        names_.push_back(std::move(e));
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    keys_.clear();
+    offsets_.clear();
+    postings_.clear();
+    postings_.reserve(pairs.size());
+    for (const auto& p : pairs) {
+        if (keys_.empty() || keys_.back() != p.first) {
+            keys_.push_back(p.first);
+            offsets_.push_back((uint32_t)postings_.size());
+        }
+        postings_.push_back(p.second);
+    }
+    offsets_.push_back((uint32_t)postings_.size());
+}
+
+std::vector<NameSearch::Match> NameSearch::search(const std::string& query, size_t limit) const
+{
+    std::vector<Match> matches;
+    const std::string q = normalize(query);
+    if (q.empty() || limit == 0 || names_.empty())
+        return matches;
+
+    // compteurs par nom réutilisés d'une recherche à l'autre, remis à zéro via touched
+    thread_local std::vector<uint16_t> counts;
+    thread_local std::vector<uint32_t> touched;
+    thread_local std::vector<uint32_t> query_tris;
+    if (counts.size() < names_.size())
+        counts.resize(names_.size());
+    touched.clear();
+
+    trigrams(q, query_tris);
+    thread_local std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    ranges.clear();
+    size_t total = 0;
+    for (uint32_t t : query_tris) {
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), t);
+        if (it == keys_.end() || *it != t)
+            continue;
+        const size_t k = (size_t)(it - keys_.begin());
+        ranges.emplace_back(offsets_[k], offsets_[k + 1]);
+        total += offsets_[k + 1] - offsets_[k];
+    }
+
+    if (total > names_.size() / 2) {
+        // requête faite de trigrammes courants: compter sans branche puis parcourir les compteurs
+        for (const auto& r : ranges) {
+            for (uint32_t i = r.first; i < r.second; i++)
+                counts[postings_[i]]++;
+        }
+        for (uint32_t entry = 0; entry < (uint32_t)names_.size(); entry++) {
+            if (counts[entry])
+                touched.push_back(entry);
+        }
+    } else {
+        for (const auto& r : ranges) {
+            for (uint32_t i = r.first; i < r.second; i++) {
+                const uint32_t entry = postings_[i];
+                if (counts[entry]++ == 0)
+                    touched.push_back(entry);
+            }
+        }
+    }
+
+    // Top-k in a heap whose front is the worst kept match. Only a candidate that
+    // can still beat it pays for the string comparisons of the bonus.
+    auto better = [](const Match& a, const Match& b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        if (a.name->size() != b.name->size())
+            return a.name->size() < b.name->size();
+        return a.id < b.id;
+    };
+    matches.reserve(limit + 1);
+    const size_t qn = query_tris.size();
+    for (uint32_t entry : touched) {
+        const Entry& e = names_[entry];
+        const uint32_t common = counts[entry];
+        counts[entry] = 0;
+        double score = 2.0 * common / (double)(qn + e.trigrams);
+        const bool full = matches.size() == limit;
+        if (common == qn && e.trigrams == qn && e.normalized == q) {
+            score += 1;
+        } else if (full && (1 + score) / 2 < matches.front().score) {
+            continue; // même avec le bonus de préfixe
+        } else if (common + 1 >= qn && e.normalized.compare(0, q.size(), q) == 0) {
+            score += (1 - score) / 2; // "dive" -> "dive ball" avant "dusk ball"
+        }
+        const Match m{e.id, &e.name, score};
+        if (full) {
+            if (!better(m, matches.front()))
+                continue;
+            std::pop_heap(matches.begin(), matches.end(), better);
+            matches.back() = m;
+        } else {
+            matches.push_back(m);
+        }
+        std::push_heap(matches.begin(), matches.end(), better);
+    }
+    std::sort_heap(matches.begin(), matches.end(), better);
+    return matches;
+}
+
+size_t NameSearch::memory_bytes() const
+{
+    size_t n = names_.capacity() * sizeof(Entry) + (keys_.capacity() + offsets_.capacity() + postings_.capacity()) * sizeof(uint32_t);
+    for (const Entry& e : names_) {
+        n += e.name.capacity() > 15 ? e.name.capacity() + 1 : 0;
+        n += e.normalized.capacity() > 15 ? e.normalized.capacity() + 1 : 0;
+    }
+    return n;
+}
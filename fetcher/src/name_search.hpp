@@ -0,0 +1,58 @@
+#ifndef _FETCHER_NAME_SEARCH_HPP
+#define _FETCHER_NAME_SEARCH_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// Recherche approximative de noms (items / locations d'un jeu)
+//
+//   Index de trigrammes construit une fois par DataPackage. Les
+//   noms et la requête sont normalisés comme _normalize_item_slug
+//   du bot (minuscules, accents retirés, ' et . supprimés, autre
+//   ponctuation = espace), puis classés par coefficient de Dice sur
+//   les trigrammes, avec un bonus pour l'égalité et les préfixes.
+// ------------------------------------------------------------
+
+class NameSearch {
+public:
+    struct Match {
+        int64_t id;
+        const std::string* name; // valid until the next build()
+        double score;            // 0..1 similarity, +1 for an exact match
+    };
+
+    void build(std::vector<std::pair<int64_t, std::string>> names);
+
+    // Best matches first, at most limit. Thread-safe between builds.
+    std::vector<Match> search(const std::string& query, size_t limit) const;
+
+    size_t size() const
+    {
+        return names_.size();
+    }
+
+    size_t memory_bytes() const;
+
+    static std::string normalize(const std::string& name);
+
+private:
+    struct Entry {
+        int64_t id;
+        std::string name;
+        std::string normalized;
+        uint32_t trigrams; // distinct trigrams in normalized
+    };
+
+    std::vector<Entry> names_;
+
+    // Postings par trigramme, triés: keys_[i] -> postings_[offsets_[i] .. offsets_[i + 1])
+    std::vector<uint32_t> keys_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> postings_;
+};
+
+#endif // _FETCHER_NAME_SEARCH_HPP
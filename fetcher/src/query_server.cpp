@@ -0,0 +1,418 @@
+#include "query_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "announce.hpp"
+#include "key_items.hpp"
+#include "name_search.hpp"
+#include "state.hpp"
+
+namespace query {
+
+namespace {
+
+constexpr size_t MAX_CACHED_ANSWERS = 256;
+constexpr size_t MAX_REQUEST_SIZE = 4096;
+
+// Answers for the current generation, keyed by request line
+std::mutex g_cache_mutex;
+uint64_t g_cache_generation = 0;
+std::unordered_map<std::string, std::string> g_cache;
+
+// Fuzzy indexes over slot_names_locked(), rebuilt with it.
+// Guarded by g_state_mutex like the state it comes from.
+struct SearchIndex {
+    uint64_t builds = 0;
+    NameSearch item_search;
+    NameSearch location_search;
+};
+SearchIndex g_search;
+
+const SearchIndex& search_index_locked()
+{
+    const GameNames& names = slot_names_locked();
+    if (g_search.builds == names.builds) {
+        return g_search;
+    }
+    g_search.builds = names.builds;
+    g_search.item_search.build(names.items);
+    g_search.location_search.build(names.locations);
+    return g_search;
+}
+
+json name_or_null(const GameNames::Table& names, int64_t id)
+{
+    const std::string* name = GameNames::find(names, id);
+    if (!name) {
+        return nullptr;
+    }
+    return *name;
+}
+
+// Items in index order (ascending), like sorted(items, key=index) in the bot
+std::vector<const FetcherState::ItemEvent*> items_by_index_locked(bool descending)
+{
+    std::vector<const FetcherState::ItemEvent*> sorted;
+    sorted.reserve(g_state.items.size());
+    for (const auto& it : g_state.items) {
+        sorted.push_back(&it);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [descending](const FetcherState::ItemEvent* a, const FetcherState::ItemEvent* b) {
+                         return descending ? a->index > b->index : a->index < b->index;
+                     });
+    return sorted;
+}
+
+struct PairHash {
+    size_t operator()(const std::pair<int64_t, int64_t>& p) const
+    {
+        return std::hash<int64_t>()(p.first) * 31 + std::hash<int64_t>()(p.second);
+    }
+};
+
+json query_progress_locked()
+{
+    json data = json::object();
+    data["checks_done"] = g_state.checked_locations.size();
+    data["total"] = location_count_locked();
+    return data;
+}
+
+json query_lastitem_locked(size_t limit)
+{
+    const GameNames& names = slot_names_locked();
+    json items = json::array();
+    std::unordered_set<std::pair<int64_t, int64_t>, PairHash> seen;
+    for (const auto* it : items_by_index_locked(true)) {
+        if (items.size() >= limit) {
+            break;
+        }
+        if (!seen.emplace(it->item, it->location).second) {
+            continue;
+        }
+        items.push_back({
+            {"index", it->index},
+            {"item", it->item},
+            {"location", it->location},
+            {"player", it->player},
+            {"item_name", name_or_null(names.items, it->item)},
+            {"location_name", name_or_null(names.locations, it->location)},
+        });
+    }
+    return {{"items", items}};
+}
+
+json query_keyitems_locked()
+{
+    const GameNames& names = slot_names_locked();
+    json items = json::array();
+    std::unordered_set<int64_t> seen;
+    for (const auto* it : items_by_index_locked(false)) {
+        if (seen.count(it->item)) {
+            continue;
+        }
+        const std::string* name = GameNames::find(names.items, it->item);
+        if (!name || !key_items::is_key_item(names.game, it->item, *name)) {
+            continue;
+        }
+        seen.insert(it->item);
+        items.push_back({
+            {"item", it->item},
+            {"location", it->location},
+            {"item_name", *name},
+            {"location_name", name_or_null(names.locations, it->location)},
+        });
+    }
+    return {{"items", items}};
+}
+
+json query_seedinfo_locked()
+{
+    json data = json::object();
+    data["seed"] = g_state.seed;
+    data["game"] = g_config.contains("archipelago") ? g_config["archipelago"].value("game", std::string(""))
+                                                    : std::string("");
+    data["server_version"] = g_state.server_version;
+    data["generator_version"] = g_state.generator_version;
+    return data;
+}
+
+json query_slot_data_locked()
+{
+    auto it = g_state.data_storage.find("slot_data");
+    return {{"slot_data", it != g_state.data_storage.end() && it->is_object() ? *it : json::object()}};
+}
+
+json query_search_locked(const json& req)
+{
+    const std::string kind = req.value("kind", std::string("item"));
+    if ((kind != "item" && kind != "location") || !req.contains("text") || !req["text"].is_string()) {
+        return nullptr;
+    }
+    int limit = req.contains("limit") && req["limit"].is_number_integer() ? req["limit"].get<int>() : 5;
+    const SearchIndex& search = search_index_locked();
+    const NameSearch& index = kind == "item" ? search.item_search : search.location_search;
+    json matches = json::array();
+    for (const NameSearch::Match& m : index.search(req["text"].get<std::string>(), (size_t)std::max(1, std::min(limit, 25)))) {
+        matches.push_back({{"id", m.id}, {"name", *m.name}, {"score", m.score}});
+    }
+    return {{"kind", kind}, {"matches", matches}};
+}
+
+json error(const std::string& message)
+{
+    return {{"ok", false}, {"error", message}};
+}
+
+// Without "after", only the current seq: a bot that (re)starts doesn't replay old lines
+json query_announcements(const json& req, uint64_t generation)
+{
+    if (!announce::enabled()) {
+        return error("announcements are disabled (fetcher.announce.enabled)");
+    }
+    const int64_t after = req.contains("after") && req["after"].is_number_integer() ? req["after"].get<int64_t>()
+                                                                                      : announce::last_seq();
+    json data = announce::released_after(after);
+    {
+        // le bot s'en sert pour reprendre avec state.json si le socket tombe
+        std::lock_guard<std::mutex> lock(g_state_mutex);
+        data["item_count"] = g_state.items.size();
+    }
+    return {{"ok", true}, {"generation", generation}, {"data", data}};
+}
+
+} // namespace
+
+std::string answer(const std::string& request)
+{
+    const uint64_t generation = g_state_generation.load();
+    {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        if (generation != g_cache_generation) {
+            g_cache.clear();
+            g_cache_generation = generation;
+        }
+        auto it = g_cache.find(request);
+        if (it != g_cache.end()) {
+            return it->second;
+        }
+    }
+
+    json response;
+    bool cacheable = true;
+    json req = json::parse(request, nullptr, false);
+    if (!req.is_object() || !req.contains("q") || !req["q"].is_string()) {
+        response = error("expected {\"q\": \"<query>\"}");
+    } else if (req["q"] == "announcements") {
+        // lignes prêtes à envoyer, elles sortent au rythme du token bucket: jamais en cache
+        cacheable = false;
+        response = query_announcements(req, generation);
+    } else {
+        const std::string q = req["q"].get<std::string>();
+        json data;
+        try {
+            std::lock_guard<std::mutex> lock(g_state_mutex);
+            if (q == "progress") {
+                data = query_progress_locked();
+            } else if (q == "lastitem") {
+                int limit = req.contains("limit") && req["limit"].is_number_integer() ? req["limit"].get<int>() : 5;
+                data = query_lastitem_locked((size_t)std::max(1, std::min(limit, 50)));
+            } else if (q == "keyitems") {
+                data = query_keyitems_locked();
+            } else if (q == "seedinfo") {
+                data = query_seedinfo_locked();
+            } else if (q == "rules" || q == "flags") {
+                data = query_slot_data_locked();
+            } else if (q == "search") {
+                data = query_search_locked(req);
+            }
+        } catch (const std::exception& e) {
+            data = nullptr;
+            log_to_file(std::string("[WARN] Query '") + q + "' failed: " + e.what());
+        }
+        if (data.is_null() && q == "search") {
+            response = error("expected {\"q\": \"search\", \"kind\": \"item|location\", \"text\": \"...\"}");
+        } else if (data.is_null()) {
+            response = error("unknown query: " + q);
+        } else {
+            response = {{"ok", true}, {"generation", generation}, {"data", data}};
+        }
+    }
+
+    // names come from the network, don't let invalid UTF-8 make dump() throw
+    std::string line = response.dump(-1, ' ', false, json::error_handler_t::replace);
+    if (cacheable && response["ok"].get<bool>()) {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        if (g_cache_generation == generation && g_cache.size() < MAX_CACHED_ANSWERS) {
+            g_cache.emplace(request, line);
+        }
+    }
+    return line;
+}
+
+// ------------------------------------------------------------
+// Socket Unix: connexions persistantes, une réponse par ligne
+// ------------------------------------------------------------
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr size_t MAX_CLIENTS = 32;
+
+std::mutex g_server_mutex;
+std::thread g_server_thread;
+std::atomic<bool> g_server_stop{false};
+int g_listen_fd = -1;
+std::string g_socket_path;
+
+struct Client {
+    int fd;
+    std::string buffer;
+};
+
+bool send_all(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+// Handles what a client sent. Returns false if the connection should be closed.
+bool read_client(Client& client)
+{
+    char buf[1024];
+    ssize_t n = ::recv(client.fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+        return false;
+    client.buffer.append(buf, (size_t)n);
+    size_t eol;
+    while ((eol = client.buffer.find('\n')) != std::string::npos) {
+        std::string line = client.buffer.substr(0, eol);
+        client.buffer.erase(0, eol + 1);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        if (!send_all(client.fd, answer(line) + "\n"))
+            return false;
+    }
+    return client.buffer.size() <= MAX_REQUEST_SIZE;
+}
+
+void serve(int listen_fd)
+{
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    while (!g_server_stop.load()) {
+        fds.clear();
+        for (const auto& client : clients)
+            fds.push_back({client.fd, POLLIN, 0});
+        fds.push_back({listen_fd, POLLIN, 0});
+        if (::poll(fds.data(), fds.size(), 200) <= 0)
+            continue;
+
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (!read_client(clients[i])) {
+                ::close(clients[i].fd);
+                clients.erase(clients.begin() + (long)i);
+            }
+        }
+
+        if (fds.back().revents & POLLIN) {
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0 && clients.size() >= MAX_CLIENTS) {
+                ::close(fd);
+            } else if (fd >= 0) {
+                // a client that stops reading must not block the other ones for long
+                timeval timeout = {1, 0};
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                clients.push_back({fd, std::string()});
+            }
+        }
+    }
+    for (const auto& client : clients)
+        ::close(client.fd);
+}
+
+} // namespace
+
+bool start_server(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(g_server_mutex);
+    if (g_listen_fd >= 0)
+        return true;
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    ::unlink(path.c_str()); // left over by a previous run
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+        ::close(fd);
+        return false;
+    }
+    ::chmod(path.c_str(), 0600); // only the bot's user
+
+    g_listen_fd = fd;
+    g_socket_path = path;
+    g_server_stop = false;
+    g_server_thread = std::thread(serve, fd);
+    return true;
+}
+
+void stop_server()
+{
+    std::lock_guard<std::mutex> lock(g_server_mutex);
+    if (g_listen_fd < 0)
+        return;
+    g_server_stop = true;
+    g_server_thread.join();
+    ::close(g_listen_fd);
+    ::unlink(g_socket_path.c_str());
+    g_listen_fd = -1;
+}
+
+#else
+
+bool start_server(const std::string&)
+{
+    return false;
+}
+
+void stop_server()
+{
+}
+
+#endif
+
+} // namespace query
@@ -0,0 +1,33 @@
+#ifndef _FETCHER_QUERY_SERVER_HPP
+#define _FETCHER_QUERY_SERVER_HPP
+
+#include <string>
+
+// ------------------------------------------------------------
+// Serveur de requêtes local (fetcher.query)
+//
+//   Socket Unix, une requête JSON par ligne, une réponse par ligne:
+//     -> {"q":"progress"}
+//     <- {"ok":true,"generation":42,"data":{"checks_done":10,...}}
+//   Requêtes: progress, lastitem (limit), keyitems, seedinfo,
+//   rules, flags, announcements (after), search (kind, text, limit).
+//   Voir docs/INSTALL.md.
+//
+//   Les réponses sont calculées depuis g_state (sous le lock) puis
+//   gardées tant que g_state_generation ne bouge pas: une requête
+//   répétée coûte une recherche dans une table de hachage.
+// ------------------------------------------------------------
+
+namespace query {
+
+// Answer one request line (without the newline). Thread-safe.
+std::string answer(const std::string& request);
+
+// Serves requests on a Unix socket at path, on a background thread.
+// Returns false if the socket could not be created (or on platforms without them).
+bool start_server(const std::string& path);
+void stop_server();
+
+} // namespace query
+
+#endif // _FETCHER_QUERY_SERVER_HPP
@@ -0,0 +1,186 @@
+#ifndef _FETCHER_REPLAY_HPP
+#define _FETCHER_REPLAY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include <nlohmann/json.hpp>
+
+// apclientpp
+#include "apclient.hpp"
+
+#include "capture.hpp"
+
+// ------------------------------------------------------------
+// Rejoue une capture (.apcap) dans un APClient sans socket:
+// les frames reçues passent par APClient::inject_message, les
+// frames que le client envoie sont comptées puis jetées.
+// Chaque run part d'un APClient neuf, sans cache de DataPackage,
+// pour que deux runs de la même capture fassent le même travail.
+// ------------------------------------------------------------
+
+struct ReplayStats {
+    uint64_t frames_received = 0;   // frames fed to the client
+    uint64_t bytes_received = 0;
+    uint64_t frames_recorded_sent = 0; // frames the recorded client sent
+    uint64_t frames_sent = 0;       // frames the client sent while replaying
+
+    double wall_ms = 0;             // whole run, including waits at recorded speed
+    double handle_ms = 0;           // inside inject_message() and poll()
+    double frame_p50_ms = 0;
+    double frame_p99_ms = 0;
+    double frame_max_ms = 0;
+    std::string slowest_cmd;        // first command of the slowest frame
+
+    // what the handlers saw, to check that a replay did the expected work
+    uint64_t items_received = 0;
+    uint64_t locations_checked = 0;
+    uint64_t print_json = 0;
+    bool slot_connected = false;
+
+    nlohmann::json to_json() const
+    {
+        return {
+            {"frames_received", frames_received},
+            {"bytes_received", bytes_received},
+            {"frames_recorded_sent", frames_recorded_sent},
+            {"frames_sent", frames_sent},
+            {"wall_ms", wall_ms},
+            {"handle_ms", handle_ms},
+            {"frame_p50_ms", frame_p50_ms},
+            {"frame_p99_ms", frame_p99_ms},
+            {"frame_max_ms", frame_max_ms},
+            {"slowest_cmd", slowest_cmd},
+            {"items_received", items_received},
+            {"locations_checked", locations_checked},
+            {"print_json", print_json},
+            {"slot_connected", slot_connected},
+        };
+    }
+};
+
+class ReplayDriver {
+public:
+    explicit ReplayDriver(const std::vector<CaptureFrame>& frames)
+        : _frames(frames), _game(find_game(frames))
+    {
+    }
+
+    // speed: 1 = recorded speed, 2 = twice as fast, ..., 0 = as fast as possible
+    ReplayStats run(double speed = 0) const
+    {
+        using clock = std::chrono::steady_clock;
+        ReplayStats stats;
+        NullDataPackageStore store;
+        APClient client("replay", _game, "", "", &store); // no uri: never opens a socket
+
+        client.set_frame_handler([&stats](bool outgoing, const std::string&) {
+            if (outgoing)
+                stats.frames_sent++;
+        });
+        client.set_slot_connected_handler([&stats](const nlohmann::json&) {
+            stats.slot_connected = true;
+        });
+        client.set_items_received_handler([&stats](const std::list<APClient::NetworkItem>& items) {
+            stats.items_received += items.size();
+        });
+        client.set_location_checked_handler([&stats](const std::list<int64_t>& locations) {
+            stats.locations_checked += locations.size();
+        });
+        client.set_print_json_handler([&stats](const APClient::PrintJSONArgs&) {
+            stats.print_json++;
+        });
+
+        std::vector<double> frame_ms;
+        frame_ms.reserve(_frames.size());
+        auto start = clock::now();
+        for (const auto& frame : _frames) {
+            if (frame.direction == CaptureFrame::SENT) {
+                stats.frames_recorded_sent++;
+                continue;
+            }
+            if (speed > 0) {
+                auto due = std::chrono::microseconds((uint64_t)((double)frame.time_us / speed));
+                std::this_thread::sleep_until(start + due);
+            }
+            std::string data = frame.data; // the client takes ownership, like a frame from wswrap
+            auto t0 = clock::now();
+            client.inject_message(std::move(data));
+            client.poll();
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+            frame_ms.push_back(ms);
+            stats.frames_received++;
+            stats.bytes_received += frame.data.size();
+            stats.handle_ms += ms;
+            if (ms > stats.frame_max_ms) {
+                stats.frame_max_ms = ms;
+                stats.slowest_cmd = first_cmd(frame.data);
+            }
+        }
+        stats.wall_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        if (!frame_ms.empty()) {
+            std::sort(frame_ms.begin(), frame_ms.end());
+            stats.frame_p50_ms = frame_ms[(frame_ms.size() - 1) / 2];
+            stats.frame_p99_ms = frame_ms[(frame_ms.size() - 1) * 99 / 100];
+        }
+        return stats;
+    }
+
+    const std::string& game() const
+    {
+        return _game;
+    }
+
+    // Game of the recorded slot, from the client's Connect command
+    static std::string find_game(const std::vector<CaptureFrame>& frames)
+    {
+        for (const auto& frame : frames) {
+            if (frame.direction != CaptureFrame::SENT || frame.data.find("\"Connect\"") == std::string::npos)
+                continue;
+            auto packet = nlohmann::json::parse(frame.data, nullptr, false);
+            if (!packet.is_array())
+                continue;
+            for (const auto& command : packet) {
+                if (command.is_object() && command.value("cmd", "") == "Connect")
+                    return command.value("game", "");
+            }
+        }
+        return "";
+    }
+
+private:
+    class NullDataPackageStore final : public APDataPackageStore {
+    public:
+        bool load(const std::string&, const std::string&, nlohmann::json&) override
+        {
+            return false;
+        }
+
+        bool save(const std::string&, const nlohmann::json&) override
+        {
+            return true;
+        }
+    };
+
+    static std::string first_cmd(const std::string& frame)
+    {
+        static const std::string key = "\"cmd\":\"";
+        auto p = frame.find(key);
+        if (p == std::string::npos)
+            return "";
+        p += key.size();
+        auto q = frame.find('"', p);
+        return q == std::string::npos ? "" : frame.substr(p, q - p);
+    }
+
+    const std::vector<CaptureFrame>& _frames;
+    std::string _game;
+};
+
+#endif // _FETCHER_REPLAY_HPP
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
+
+#include "capture.hpp"
+#include "replay.hpp"
+
+// ------------------------------------------------------------
+// ap_replay : rejoue une capture du fetcher (fetcher.capture_file)
+// dans APClient, sans réseau.
+// ------------------------------------------------------------
+
+static void usage(const char* argv0)
+{
+    std::cerr << "Usage: " << argv0 << " <capture.apcap> [--speed <factor>] [--repeat <n>] [--json <file>]\n"
+              << "  --speed <factor>  replay at recorded speed times factor (default 0: as fast as possible)\n"
+              << "  --repeat <n>      replay n times and report each run (default 1)\n"
+              << "  --json <file>     also write the stats of all runs to file as a JSON array\n";
+}
+
+static void print_stats(const ReplayStats& s, int run)
+{
+    std::cout << "run " << run << ": "
+              << s.frames_received << " frames (" << s.bytes_received / 1024 << " KiB) in "
+              << s.handle_ms << " ms handling, " << s.wall_ms << " ms wall\n"
+              << "  per frame: p50 " << s.frame_p50_ms << " ms, p99 " << s.frame_p99_ms
+              << " ms, max " << s.frame_max_ms << " ms (" << s.slowest_cmd << ")\n"
+              << "  sent " << s.frames_sent << " frames, recorded " << s.frames_recorded_sent << "\n"
+              << "  slot connected: " << (s.slot_connected ? "yes" : "no")
+              << ", items " << s.items_received
+              << ", checks " << s.locations_checked
+              << ", PrintJSON " << s.print_json << "\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    double speed = 0;
+    int repeat = 1;
+    std::string json_path;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = std::atof(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (argv[i][0] != '-' && path.empty()) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (path.empty() || repeat < 1 || speed < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<CaptureFrame> frames;
+    bool truncated = false;
+    if (!load_capture(path, frames, &truncated)) {
+        std::cerr << "[REPLAY] Unable to read capture: " << path << std::endl;
+        return 1;
+    }
+    if (truncated) {
+        std::cerr << "[REPLAY] Capture is truncated, replaying the " << frames.size() << " complete frames" << std::endl;
+    }
+
+    ReplayDriver driver(frames);
+    std::cout << "[REPLAY] " << frames.size() << " frames, game '" << driver.game() << "'\n";
+    nlohmann::json runs = nlohmann::json::array();
+    for (int run = 1; run <= repeat; run++) {
+        ReplayStats stats = driver.run(speed);
+        print_stats(stats, run);
+        runs.push_back(stats.to_json());
+    }
+
+    if (!json_path.empty()) {
+        std::ofstream out(json_path, std::ios::trunc);
+        if (!out) {
+            std::cerr << "[REPLAY] Unable to write " << json_path << std::endl;
+            return 1;
+        }
+        out << runs.dump(2) << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+#include "state.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <exception>
+
+json g_config;
+std::mutex g_state_mutex;
+FetcherState g_state;
+std::atomic<uint64_t> g_state_generation{0};
+
+void record_item_latency(ItemLatency::Stage stage, std::chrono::steady_clock::time_point received_at,
+                         std::chrono::steady_clock::time_point now)
+{
+    static const metrics::Histogram histograms[ItemLatency::STAGE_COUNT] = {
+        metrics::ITEM_HANDLED_SECONDS, metrics::ITEM_SNAPSHOT_SECONDS, metrics::ITEM_WRITTEN_SECONDS,
+    };
+    if (received_at == std::chrono::steady_clock::time_point()) {
+        return;
+    }
+    g_state.item_latency.record(stage, received_at, now);
+    metrics::observe(histograms[stage], now - received_at);
+}
+
+// Same choice as the bot: the slot's game, else Pokemon Emerald, else the only game
+const json* game_package_locked(const std::string& game)
+{
+    auto it_dp = g_state.data_storage.find("data_package");
+    if (it_dp == g_state.data_storage.end() || !it_dp->is_object()) {
+        return nullptr;
+    }
+    auto it_games = it_dp->find("games");
+    if (it_games == it_dp->end() || !it_games->is_object()) {
+        return nullptr;
+    }
+    const json& games = *it_games;
+    if (!game.empty() && games.contains(game)) {
+        return &games[game];
+    }
+    if (games.contains("Pokemon Emerald")) {
+        return &games["Pokemon Emerald"];
+    }
+    if (games.size() == 1) {
+        return &games.begin().value();
+    }
+    return nullptr;
+}
+
+const std::string* GameNames::find(const Table& table, int64_t id)
+{
+    auto it = std::lower_bound(table.begin(), table.end(), id,
+                               [](const std::pair<int64_t, std::string>& e, int64_t v) { return e.first < v; });
+    if (it == table.end() || it->first != id) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+// One copy of the names for the query server, the snapshot and --lookup
+const GameNames& slot_names_locked()
+{
+    static GameNames names;
+    const std::string game = slot_game_locked();
+    if (names.builds > 0 && names.data_package_generation == g_state.data_package_generation && names.game == game) {
+        return names;
+    }
+    const uint64_t builds = names.builds + 1;
+    names = GameNames();
+    names.builds = builds;
+    names.data_package_generation = g_state.data_package_generation;
+    names.game = game;
+
+    const json* pkg = game_package_locked(game);
+    if (!pkg || !pkg->is_object()) {
+        return names;
+    }
+    auto invert = [pkg](const char* key, GameNames::Table& out) {
+        auto it = pkg->find(key);
+        if (it == pkg->end() || !it->is_object()) {
+            return;
+        }
+        out.reserve(it->size());
+        for (auto pair = it->begin(); pair != it->end(); ++pair) {
+            if (pair.value().is_number_integer()) {
+                out.emplace_back(pair.value().get<int64_t>(), pair.key());
+            }
+        }
+        std::sort(out.begin(), out.end());
+    };
+    invert("item_name_to_id", names.items);
+    invert("location_name_to_id", names.locations);
+    return names;
+}
+
+std::string slot_game_locked()
+{
+    if (!g_state.game.empty()) {
+        return g_state.game;
+    }
+    if (g_config.contains("archipelago")) {
+        return g_config["archipelago"].value("game", std::string(""));
+    }
+    return "";
+}
+
+bool is_probable_key_item(const std::string& item_name)
+{
+    std::string up = item_name;
+    std::transform(up.begin(), up.end(), up.begin(), [](unsigned char c) { return (char)std::toupper(c); });
+    return up.compare(0, 2, "HM") == 0 || up.find("BADGE") != std::string::npos;
+}
+
+int location_count_locked()
+{
+    // La liste des locations du slot est plus exacte que le DataPackage quand on l'a
+    if (!g_state.checked_locations.universe().empty()) {
+        return static_cast<int>(g_state.checked_locations.universe().size());
+    }
+
+    // Total des locations (si le DataPackage est disponible)
+    int total_locations = 0;
+    try {
+        auto it_dp = g_state.data_storage.find("data_package");
+        if (it_dp != g_state.data_storage.end()) {
+            const json& dp = it_dp.value();
+
+            if (dp.contains("games") && dp["games"].contains(g_state.game)) {
+                const json& game_obj = dp["games"][g_state.game];
+                if (game_obj.contains("locations") && game_obj["locations"].is_object()) {
+                    total_locations = static_cast<int>(game_obj["locations"].size());
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        log_to_file(std::string("[WARN] Failed to compute location_count: ") + e.what());
+    }
+    return total_locations;
+}
+
+void log_to_file(const std::string& msg)
+{
+    try {
+        if (!g_config.contains("paths") || !g_config["paths"].contains("fetcher_log")) {
+            return;
+        }
+        const std::string log_path = g_config["paths"]["fetcher_log"].get<std::string>();
+
+        std::ofstream out(log_path, std::ios::app);
+        if (!out) {
+            return;
+        }
+
+        std::time_t now = std::time(nullptr);
+        char buf[64];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+
+        out << "[" << buf << "] " << msg << '\n';
+    }
+    catch (...) {
+        // Logging must never throw
+    }
+}
+
+void save_state_to_file()
+{
+    try {
+        if (!g_config.contains("paths") || !g_config["paths"].contains("state_file")) {
+            return;
+        }
+        const std::string state_path = g_config["paths"]["state_file"].get<std::string>();
+        const auto start = std::chrono::steady_clock::now();
+
+        json out = json::object();
+        trace::Span build_span("state.build", "state");
+        // items pas encore écrits sur disque, pour la latence "written"
+        std::vector<std::chrono::steady_clock::time_point> unwritten;
+        size_t written_upto = 0;
+        {
+            std::lock_guard<std::mutex> lock(g_state_mutex);
+
+            const auto snapshot_time = std::chrono::steady_clock::now();
+            for (size_t i = g_state.items_published; i < g_state.items.size(); i++) {
+                record_item_latency(ItemLatency::SNAPSHOT, g_state.items[i].received_at, snapshot_time);
+            }
+            g_state.items_published = g_state.items.size();
+            for (size_t i = g_state.items_written; i < g_state.items.size(); i++) {
+                unwritten.push_back(g_state.items[i].received_at);
+            }
+            written_upto = g_state.items.size();
+
+            // Room/meta
+            json room = json::object();
+            room["room_name"]          = g_state.room_name;
+            room["seed"]               = g_state.seed;
+            room["server_version"]     = g_state.server_version;
+            room["generator_version"]  = g_state.generator_version;
+            room["hint_points"]        = g_state.hint_points;
+            room["hint_cost_percent"]  = g_state.hint_cost_percent;
+            room["hint_cost_points"]   = g_state.hint_cost_points;
+
+            room["location_count"] = location_count_locked();
+
+            out["room"] = room;
+
+            // Slot / me
+            json me = json::object();
+            me["slot_name"]     = g_state.slot_name;
+            me["game"]          = g_state.game;
+            me["slot_id"]       = g_state.slot_id;
+            me["team_id"]       = g_state.team_id;
+            me["player_number"] = g_state.player_number;
+            me["team_number"]   = g_state.team_number;
+            out["me"] = me;
+
+            // Checked locations, as runs of consecutive ids: [[first_id, count], ...]
+            json runs = json::array();
+            for (const auto& run : g_state.checked_locations.runs()) {
+                runs.push_back({run.first, run.second});
+            }
+            out["checked_location_runs"] = runs;
+            out["checked_location_count"] = g_state.checked_locations.size();
+
+            // Liste complète, pour les anciens lecteurs du state
+            if (!g_config.contains("fetcher") || g_config["fetcher"].value("legacy_checked_locations", true)) {
+                json checks = json::array();
+                g_state.checked_locations.for_each([&checks](int64_t loc) {
+                    checks.push_back(loc);
+                });
+                out["checked_locations"] = checks;
+            }
+
+            // Items
+            json items = json::array();
+            for (const auto& it : g_state.items) {
+                json ji;
+                ji["index"]    = it.index;
+                ji["item"]     = it.item;
+                ji["location"] = it.location;
+                ji["player"]   = it.player;
+                ji["flags"]    = it.flags;
+                ji["time"]     = it.timestamp;
+                if (it.server_time > 0) {
+                    ji["server_time"] = it.server_time;
+                }
+                items.push_back(ji);
+            }
+            out["items"] = items;
+            
+            // Data storage / datapackage snapshot
+            out["data_storage"] = g_state.data_storage;
+
+            out["fetcher"] = g_state.fetcher;
+            out["fetcher"]["item_latency"] = g_state.item_latency.to_json();
+        }
+
+        // Copy some config bits that are useful for the bot
+        if (g_config.contains("archipelago")) {
+            out["archipelago"] = g_config["archipelago"];
+        }
+        build_span.end();
+
+        trace::Span serialize_span("state.serialize", "state");
+        const std::string text = out.dump(2);
+        serialize_span.end();
+
+        trace::Span write_span("state.write", "state");
+        std::ofstream state_file(state_path, std::ios::trunc);
+        if (!state_file) {
+            log_to_file("[ERROR] Unable to open state file for writing: " + state_path);
+            return;
+        }
+        state_file << text;
+        state_file.close();
+        write_span.end();
+
+        if (!unwritten.empty()) {
+            const auto written_time = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(g_state_mutex);
+            for (const auto& received_at : unwritten) {
+                record_item_latency(ItemLatency::WRITTEN, received_at, written_time);
+            }
+            g_state.items_written = std::max(g_state.items_written, written_upto);
+        }
+
+        metrics::add(metrics::STATE_FLUSHES);
+        metrics::add(metrics::STATE_FLUSH_BYTES, text.size());
+        metrics::observe(metrics::STATE_FLUSH_SECONDS, std::chrono::steady_clock::now() - start);
+    }
+    catch (const std::exception& e) {
+        log_to_file(std::string("[ERROR] save_state_to_file: ") + e.what());
+    }
+    catch (...) {
+        log_to_file("[ERROR] save_state_to_file: unknown exception");
+    }
+}
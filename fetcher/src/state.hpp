@@ -0,0 +1,127 @@
+#ifndef _FETCHER_STATE_HPP
+#define _FETCHER_STATE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <ctime>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+#include <nlohmann/json.hpp>
+
+// apclientpp
+#include "locationset.hpp"
+
+#include "item_latency.hpp"
+
+using json = nlohmann::json;
+
+// ------------------------------------------------------------
+// Global config & state
+//   État partagé entre les handlers APClient et l'écriture de state.json.
+//   Séparé de main.cpp pour que ap_bench puisse le lier sans réseau.
+// ------------------------------------------------------------
+
+extern json g_config;
+extern std::mutex g_state_mutex;
+
+struct FetcherState {
+    // Room / seed info
+    std::string room_name;
+    std::string seed;
+    std::string server_version;
+    std::string generator_version;
+    int hint_points = 0;
+    int hint_cost_percent = 0;
+    int hint_cost_points = 0;
+
+    // Slot / player info
+    std::string slot_name;
+    std::string game;
+    int slot_id = -1;
+    int team_id = -1;
+    int player_number = -1;
+    int team_number = -1;
+
+    // Locations checked (bitset over all locations of the slot once connected)
+    LocationSet checked_locations;
+
+    // Items reçus
+    struct ItemEvent {
+        int64_t index = -1;
+        int64_t item = 0;
+        int64_t location = 0;
+        int player = 0;
+        unsigned flags = 0;
+        std::time_t timestamp = 0;
+        double server_time = 0; // estimated server time when received, s since epoch
+        std::chrono::steady_clock::time_point received_at; // frame carrying the item received
+    };
+    std::vector<ItemEvent> items;
+
+    // Latence de bout en bout des items (handled / snapshot / written)
+    ItemLatency item_latency;
+    size_t items_published = 0; // items already included in a state.json snapshot
+    size_t items_written = 0;   // items already in a state.json written to disk
+
+    // Misc data storage / datapackage
+    json data_storage = json::object();
+    uint64_t data_package_generation = 0; // bumped when data_storage["data_package"] changes
+
+    // Fetcher internals (data package cache stats, ...)
+    json fetcher = json::object();
+};
+
+extern FetcherState g_state;
+
+// Bumped after each change to g_state that the bot can see (room, slot, checks, items,
+// data storage), so answers computed from it can be cached. Not bumped for g_state.fetcher.
+extern std::atomic<uint64_t> g_state_generation;
+
+// Game of the slot: g_state.game, else archipelago.game from the config. Caller holds g_state_mutex.
+std::string slot_game_locked();
+
+// Package of game in data_storage["data_package"], with the bot's fallbacks (Pokemon Emerald,
+// then the only game), or nullptr. Caller holds g_state_mutex.
+const json* game_package_locked(const std::string& game);
+
+// id -> name of the slot's game, sorted by id, from game_package_locked()
+struct GameNames {
+    typedef std::vector<std::pair<int64_t, std::string>> Table;
+
+    uint64_t data_package_generation = 0;
+    std::string game;
+    uint64_t builds = 0; // bumped on each rebuild, for caches derived from the tables
+    Table items;
+    Table locations;
+
+    // nullptr when unknown
+    static const std::string* find(const Table& table, int64_t id);
+};
+
+// Rebuilt when the data package or the slot's game changes. Caller holds g_state_mutex,
+// the reference is valid until it is released.
+const GameNames& slot_names_locked();
+
+// HMs and badges, same heuristic as the bot's _is_probable_key_item_by_name.
+// For games without a key item catalog, see key_items.hpp.
+bool is_probable_key_item(const std::string& item_name);
+
+// Locations of the slot, or of its game in the data package. Caller holds g_state_mutex.
+int location_count_locked();
+
+// Record that an item reached a stage, in g_state.item_latency and the metrics.
+// Caller holds g_state_mutex.
+void record_item_latency(ItemLatency::Stage stage, std::chrono::steady_clock::time_point received_at,
+                         std::chrono::steady_clock::time_point now);
+
+// Append a line to paths.fetcher_log. Never throws.
+void log_to_file(const std::string& msg);
+
+// Write g_state to paths.state_file (see docs/state_schema.md). Never throws.
+void save_state_to_file();
+
+#endif // _FETCHER_STATE_HPP
@@ -0,0 +1,125 @@
+#include "state_snapshot.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "apstate_format.h"
+#include "state.hpp"
+#include "trace.hpp"
+
+namespace {
+
+struct StringPool {
+    std::string data;
+
+    apstate_file_string add(const std::string& s)
+    {
+        apstate_file_string ref;
+        ref.offset = static_cast<uint32_t>(data.size());
+        ref.length = static_cast<uint32_t>(s.size());
+        data.append(s);
+        data.push_back('\0');
+        return ref;
+    }
+};
+
+template <typename T>
+uint64_t append_section(std::string& out, const T* elems, size_t count)
+{
+    out.resize((out.size() + 7) & ~size_t(7)); // sections alignées sur 8
+    const uint64_t offset = out.size();
+    out.append(reinterpret_cast<const char*>(elems), count * sizeof(T));
+    return offset;
+}
+
+} // namespace
+
+bool write_state_snapshot(const std::string& path)
+{
+    trace::Span span("state.snapshot", "state");
+    apstate_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, APSTATE_FORMAT_MAGIC, sizeof(APSTATE_FORMAT_MAGIC));
+    h.version = APSTATE_FORMAT_VERSION;
+    h.header_size = sizeof(apstate_file_header);
+    h.written_at_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::vector<apstate_item> items;
+    std::vector<apstate_file_name> item_names;
+    std::vector<apstate_file_name> location_names;
+    StringPool pool;
+    {
+        std::lock_guard<std::mutex> lock(g_state_mutex);
+        h.generation = g_state_generation.load();
+        h.checks_done = static_cast<int64_t>(g_state.checked_locations.size());
+        h.location_count = location_count_locked();
+        h.slot_id = g_state.slot_id;
+        h.team_id = g_state.team_id;
+        h.seed = pool.add(g_state.seed);
+        h.room_name = pool.add(g_state.room_name);
+        h.server_version = pool.add(g_state.server_version);
+        h.slot_name = pool.add(g_state.slot_name);
+        h.game = pool.add(g_state.game);
+
+        items.reserve(g_state.items.size());
+        for (const auto& it : g_state.items) {
+            apstate_item out;
+            std::memset(&out, 0, sizeof(out));
+            out.index = it.index;
+            out.item = it.item;
+            out.location = it.location;
+            out.player = it.player;
+            out.flags = it.flags;
+            out.server_time = it.server_time;
+            items.push_back(out);
+        }
+
+        const GameNames& names = slot_names_locked();
+        auto add_names = [&pool](const GameNames::Table& table, std::vector<apstate_file_name>& out) {
+            out.reserve(table.size());
+            for (const auto& entry : table) {
+                apstate_file_name n;
+                n.id = entry.first;
+                n.name = pool.add(entry.second);
+                out.push_back(n);
+            }
+        };
+        add_names(names.items, item_names);
+        add_names(names.locations, location_names);
+    }
+    // apstate_items_since() cherche par index
+    std::stable_sort(items.begin(), items.end(),
+                     [](const apstate_item& a, const apstate_item& b) { return a.index < b.index; });
+
+    std::string out(sizeof(h), '\0');
+    h.item_count = items.size();
+    h.items_offset = append_section(out, items.data(), items.size());
+    h.item_name_count = item_names.size();
+    h.item_names_offset = append_section(out, item_names.data(), item_names.size());
+    h.location_name_count = location_names.size();
+    h.location_names_offset = append_section(out, location_names.data(), location_names.size());
+    h.strings_size = pool.data.size();
+    h.strings_offset = append_section(out, pool.data.data(), pool.data.size());
+    std::memcpy(&out[0], &h, sizeof(h));
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!f) {
+            return false;
+        }
+        f.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!f) {
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str()); // rename() ne remplace pas un fichier existant
+#endif
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,17 @@
+#ifndef _FETCHER_STATE_SNAPSHOT_HPP
+#define _FETCHER_STATE_SNAPSHOT_HPP
+
+#include <string>
+
+// ------------------------------------------------------------
+// Snapshot binaire de g_state pour libapstate (fetcher.state_snapshot)
+//
+//   Format décrit dans libapstate/include/apstate_format.h. Écrit
+//   dans path + ".tmp" puis renommé, pour que les lecteurs qui ont
+//   mappé l'ancien fichier ne voient jamais un fichier à moitié écrit.
+// ------------------------------------------------------------
+
+// Locks g_state_mutex while copying the state. Returns false if the file could not be written.
+bool write_state_snapshot(const std::string& path);
+
+#endif // _FETCHER_STATE_SNAPSHOT_HPP
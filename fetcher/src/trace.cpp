@@ -0,0 +1,186 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace trace {
+
+namespace {
+
+struct Event {
+    TimePoint start;
+    TimePoint end;
+    const char* category;
+    char name[48];
+};
+
+// One per thread. The mutex is only ever contended while a dump copies the ring.
+struct Ring {
+    std::mutex mutex;
+    std::vector<Event> events;
+    size_t next = 0;
+    bool wrapped = false;
+    bool in_use = false; // guarded by the registry mutex
+    unsigned tid = 0;
+    std::string thread_name;
+};
+
+// Rings are never freed: a thread that exits hands its ring to the next new thread,
+// so its spans can still be dumped and memory stays bounded.
+struct Registry {
+    std::mutex mutex;
+    std::vector<Ring*> rings;
+    size_t capacity = 0;
+    TimePoint origin = std::chrono::steady_clock::now();
+};
+
+Registry& registry()
+{
+    static Registry* r = new Registry(); // outlives thread_local leases at exit
+    return *r;
+}
+
+Ring* acquire_ring()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (Ring* ring : r.rings) {
+        if (!ring->in_use) {
+            ring->in_use = true;
+            return ring;
+        }
+    }
+    Ring* ring = new Ring();
+    ring->events.resize(std::max<size_t>(r.capacity, 1));
+    ring->tid = (unsigned)r.rings.size() + 1;
+    ring->thread_name = "thread " + std::to_string(ring->tid);
+    ring->in_use = true;
+    r.rings.push_back(ring);
+    return ring;
+}
+
+struct RingLease {
+    Ring* ring = nullptr;
+
+    ~RingLease()
+    {
+        if (ring) {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            ring->in_use = false;
+        }
+    }
+};
+
+Ring& local_ring()
+{
+    thread_local RingLease lease;
+    if (!lease.ring)
+        lease.ring = acquire_ring();
+    return *lease.ring;
+}
+
+double to_us(TimePoint t, TimePoint origin)
+{
+    return std::chrono::duration<double, std::micro>(t - origin).count();
+}
+
+} // namespace
+
+namespace detail {
+
+std::atomic<bool> enabled{false};
+
+void record(const char* name, size_t name_len, const char* category, TimePoint start, TimePoint end)
+{
+    Ring& ring = local_ring();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    Event& e = ring.events[ring.next];
+    e.start = start;
+    e.end = end;
+    e.category = category;
+    name_len = std::min(name_len, sizeof(e.name) - 1);
+    std::memcpy(e.name, name, name_len);
+    e.name[name_len] = 0;
+    if (++ring.next == ring.events.size()) {
+        ring.next = 0;
+        ring.wrapped = true;
+    }
+}
+
+} // namespace detail
+
+void start(size_t events_per_thread)
+{
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().capacity = events_per_thread;
+    }
+    detail::enabled = true;
+}
+
+void set_thread_name(const std::string& name)
+{
+    if (!enabled())
+        return;
+    Ring& ring = local_ring();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring.thread_name = name;
+}
+
+size_t memory_bytes()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t n = 0;
+    for (const Ring* ring : r.rings)
+        n += sizeof(Ring) + ring->events.capacity() * sizeof(Event);
+    return n;
+}
+
+long dump(const std::string& path)
+{
+    Registry& r = registry();
+    std::vector<Event> events;
+    nlohmann::json out = nlohmann::json::object();
+    nlohmann::json& trace_events = out["traceEvents"] = nlohmann::json::array();
+    long count = 0;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (Ring* ring : r.rings) {
+            {
+                std::lock_guard<std::mutex> ring_lock(ring->mutex);
+                if (ring->wrapped)
+                    events.assign(ring->events.begin() + ring->next, ring->events.end());
+                else
+                    events.clear();
+                events.insert(events.end(), ring->events.begin(), ring->events.begin() + ring->next);
+            }
+            trace_events.push_back({
+                {"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", ring->tid},
+                {"args", {{"name", ring->thread_name}}},
+            });
+            for (const Event& e : events) {
+                trace_events.push_back({
+                    {"name", e.name}, {"cat", e.category}, {"ph", "X"}, {"pid", 1}, {"tid", ring->tid},
+                    {"ts", to_us(e.start, r.origin)}, {"dur", to_us(e.end, e.start)},
+                });
+                count++;
+            }
+        }
+    }
+    out["displayTimeUnit"] = "ms";
+
+    std::ofstream f(path, std::ios::trunc);
+    if (!f)
+        return -1;
+    // names come from the network, don't let invalid UTF-8 make dump() throw
+    f << out.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    return f ? count : -1;
+}
+
+} // namespace trace
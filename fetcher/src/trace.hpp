@@ -0,0 +1,91 @@
+#ifndef _FETCHER_TRACE_HPP
+#define _FETCHER_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// Traces au format Chrome trace_event (fetcher.trace)
+//
+//   Chaque thread écrit ses spans dans son propre ring buffer
+//   (les plus anciens sont écrasés). dump() écrit le contenu des
+//   buffers en JSON, à ouvrir dans Perfetto ou chrome://tracing.
+//   Désactivé, un Span coûte un test sur un booléen.
+// ------------------------------------------------------------
+
+namespace trace {
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+namespace detail {
+
+extern std::atomic<bool> enabled;
+
+void record(const char* name, size_t name_len, const char* category, TimePoint start, TimePoint end);
+
+} // namespace detail
+
+inline bool enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Starts recording, keeping the last events_per_thread spans of each thread
+void start(size_t events_per_thread);
+
+// Name shown for the calling thread in the trace viewer
+void set_thread_name(const std::string& name);
+
+// A span that already happened. category must be a string literal; name is copied (truncated to 47 bytes).
+inline void complete(const std::string& name, const char* category, TimePoint start, TimePoint end)
+{
+    if (enabled())
+        detail::record(name.data(), name.size(), category, start, end);
+}
+
+// Records the scope it lives in. name and category must be string literals.
+class Span {
+public:
+    explicit Span(const char* name, const char* category = "fetcher")
+        : name_(name), category_(category)
+    {
+        if (enabled())
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    ~Span()
+    {
+        end();
+    }
+
+    // Ends the span before the scope does
+    void end()
+    {
+        if (start_ != TimePoint()) {
+            detail::record(name_, std::char_traits<char>::length(name_), category_, start_,
+                           std::chrono::steady_clock::now());
+            start_ = TimePoint();
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* name_;
+    const char* category_;
+    TimePoint start_;
+};
+
+// Writes all buffered spans to path as Chrome trace_event JSON. Returns the number of
+// spans written, or -1 if the file could not be written. Recording goes on meanwhile.
+long dump(const std::string& path);
+
+// Bytes held by the ring buffers
+size_t memory_bytes();
+
+} // namespace trace
+
+#endif // _FETCHER_TRACE_HPP
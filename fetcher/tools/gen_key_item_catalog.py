@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Génère key_item_catalog.inc (ids des key items par jeu) pour fetcher/src/key_items.cpp.
+
+Les ids viennent des définitions des mondes vendorisées dans
+third_party/archipelago_py/worlds, lues sans importer Archipelago :
+
+  - Pokemon Emerald      : data/items.json, classification PROGRESSION,
+                           id = BASE_OFFSET + constante de data/extracted_data.json
+  - Pokemon Red and Blue : item_table de items.py, groupe "Key Items",
+                           id = valeur d'ItemData + 172000000
+
+Usage : gen_key_item_catalog.py <worlds_dir> <output.inc>
+CMake le relance quand un de ces fichiers change.
+"""
+
+import ast
+import json
+import os
+import re
+import sys
+from typing import Dict, List
+
+
+def emerald_key_items(worlds: str) -> Dict[int, str]:
+    base = os.path.join(worlds, "pokemon_emerald")
+    with open(os.path.join(base, "data.py"), encoding="utf-8") as f:
+        match = re.search(r"^BASE_OFFSET\s*=\s*(\d+)", f.read(), re.MULTILINE)
+    if not match:
+        raise ValueError("BASE_OFFSET not found in pokemon_emerald/data.py")
+    offset = int(match.group(1))
+
+    with open(os.path.join(base, "data", "extracted_data.json"), encoding="utf-8") as f:
+        constants = json.load(f)["constants"]
+    with open(os.path.join(base, "data", "items.json"), encoding="utf-8") as f:
+        items = json.load(f)
+
+    return {
+        offset + constants[constant]: attributes["label"]
+        for constant, attributes in items.items()
+        if attributes["classification"] == "PROGRESSION"
+    }
+
+
+def red_blue_key_items(worlds: str) -> Dict[int, str]:
+    path = os.path.join(worlds, "pokemon_rb", "items.py")
+    with open(path, encoding="utf-8") as f:
+        source = f.read()
+    tree = ast.parse(source, path)
+
+    match = re.search(r"item_id \+ (\d+)", source)
+    if not match:
+        raise ValueError("id offset not found in pokemon_rb/items.py")
+    offset = int(match.group(1))
+
+    table = None
+    for node in tree.body:
+        if (isinstance(node, ast.Assign) and len(node.targets) == 1
+                and isinstance(node.targets[0], ast.Name) and node.targets[0].id == "item_table"
+                and isinstance(node.value, ast.Dict)):
+            table = node.value
+    if table is None:
+        raise ValueError("item_table not found in pokemon_rb/items.py")
+
+    # "Name": ItemData(id, ItemClassification.x, ["Group", ...])
+    out: Dict[int, str] = {}
+    for key, value in zip(table.keys, table.values):
+        if not isinstance(key, ast.Constant) or not isinstance(value, ast.Call) or len(value.args) < 3:
+            continue
+        item_id = ast.literal_eval(value.args[0])
+        groups = ast.literal_eval(value.args[2])
+        if item_id is not None and "Key Items" in groups:
+            out[offset + item_id] = key.value
+    return out
+
+
+GAMES = [
+    ("Pokemon Emerald", "POKEMON_EMERALD", emerald_key_items),
+    ("Pokemon Red and Blue", "POKEMON_RED_AND_BLUE", red_blue_key_items),
+]
+
+
+def render(worlds: str) -> str:
+    lines: List[str] = [
+        "// Généré par fetcher/tools/gen_key_item_catalog.py, ne pas modifier.",
+        "// Source : third_party/archipelago_py/worlds",
+        "",
+    ]
+    catalogs: List[str] = []
+    for game, symbol, extract in GAMES:
+        items = extract(worlds)
+        if not items:
+            raise ValueError(f"no key items found for {game}")
+        lines.append(f"constexpr int64_t {symbol}_KEY_ITEMS[] = {{")
+        for item_id in sorted(items):
+            lines.append(f"    {item_id}, // {items[item_id]}")
+        lines.append("};")
+        lines.append("")
+        catalogs.append(f'    {{"{game}", {symbol}_KEY_ITEMS, sizeof({symbol}_KEY_ITEMS) / sizeof(int64_t)}},')
+
+    lines.append("constexpr Catalog CATALOGS[] = {")
+    lines.extend(catalogs)
+    lines.append("};")
+    lines.append("")
+    return "\n".join(lines)
+
+
+def main() -> int:
+    if len(sys.argv) != 3:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    text = render(sys.argv[1])
+    os.makedirs(os.path.dirname(os.path.abspath(sys.argv[2])), exist_ok=True)
+    with open(sys.argv[2], "w", encoding="utf-8") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
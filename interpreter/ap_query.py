@@ -0,0 +1,133 @@
+"""
+APTwitchInterpreter
+Created by Jade (TheLovenityJade) - 2025
+
+FetcherQuery: client for the fetcher's query socket (fetcher.query).
+Asks the fetcher directly instead of re-reading state.json for each command.
+
+FetcherEvents: subscriber of the fetcher's event socket (fetcher.fanout).
+Receives the events as they happen instead of polling.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import json
+import logging
+from pathlib import Path
+from typing import Any, Awaitable, Callable, Dict, Optional
+
+
+class FetcherQuery:
+    """
+    Connexion persistante au socket Unix du fetcher.
+
+    - Une requête JSON par ligne, une réponse par ligne (voir docs/INSTALL.md).
+    - query() retourne le champ "data" de la réponse, ou None si le fetcher
+      ne répond pas: l'appelant retombe alors sur state.json.
+    """
+
+    def __init__(self, socket_path: str | Path, timeout: float = 1.0) -> None:
+        self.log = logging.getLogger("interpreter.query")
+        self.socket_path = Path(socket_path)
+        self.timeout = timeout
+
+        self._reader: Optional[asyncio.StreamReader] = None
+        self._writer: Optional[asyncio.StreamWriter] = None
+        self._lock = asyncio.Lock()
+        self._warned = False
+
+    async def query(self, q: str, **params: Any) -> Optional[Dict[str, Any]]:
+        request = json.dumps({"q": q, **params}, separators=(",", ":")) + "\n"
+        async with self._lock:
+            try:
+                return await asyncio.wait_for(self._roundtrip(request), self.timeout)
+            except (OSError, asyncio.TimeoutError, ValueError) as e:
+                if not self._warned:
+                    self.log.warning("Fetcher query socket unavailable (%s), using state.json", e)
+                    self._warned = True
+                await self.close()
+                return None
+
+    async def _roundtrip(self, request: str) -> Optional[Dict[str, Any]]:
+        if self._writer is None:
+            self._reader, self._writer = await asyncio.open_unix_connection(str(self.socket_path))
+        assert self._reader is not None
+
+        self._writer.write(request.encode("utf-8"))
+        await self._writer.drain()
+        line = await self._reader.readline()
+        if not line:
+            raise ConnectionResetError("fetcher closed the query socket")
+
+        answer = json.loads(line)
+        self._warned = False
+        if not answer.get("ok"):
+            self.log.warning("Fetcher query %s failed: %s", request.strip(), answer.get("error"))
+            return None
+        data = answer.get("data")
+        return data if isinstance(data, dict) else None
+
+    async def close(self) -> None:
+        if self._writer is not None:
+            self._writer.close()
+            try:
+                await self._writer.wait_closed()
+            except OSError:
+                pass
+        self._reader = None
+        self._writer = None
+
+
+class FetcherEvents:
+    """
+    Abonnement au socket d'événements du fetcher.
+
+    - Une ligne JSON par événement: {"event": ..., "seq": n, "data": {...}}.
+    - run() se reconnecte tant qu'il n'est pas annulé; connected dit si les
+      événements arrivent, sinon l'appelant retombe sur ses lectures habituelles.
+    """
+
+    def __init__(
+        self,
+        socket_path: str | Path,
+        handler: Callable[[str, Dict[str, Any]], Awaitable[None]],
+        retry_delay: float = 2.0,
+    ) -> None:
+        self.log = logging.getLogger("interpreter.events")
+        self.socket_path = Path(socket_path)
+        self.handler = handler
+        self.retry_delay = retry_delay
+        self.connected = False
+        self._warned = False
+
+    async def run(self) -> None:
+        while True:
+            try:
+                reader, writer = await asyncio.open_unix_connection(str(self.socket_path))
+            except OSError as e:
+                if not self._warned:
+                    self.log.warning("Fetcher event socket unavailable (%s), polling instead", e)
+                    self._warned = True
+                await asyncio.sleep(self.retry_delay)
+                continue
+
+            self.connected = True
+            self._warned = False
+            try:
+                while True:
+                    line = await reader.readline()
+                    if not line:
+                        break
+                    try:
+                        msg = json.loads(line)
+                    except ValueError:
+                        continue
+                    data = msg.get("data")
+                    await self.handler(str(msg.get("event")), data if isinstance(data, dict) else {})
+            except OSError as e:
+                self.log.warning("Fetcher event socket closed: %s", e)
+            finally:
+                self.connected = False
+                writer.close()
+            await asyncio.sleep(self.retry_delay)
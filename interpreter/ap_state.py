@@ -14,6 +14,30 @@ from pathlib import Path
 from typing import Any, Dict, Optional, List
 
 
+def count_checked_locations(state: Dict[str, Any]) -> int:
+    """
+    Nombre de locations checkées dans un state.json.
+
+    Utilise checked_location_count / checked_location_runs du fetcher,
+    sinon la liste checked_locations (anciens fetchers).
+    """
+    count = state.get("checked_location_count")
+    if isinstance(count, int):
+        return count
+
+    runs = state.get("checked_location_runs")
+    if isinstance(runs, list):
+        total = 0
+        for run in runs:
+            try:
+                total += int(run[1])
+            except Exception:
+                continue
+        return total
+
+    return len(state.get("checked_locations") or [])
+
+
 class APState:
     """
     Petite couche utilitaire autour du state Archipelago.
@@ -56,9 +80,21 @@ class APState:
 
     def get_checked_locations(self) -> list[int]:
         state = self.load_state()
+        runs = state.get("checked_location_runs")
+        if isinstance(runs, list):
+            # [[first_id, count], ...]
+            result: List[int] = []
+            for run in runs:
+                try:
+                    first, count = int(run[0]), int(run[1])
+                except Exception:
+                    continue
+                result.extend(range(first, first + count))
+            return result
+
         locs = state.get("checked_locations") or []
         # On force en int si possible
-        result: List[int] = []
+        result = []
         for v in locs:
             try:
                 result.append(int(v))
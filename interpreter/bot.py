@@ -10,6 +10,9 @@ from typing import Any, Dict, List, Optional
 
 from twitchio.ext import commands
 
+from .ap_query import FetcherEvents, FetcherQuery
+from .ap_state import count_checked_locations
+
 
 MAX_TWITCH_MESSAGE_LENGTH = 450
 
@@ -77,6 +80,31 @@ class InterpreterBot(commands.Bot):
         initial_items = initial_state.get("items") or []
         self._last_item_count: int = len(initial_items)
 
+        # Socket de requêtes du fetcher (fetcher.query), sinon lecture de state.json
+        self._fetcher_query: Optional[FetcherQuery] = None
+        query_cfg = config.get("fetcher", {}).get("query", {})
+        if query_cfg.get("enabled", False):
+            # Le fetcher tourne depuis la racine du projet: même base pour les chemins relatifs
+            query_path = Path(query_cfg.get("socket", "data/fetcher.sock"))
+            if not query_path.is_absolute():
+                query_path = self.base_dir / query_path
+            self._fetcher_query = FetcherQuery(query_path)
+
+        # Annonces regroupées et cadencées par le fetcher (fetcher.announce): le bot ne fait que relayer
+        announce_cfg = config.get("fetcher", {}).get("announce", {})
+        self._fetcher_announces: bool = self._fetcher_query is not None and bool(announce_cfg.get("enabled", False))
+        self._announce_seq: Optional[int] = None
+
+        # Événements poussés par le fetcher (fetcher.fanout): les annonces arrivent sans polling
+        self._fetcher_events: Optional[FetcherEvents] = None
+        self._events_task: Optional[asyncio.Task] = None
+        fanout_cfg = config.get("fetcher", {}).get("fanout", {})
+        if self._fetcher_announces and fanout_cfg.get("enabled", False):
+            events_path = Path(fanout_cfg.get("socket", "data/fetcher-events.sock"))
+            if not events_path.is_absolute():
+                events_path = self.base_dir / events_path
+            self._fetcher_events = FetcherEvents(events_path, self._on_fetcher_event)
+
         # Admin / permissions
         self.admin_users = set(u.lower() for u in bot_cfg.get("admin_users", []))
         # broadcaster will be considered admin implicitly
@@ -98,9 +126,21 @@ class InterpreterBot(commands.Bot):
             self.log.error("Failed to parse state.json: %s", e)
             return {}
 
+    async def _query(self, q: str, **params: Any) -> Optional[Dict[str, Any]]:
+        """Demande au fetcher (fetcher.query). None si désactivé ou injoignable."""
+        if self._fetcher_query is None:
+            return None
+        return await self._fetcher_query.query(q, **params)
+
+    async def _load_slot_data_state(self) -> Dict[str, Any]:
+        """slot_data sous la forme de state.json, pour _summarize_rules / _summarize_flags."""
+        answer = await self._query("rules")
+        if answer is not None:
+            return {"data_storage": {"slot_data": answer.get("slot_data") or {}}}
+        return self._load_state()
+
     def _get_progress(self, state: Dict[str, Any]) -> Dict[str, Any]:
-        checked_locations = state.get("checked_locations") or []
-        checks_done = len(checked_locations)
+        checks_done = count_checked_locations(state)
 
         # Try to obtain total locations from multiple possible places
         total_locations = (
@@ -567,6 +607,8 @@ class InterpreterBot(commands.Bot):
             self._about_task = asyncio.create_task(self._about_loop())
         if self._watch_items_task is None and self._auto_announce_items:
             self._watch_items_task = asyncio.create_task(self._watch_items_loop())
+            if self._fetcher_events is not None:
+                self._events_task = asyncio.create_task(self._fetcher_events.run())
 
         channel = self._get_default_channel()
         if channel:
@@ -617,6 +659,14 @@ class InterpreterBot(commands.Bot):
         # Watch state.json for new items and announce them automatically
         try:
             while True:
+                if self._fetcher_events is not None and self._fetcher_events.connected:
+                    await asyncio.sleep(0.5)
+                    continue
+
+                if self._fetcher_announces and await self._forward_fetcher_announcements():
+                    await asyncio.sleep(0.5)
+                    continue
+
                 await asyncio.sleep(2)
                 state = self._load_state()
                 items = state.get("items") or []
@@ -731,6 +781,48 @@ class InterpreterBot(commands.Bot):
         except asyncio.CancelledError:
             return
 
+    async def _forward_fetcher_announcements(self) -> bool:
+        """
+        Relaie les lignes d'annonce du fetcher (déjà regroupées, découpées et cadencées).
+        Retourne False si le fetcher ne répond pas: la boucle retombe alors sur state.json.
+        """
+        params: Dict[str, Any] = {}
+        if self._announce_seq is not None:
+            params["after"] = self._announce_seq
+        answer = await self._query("announcements", **params)
+        if answer is None:
+            return False
+
+        channel = self._get_default_channel()
+        if channel and self._announce_seq is not None:
+            for line in answer.get("lines") or []:
+                text = line.get("text")
+                if text:
+                    await channel.send(text)
+
+        self._announce_seq = answer.get("seq", self._announce_seq)
+        # pour reprendre au bon endroit si on doit relire state.json
+        self._last_item_count = int(answer.get("item_count") or self._last_item_count)
+        return True
+
+    async def _on_fetcher_event(self, event: str, data: Dict[str, Any]) -> None:
+        """Événements du fetcher: relaie les annonces, rattrape après un resync."""
+        if event == "announce":
+            channel = self._get_default_channel()
+            for line in data.get("lines") or []:
+                seq = int(line.get("seq") or 0)
+                if self._announce_seq is not None and seq <= self._announce_seq:
+                    continue  # déjà relayée par le polling
+                text = line.get("text")
+                if channel and text:
+                    await channel.send(text)
+                self._announce_seq = seq
+            self._last_item_count = int(data.get("item_count") or self._last_item_count)
+        elif event in ("hello", "resync"):
+            # (re)connexion, ou du retard qui a fait sauter des événements:
+            # on rattrape avec les lignes gardées par le fetcher
+            await self._forward_fetcher_announcements()
+
     # ------------------------------------------------------------------ #
     # Commands
     # ------------------------------------------------------------------ #
@@ -741,6 +833,17 @@ class InterpreterBot(commands.Bot):
         Affiche les items 'clés' obtenus (HMs, badges, etc.) en se basant sur les noms AP.
         v1: heuristique par nom (HM*, *Badge).
         """
+        answer = await self._query("keyitems")
+        if answer is not None:
+            # Même heuristique et même ordre, calculés par le fetcher
+            key_items = [
+                (it.get("item_name") or f"Item {it.get('item')}",
+                 it.get("location_name") or f"Loc {it.get('location')}")
+                for it in answer.get("items") or []
+            ]
+            await self._send_key_items(ctx, key_items)
+            return
+
         state = self._load_state() or {}
         items = state.get("items") or []
         if not isinstance(items, list) or not items:
@@ -824,6 +927,9 @@ class InterpreterBot(commands.Bot):
 
             key_items.append((item_name, loc_name))
 
+        await self._send_key_items(ctx, key_items)
+
+    async def _send_key_items(self, ctx: commands.Context, key_items: list[tuple[str, str]]) -> None:
         if not key_items:
             text = self._fmt_msg(
                 "keyitems.empty",
@@ -845,7 +951,7 @@ class InterpreterBot(commands.Bot):
     @commands.command(name="rules")
     async def cmd_rules(self, ctx: commands.Context):
         """Affiche un résumé des règles / settings de la seed Archipelago."""
-        state = self._load_state()
+        state = await self._load_slot_data_state()
         summary = self._summarize_rules(state)
 
         if not summary:
@@ -874,7 +980,12 @@ class InterpreterBot(commands.Bot):
         Usage:
           !iteminfo        -> décrit le dernier item unique reçu
           !iteminfo 3      -> décrit le 3e item unique le plus récent
+          !iteminfo dive   -> décrit l'item du jeu dont le nom ressemble le plus
         """
+        if args and not args[0].isdigit():
+            await self._send_item_info_by_name(ctx, " ".join(args))
+            return
+
         state = self._load_state() or {}
         items = state.get("items") or []
         if not isinstance(items, list) or not items:
@@ -967,12 +1078,44 @@ class InterpreterBot(commands.Bot):
 
         await self._send_split(ctx, text)
 
+    async def _send_item_info_by_name(self, ctx: commands.Context, text: str) -> None:
+        """!iteminfo <nom>: le nom tapé dans le chat est corrigé par la recherche du fetcher."""
+        item_name = text.strip()
+        answer = await self._query("search", kind="item", text=item_name, limit=1)
+        matches = (answer or {}).get("matches") or []
+        if matches and matches[0].get("name"):
+            item_name = matches[0]["name"]
+
+        info = await self._fetch_item_info(item_name)
+        if not info:
+            await ctx.send(f"Infos PokéAPI introuvables pour {item_name}.")
+            return
+
+        default = (
+            "Item: {name}\n"
+            "Effet: {short_effect}\n"
+            "Description: {flavor}"
+        )
+        text = self._fmt_msg(
+            "iteminfo_name",
+            default,
+            name=info.get("name") or item_name,
+            short_effect=info.get("short_effect") or "(aucun effet trouvé)",
+            flavor=info.get("flavor_text") or "(aucune description trouvée)",
+        )
+        await self._send_split(ctx, text)
+
     @commands.command(name="seedinfo")
     async def cmd_seedinfo(self, ctx: commands.Context):
         """Affiche les infos de base de la seed Archipelago."""
-        state = self._load_state()
-        room = state.get("room", {})
-        archi = state.get("archipelago", {})
+        answer = await self._query("seedinfo")
+        if answer is not None:
+            room = answer
+            archi = {"game": answer.get("game")}
+        else:
+            state = self._load_state()
+            room = state.get("room", {})
+            archi = state.get("archipelago", {})
 
         seed = room.get("seed") or archi.get("seed") or "???"
         game = archi.get("game") or "Unknown"
@@ -995,18 +1138,19 @@ class InterpreterBot(commands.Bot):
     @commands.command(name="progress")
     async def cmd_progress(self, ctx: commands.Context):
         """Affiche la progression générale (checks complétés)."""
-        # On charge le state brut
-        state = self._load_state()
-
-        # 1) Checks complétés
-        checked_locations = state.get("checked_locations") or []
-        checks_done = len(checked_locations)
-
+        # 1) Checks complétés, depuis le fetcher si possible, sinon le state brut
         # 2) Total des checks : priorité à state["room"]["location_count"],
         #    sinon override dans config.archipelago.total_locations_override,
         #    sinon bot_settings.total_locations, sinon 0.
-        room = state.get("room") or {}
-        total = room.get("location_count") or 0
+        answer = await self._query("progress")
+        if answer is not None:
+            checks_done = int(answer.get("checks_done") or 0)
+            total = answer.get("total") or 0
+        else:
+            state = self._load_state()
+            checks_done = count_checked_locations(state)
+            room = state.get("room") or {}
+            total = room.get("location_count") or 0
 
         # Lecture override depuis la config déjà chargée dans le bot
         arch_cfg = self.config.get("archipelago", {}) if hasattr(self, "config") else {}
@@ -1062,7 +1206,7 @@ class InterpreterBot(commands.Bot):
     @commands.command(name="flags")
     async def cmd_flags(self, ctx: commands.Context):
         """Affiche une liste condensée des flags / options importantes de la seed."""
-        state = self._load_state()
+        state = await self._load_slot_data_state()
         summary = self._summarize_flags(state)
 
         if not summary:
@@ -1084,6 +1228,18 @@ class InterpreterBot(commands.Bot):
     @commands.command(name="lastitem")
     async def cmd_lastitem(self, ctx: commands.Context):
         """Affiche les 5 derniers items obtenus (avec noms via data_package, sans doublons)."""
+        answer = await self._query("lastitem", limit=5)
+        if answer is not None:
+            latest = answer.get("items") or []
+            if not latest:
+                await ctx.send("Aucun item reçu pour le moment.")
+                return
+            # noms déjà résolus par le fetcher
+            item_id_to_name = {it.get("item"): it.get("item_name") for it in latest if it.get("item_name")}
+            location_id_to_name = {it.get("location"): it.get("location_name") for it in latest if it.get("location_name")}
+            await self._send_last_items(ctx, latest, item_id_to_name, location_id_to_name)
+            return
+
         state = self._load_state() or {}
 
         items = state.get("items") or []
@@ -1147,6 +1303,15 @@ class InterpreterBot(commands.Bot):
             await ctx.send("Aucun item reçu pour le moment.")
             return
 
+        await self._send_last_items(ctx, latest, item_id_to_name, location_id_to_name)
+
+    async def _send_last_items(
+        self,
+        ctx: commands.Context,
+        latest: list[dict],
+        item_id_to_name: Dict[Any, str],
+        location_id_to_name: Dict[Any, str],
+    ) -> None:
         # ------------------------------------------------------------------
         # Construire les lignes "player: item_name @ location_name"
         # ------------------------------------------------------------------
@@ -1266,3 +1431,26 @@ class InterpreterBot(commands.Bot):
         items = state.get("items") or []
         self._last_item_count = len(items)
         await ctx.send("state.json rechargé manuellement.")
+
+    @commands.command(name="aptrace")
+    async def cmd_aptrace(self, ctx: commands.Context):
+        """Admin: demande au fetcher d'écrire ses traces (fetcher.trace)."""
+        if not self._is_admin(ctx):
+            return
+
+        trace_cfg = self.config.get("fetcher", {}).get("trace", {})
+        if not trace_cfg.get("enabled", False):
+            await ctx.send("Les traces du fetcher sont désactivées (fetcher.trace.enabled).")
+            return
+
+        # Le fetcher tourne depuis la racine du projet: même base pour les chemins relatifs
+        trace_path = Path(trace_cfg.get("file", "logs/fetcher_trace.json"))
+        if not trace_path.is_absolute():
+            trace_path = self.base_dir / trace_path
+        try:
+            Path(str(trace_path) + ".request").touch()
+        except OSError as e:
+            self.log.error("Unable to request a fetcher trace: %s", e)
+            await ctx.send("Impossible de demander les traces au fetcher.")
+            return
+        await ctx.send(f"Traces demandées, le fetcher les écrit dans {trace_path.name} d'ici quelques secondes.")
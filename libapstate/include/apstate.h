@@ -0,0 +1,81 @@
+#ifndef APSTATE_H
+#define APSTATE_H
+
+/*
+ * libapstate: read the fetcher's state without parsing state.json.
+ *
+ * The fetcher writes a binary snapshot next to state.json when
+ * fetcher.state_snapshot.enabled is set. apstate_open() maps it, and every
+ * getter below reads the mapping directly. Call apstate_refresh() to pick up
+ * a newer snapshot, for example once per poll.
+ *
+ * Pointers and strings returned by a handle stay valid until the next
+ * apstate_refresh() or apstate_close() on it. A handle is not thread-safe:
+ * use one per thread, or lock around it.
+ *
+ * The ABI is stable: functions are only added, and apstate_abi_version()
+ * goes up when they are.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apstate_format.h"
+
+#if defined(_WIN32)
+#  ifdef APSTATE_BUILDING
+#    define APSTATE_API __declspec(dllexport)
+#  else
+#    define APSTATE_API __declspec(dllimport)
+#  endif
+#else
+#  define APSTATE_API __attribute__((visibility("default")))
+#endif
+
+#define APSTATE_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct apstate apstate;
+
+APSTATE_API int apstate_abi_version(void);
+
+/* NULL if the file is missing or not a valid snapshot */
+APSTATE_API apstate* apstate_open(const char* path);
+APSTATE_API void apstate_close(apstate* state);
+
+/* 1 if a newer snapshot was mapped, 0 if unchanged (or the new file is invalid), -1 if it is gone */
+APSTATE_API int apstate_refresh(apstate* state);
+
+APSTATE_API uint64_t apstate_generation(const apstate* state);
+APSTATE_API int64_t apstate_written_at_ms(const apstate* state);
+
+/* Checked locations and total (0 if unknown). Returns 0, or -1 if state is NULL. */
+APSTATE_API int apstate_progress(const apstate* state, int64_t* checks_done, int64_t* total);
+
+/* All items, sorted by index */
+APSTATE_API const apstate_item* apstate_items(const apstate* state, size_t* count);
+
+/* Items with an index greater than seq (-1 for all), sorted by index */
+APSTATE_API const apstate_item* apstate_items_since(const apstate* state, int64_t seq, size_t* count);
+
+/* Names in the slot's game, NULL if unknown */
+APSTATE_API const char* apstate_item_name(const apstate* state, int64_t item_id);
+APSTATE_API const char* apstate_location_name(const apstate* state, int64_t location_id);
+
+/* Never NULL, "" if unknown */
+APSTATE_API const char* apstate_seed(const apstate* state);
+APSTATE_API const char* apstate_room_name(const apstate* state);
+APSTATE_API const char* apstate_server_version(const apstate* state);
+APSTATE_API const char* apstate_slot_name(const apstate* state);
+APSTATE_API const char* apstate_game(const apstate* state);
+APSTATE_API int32_t apstate_slot_id(const apstate* state);
+APSTATE_API int32_t apstate_team_id(const apstate* state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APSTATE_H */
@@ -0,0 +1,82 @@
+#ifndef APSTATE_FORMAT_H
+#define APSTATE_FORMAT_H
+
+/*
+ * Layout of the fetcher's state snapshot (fetcher.state_snapshot.file).
+ *
+ * The fetcher writes the whole file to "<file>.tmp" then renames it, so a reader
+ * that mapped the previous file keeps a consistent view until it refreshes.
+ * Little-endian, native alignment, every section 8-byte aligned:
+ *
+ *   apstate_file_header
+ *   apstate_item[item_count]                  sorted by index
+ *   apstate_file_name[item_name_count]        sorted by id, the slot's game
+ *   apstate_file_name[location_name_count]    sorted by id, the slot's game
+ *   string pool                               NUL-terminated UTF-8
+ *
+ * Readers should go through libapstate (apstate.h). Bump APSTATE_FORMAT_VERSION
+ * on any change: readers refuse other versions.
+ */
+
+#include <stdint.h>
+
+#define APSTATE_FORMAT_MAGIC "APSTATE"
+#define APSTATE_FORMAT_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A received item, as in state.json's items */
+typedef struct apstate_item {
+    int64_t index;      /* ReceivedItems index, use it as the seq for apstate_items_since */
+    int64_t item;
+    int64_t location;
+    int32_t player;     /* slot that found it */
+    uint32_t flags;     /* 1 progression, 2 useful, 4 trap */
+    double server_time; /* estimated server time when received, s since epoch */
+} apstate_item;
+
+/* A string in the pool. length excludes the NUL. */
+typedef struct apstate_file_string {
+    uint32_t offset;
+    uint32_t length;
+} apstate_file_string;
+
+typedef struct apstate_file_name {
+    int64_t id;
+    apstate_file_string name;
+} apstate_file_name;
+
+typedef struct apstate_file_header {
+    char magic[8];              /* APSTATE_FORMAT_MAGIC, NUL-padded */
+    uint32_t version;           /* APSTATE_FORMAT_VERSION */
+    uint32_t header_size;       /* sizeof(apstate_file_header) */
+    uint64_t generation;        /* bumped by the fetcher on each visible change */
+    int64_t written_at_ms;      /* unix time */
+    int64_t checks_done;
+    int64_t location_count;     /* 0 if unknown */
+    int32_t slot_id;
+    int32_t team_id;
+
+    uint64_t item_count;
+    uint64_t items_offset;
+    uint64_t item_name_count;
+    uint64_t item_names_offset;
+    uint64_t location_name_count;
+    uint64_t location_names_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+
+    apstate_file_string seed;
+    apstate_file_string room_name;
+    apstate_file_string server_version;
+    apstate_file_string slot_name;
+    apstate_file_string game;
+} apstate_file_header;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APSTATE_FORMAT_H */
@@ -0,0 +1,311 @@
+#include "apstate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// One mapped snapshot. Read into memory where mmap is not available.
+struct Mapping {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint64_t file_id = 0; // inode: the fetcher renames a new file over the old one
+    int64_t mtime = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> buffer;
+#endif
+
+    Mapping() = default;
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    ~Mapping()
+    {
+#ifndef _WIN32
+        if (data)
+            munmap(const_cast<uint8_t*>(data), size);
+#endif
+    }
+
+    const apstate_file_header* header() const
+    {
+        return reinterpret_cast<const apstate_file_header*>(data);
+    }
+};
+
+bool file_identity(const std::string& path, uint64_t& file_id, int64_t& mtime, uint64_t& size)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    file_id = static_cast<uint64_t>(st.st_ino);
+    mtime = static_cast<int64_t>(st.st_mtime);
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool in_bounds(uint64_t offset, uint64_t count, uint64_t elem, size_t size)
+{
+    if (offset > size || offset % 8 != 0)
+        return false;
+    return count <= (size - offset) / elem;
+}
+
+// Checks every section against the file size so getters only have to check strings
+bool validate(const Mapping& m)
+{
+    if (m.size < sizeof(apstate_file_header))
+        return false;
+    const apstate_file_header* h = m.header();
+    if (std::memcmp(h->magic, APSTATE_FORMAT_MAGIC, sizeof(APSTATE_FORMAT_MAGIC)) != 0 ||
+        h->version != APSTATE_FORMAT_VERSION || h->header_size != sizeof(apstate_file_header))
+        return false;
+    return in_bounds(h->items_offset, h->item_count, sizeof(apstate_item), m.size) &&
+           in_bounds(h->item_names_offset, h->item_name_count, sizeof(apstate_file_name), m.size) &&
+           in_bounds(h->location_names_offset, h->location_name_count, sizeof(apstate_file_name), m.size) &&
+           h->strings_offset <= m.size && h->strings_size <= m.size - h->strings_offset;
+}
+
+Mapping* map_file(const std::string& path)
+{
+    Mapping* m = new (std::nothrow) Mapping();
+    if (!m)
+        return nullptr;
+    uint64_t size = 0;
+    if (!file_identity(path, m->file_id, m->mtime, size) || size < sizeof(apstate_file_header)) {
+        delete m;
+        return nullptr;
+    }
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        delete m;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { // the file may have been replaced since stat()
+        ::close(fd);
+        delete m;
+        return nullptr;
+    }
+    m->file_id = static_cast<uint64_t>(st.st_ino);
+    m->mtime = static_cast<int64_t>(st.st_mtime);
+    m->size = static_cast<size_t>(st.st_size);
+    void* p = m->size ? mmap(nullptr, m->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        m->size = 0;
+        delete m;
+        return nullptr;
+    }
+    m->data = static_cast<const uint8_t*>(p);
+#else
+    std::ifstream f(path, std::ios::binary);
+    m->buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    m->data = m->buffer.data();
+    m->size = m->buffer.size();
+#endif
+    if (!validate(*m)) {
+        delete m;
+        return nullptr;
+    }
+    return m;
+}
+
+const char* pool_string(const Mapping& m, const apstate_file_string& s)
+{
+    const apstate_file_header* h = m.header();
+    if ((uint64_t)s.offset + s.length >= h->strings_size)
+        return nullptr;
+    const char* str = reinterpret_cast<const char*>(m.data + h->strings_offset + s.offset);
+    return str[s.length] == '\0' ? str : nullptr;
+}
+
+const char* find_name(const Mapping& m, uint64_t offset, uint64_t count, int64_t id)
+{
+    const apstate_file_name* begin = reinterpret_cast<const apstate_file_name*>(m.data + offset);
+    const apstate_file_name* end = begin + count;
+    const apstate_file_name* it = std::lower_bound(begin, end, id,
+                                                   [](const apstate_file_name& n, int64_t v) { return n.id < v; });
+    if (it == end || it->id != id)
+        return nullptr;
+    return pool_string(m, it->name);
+}
+
+} // namespace
+
+struct apstate {
+    std::string path;
+    Mapping* mapping = nullptr;
+};
+
+namespace {
+
+const char* header_string(const apstate* state, apstate_file_string apstate_file_header::*field)
+{
+    if (!state)
+        return "";
+    const char* s = pool_string(*state->mapping, state->mapping->header()->*field);
+    return s ? s : "";
+}
+
+} // namespace
+
+extern "C" {
+
+int apstate_abi_version(void)
+{
+    return APSTATE_ABI_VERSION;
+}
+
+apstate* apstate_open(const char* path)
+{
+    if (!path)
+        return nullptr;
+    try {
+        Mapping* m = map_file(path);
+        if (!m)
+            return nullptr;
+        apstate* state = new apstate();
+        state->path = path;
+        state->mapping = m;
+        return state;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void apstate_close(apstate* state)
+{
+    if (!state)
+        return;
+    delete state->mapping;
+    delete state;
+}
+
+int apstate_refresh(apstate* state)
+{
+    if (!state)
+        return -1;
+    uint64_t file_id = 0, size = 0;
+    int64_t mtime = 0;
+    if (!file_identity(state->path, file_id, mtime, size))
+        return -1;
+    if (file_id == state->mapping->file_id && mtime == state->mapping->mtime && size == state->mapping->size)
+        return 0;
+    Mapping* m = map_file(state->path);
+    if (!m)
+        return 0; // keep the last good snapshot
+    delete state->mapping;
+    state->mapping = m;
+    return 1;
+}
+
+uint64_t apstate_generation(const apstate* state)
+{
+    return state ? state->mapping->header()->generation : 0;
+}
+
+int64_t apstate_written_at_ms(const apstate* state)
+{
+    return state ? state->mapping->header()->written_at_ms : 0;
+}
+
+int apstate_progress(const apstate* state, int64_t* checks_done, int64_t* total)
+{
+    if (!state)
+        return -1;
+    const apstate_file_header* h = state->mapping->header();
+    if (checks_done)
+        *checks_done = h->checks_done;
+    if (total)
+        *total = h->location_count;
+    return 0;
+}
+
+const apstate_item* apstate_items(const apstate* state, size_t* count)
+{
+    return apstate_items_since(state, INT64_MIN, count);
+}
+
+const apstate_item* apstate_items_since(const apstate* state, int64_t seq, size_t* count)
+{
+    if (count)
+        *count = 0;
+    if (!state)
+        return nullptr;
+    const apstate_file_header* h = state->mapping->header();
+    const apstate_item* begin = reinterpret_cast<const apstate_item*>(state->mapping->data + h->items_offset);
+    const apstate_item* end = begin + h->item_count;
+    const apstate_item* first = std::upper_bound(begin, end, seq,
+                                                 [](int64_t v, const apstate_item& it) { return v < it.index; });
+    if (count)
+        *count = static_cast<size_t>(end - first);
+    return first;
+}
+
+const char* apstate_item_name(const apstate* state, int64_t item_id)
+{
+    if (!state)
+        return nullptr;
+    const apstate_file_header* h = state->mapping->header();
+    return find_name(*state->mapping, h->item_names_offset, h->item_name_count, item_id);
+}
+
+const char* apstate_location_name(const apstate* state, int64_t location_id)
+{
+    if (!state)
+        return nullptr;
+    const apstate_file_header* h = state->mapping->header();
+    return find_name(*state->mapping, h->location_names_offset, h->location_name_count, location_id);
+}
+
+const char* apstate_seed(const apstate* state)
+{
+    return header_string(state, &apstate_file_header::seed);
+}
+
+const char* apstate_room_name(const apstate* state)
+{
+    return header_string(state, &apstate_file_header::room_name);
+}
+
+const char* apstate_server_version(const apstate* state)
+{
+    return header_string(state, &apstate_file_header::server_version);
+}
+
+const char* apstate_slot_name(const apstate* state)
+{
+    return header_string(state, &apstate_file_header::slot_name);
+}
+
+const char* apstate_game(const apstate* state)
+{
+    return header_string(state, &apstate_file_header::game);
+}
+
+int32_t apstate_slot_id(const apstate* state)
+{
+    return state ? state->mapping->header()->slot_id : -1;
+}
+
+int32_t apstate_team_id(const apstate* state)
+{
+    return state ? state->mapping->header()->team_id : -1;
+}
+
+} // extern "C"
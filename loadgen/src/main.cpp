@@ -0,0 +1,186 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include "synthetic_room.hpp"
+
+// ------------------------------------------------------------
+// ap_loadgen : serveur Archipelago synthétique, hors ligne,
+// pour tester la montée en charge du fetcher.
+//
+//   ./ap_loadgen [--config loadgen.json] [--port 38281] [--duration <sec>]
+//
+// Chaque fetcher se connecte avec slot_name "Player<n>" et le jeu
+// du slot n (voir loadgen/loadgen.example.json).
+// ------------------------------------------------------------
+
+typedef websocketpp::server<websocketpp::config::asio> server;
+typedef loadgen::SyntheticRoom::ClientId ClientId;
+
+static void usage(const char* argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [--config <file>] [--port <port>] [--duration <sec>] [--stats <sec>]\n"
+              << "  --config <file>   room settings (see loadgen/loadgen.example.json), defaults otherwise\n"
+              << "  --port <port>     port to listen on (default 38281)\n"
+              << "  --duration <sec>  stop after this many seconds (default 0: run until killed)\n"
+              << "  --stats <sec>     print stats every <sec> seconds (default 10)\n";
+}
+
+static void print_stats(const loadgen::RoomStats& s, double t)
+{
+    std::cout << "[LOADGEN] t=" << (int)t << "s"
+              << " connections " << s.connections
+              << " slots " << s.authenticated
+              << " frames in " << s.frames_in
+              << " out " << s.frames_out
+              << " (" << s.bytes_out / 1024 << " KiB)"
+              << " checks " << s.checks << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string config_path;
+    uint16_t port = 38281;
+    double duration = 0;
+    double stats_interval = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            config_path = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = (uint16_t)std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = std::atof(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_interval = std::atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    loadgen::RoomConfig cfg;
+    if (!config_path.empty()) {
+        std::ifstream f(config_path);
+        if (!f) {
+            std::cerr << "[LOADGEN] Unable to open " << config_path << std::endl;
+            return 1;
+        }
+        nlohmann::json j = nlohmann::json::parse(f, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) {
+            std::cerr << "[LOADGEN] Invalid JSON in " << config_path << std::endl;
+            return 1;
+        }
+        cfg = loadgen::RoomConfig::from_json(j);
+    }
+
+    server srv;
+    srv.clear_access_channels(websocketpp::log::alevel::all);
+    srv.clear_error_channels(websocketpp::log::elevel::all);
+    srv.set_error_channels(websocketpp::log::elevel::warn | websocketpp::log::elevel::rerror
+                           | websocketpp::log::elevel::fatal);
+    srv.init_asio();
+    srv.set_reuse_addr(true);
+
+    std::map<websocketpp::connection_hdl, ClientId, std::owner_less<websocketpp::connection_hdl>> ids;
+    std::map<ClientId, websocketpp::connection_hdl> hdls;
+    ClientId next_id = 1;
+    uint64_t send_errors = 0;
+
+    loadgen::SyntheticRoom room(cfg, [&](ClientId id, const std::string& frame) {
+        auto it = hdls.find(id);
+        if (it == hdls.end()) {
+            return;
+        }
+        websocketpp::lib::error_code ec;
+        srv.send(it->second, frame, websocketpp::frame::opcode::text, ec);
+        if (ec) {
+            send_errors++;
+        }
+    });
+
+    auto closed = [&](websocketpp::connection_hdl hdl) {
+        auto it = ids.find(hdl);
+        if (it == ids.end()) {
+            return;
+        }
+        room.on_close(it->second);
+        hdls.erase(it->second);
+        ids.erase(it);
+    };
+
+    srv.set_open_handler([&](websocketpp::connection_hdl hdl) {
+        ClientId id = next_id++;
+        ids[hdl] = id;
+        hdls[id] = hdl;
+        room.on_open(id);
+    });
+    srv.set_close_handler(closed);
+    srv.set_fail_handler(closed);
+    srv.set_message_handler([&](websocketpp::connection_hdl hdl, server::message_ptr msg) {
+        auto it = ids.find(hdl);
+        if (it != ids.end()) {
+            room.on_message(it->second, msg->get_payload());
+        }
+    });
+
+    websocketpp::lib::error_code ec;
+    srv.listen(port, ec);
+    if (ec) {
+        std::cerr << "[LOADGEN] Unable to listen on port " << port << ": " << ec.message() << std::endl;
+        return 1;
+    }
+    srv.start_accept();
+
+    std::cout << "[LOADGEN] ws://localhost:" << port << " seed '" << cfg.seed_name << "', "
+              << cfg.slots << " slots (" << room.slot_name(1) << ".." << room.slot_name(cfg.slots) << "), "
+              << cfg.games.size() << " games" << std::endl;
+
+    // Événements aléatoires et storms, toutes les 100 ms sur le thread asio
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    double next_stats = stats_interval;
+    std::function<void()> schedule_tick;
+    schedule_tick = [&]() {
+        srv.set_timer(100, [&](const websocketpp::lib::error_code& timer_ec) {
+            if (timer_ec) {
+                return;
+            }
+            double t = std::chrono::duration<double>(clock::now() - start).count();
+            room.tick(t);
+            if (stats_interval > 0 && t >= next_stats) {
+                print_stats(room.stats(), t);
+                next_stats += stats_interval;
+            }
+            if (duration > 0 && t >= duration) {
+                srv.stop_listening();
+                for (const auto& pair : hdls) {
+                    websocketpp::lib::error_code close_ec;
+                    srv.close(pair.second, websocketpp::close::status::going_away, "loadgen done", close_ec);
+                }
+                return; // run() returns once the connections are closed
+            }
+            schedule_tick();
+        });
+    };
+    schedule_tick();
+
+    srv.run();
+
+    print_stats(room.stats(), std::chrono::duration<double>(clock::now() - start).count());
+    if (send_errors) {
+        std::cout << "[LOADGEN] " << send_errors << " frames could not be sent" << std::endl;
+    }
+    return 0;
+}
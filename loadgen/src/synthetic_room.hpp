@@ -0,0 +1,696 @@
+#ifndef _LOADGEN_SYNTHETIC_ROOM_HPP
+#define _LOADGEN_SYNTHETIC_ROOM_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <nlohmann/json.hpp>
+
+// ------------------------------------------------------------
+// Room Archipelago synthétique pour ap_loadgen.
+//
+// Génère un multiworld (jeux, items, locations, placement) à partir
+// d'une config et parle assez du protocole AP pour faire tourner des
+// fetchers: RoomInfo, GetDataPackage, Connect/Connected, Sync,
+// ReceivedItems, LocationChecks, LocationScouts, RoomUpdate, PrintJSON,
+// Get/Set/SetNotify, StatusUpdate, Say, Bounce.
+//
+// Le comportement suit third_party/archipelago_py/MultiServer.py, en
+// simplifié: une seule équipe, pas de hints, pas de groupes.
+//
+// Indépendant du transport: le serveur websocket (main.cpp) appelle
+// on_open/on_message/on_close/tick et reçoit les frames à envoyer par
+// le callback SendFn. Pas thread-safe, tout doit venir du même thread.
+// ------------------------------------------------------------
+
+namespace loadgen {
+
+using json = nlohmann::json;
+
+struct Storm {
+    enum Type {
+        RELEASE, // the slot checks all its remaining locations at once
+        COLLECT, // every location holding an item for the slot is checked at once
+    };
+
+    double at_sec = 0;
+    Type type = RELEASE;
+    int slot = 1;
+};
+
+struct RoomConfig {
+    std::vector<std::string> games = {"Pokemon Emerald", "A Link to the Past", "Super Metroid"};
+    int slots = 8;                  // slot n is "<slot_prefix><n>" and plays games[(n-1) % games.size()]
+    std::string slot_prefix = "Player";
+    int items_per_game = 500;
+    int locations_per_slot = 300;
+    std::string password;
+    std::string seed_name = "loadgen";
+    uint32_t rng_seed = 1;          // same seed and config give the same multiworld and events
+
+    double checks_per_sec = 2;      // random checks by any slot, whole room
+    double chat_per_sec = 0.2;      // PrintJSON Chat, whole room
+    double advancement_ratio = 0.1;
+    double trap_ratio = 0.05;
+    std::vector<Storm> storms;
+
+    static RoomConfig from_json(const json& j)
+    {
+        RoomConfig cfg;
+        if (j.contains("games") && j["games"].is_array() && !j["games"].empty())
+            cfg.games = j["games"].get<std::vector<std::string>>();
+        cfg.slots              = std::max(1, j.value("slots", cfg.slots));
+        cfg.slot_prefix        = j.value("slot_prefix", cfg.slot_prefix);
+        cfg.items_per_game     = std::max(1, j.value("items_per_game", cfg.items_per_game));
+        cfg.locations_per_slot = std::max(1, j.value("locations_per_slot", cfg.locations_per_slot));
+        cfg.password           = j.value("password", cfg.password);
+        cfg.seed_name          = j.value("seed_name", cfg.seed_name);
+        cfg.rng_seed           = j.value("rng_seed", cfg.rng_seed);
+        cfg.checks_per_sec     = j.value("checks_per_sec", cfg.checks_per_sec);
+        cfg.chat_per_sec       = j.value("chat_per_sec", cfg.chat_per_sec);
+        cfg.advancement_ratio  = j.value("advancement_ratio", cfg.advancement_ratio);
+        cfg.trap_ratio         = j.value("trap_ratio", cfg.trap_ratio);
+        if (j.contains("storms") && j["storms"].is_array()) {
+            for (const auto& s : j["storms"]) {
+                Storm storm;
+                storm.at_sec = s.value("at_sec", 0.0);
+                storm.type = s.value("type", std::string("release")) == "collect" ? Storm::COLLECT : Storm::RELEASE;
+                storm.slot = s.value("slot", 1);
+                cfg.storms.push_back(storm);
+            }
+        }
+        return cfg;
+    }
+};
+
+struct RoomStats {
+    uint64_t connections = 0;       // currently open
+    uint64_t authenticated = 0;     // currently connected to a slot
+    uint64_t frames_in = 0;
+    uint64_t frames_out = 0;
+    uint64_t bytes_out = 0;
+    uint64_t checks = 0;
+    uint64_t items_sent = 0;
+};
+
+class SyntheticRoom {
+public:
+    typedef uint64_t ClientId;
+    typedef std::function<void(ClientId, const std::string&)> SendFn;
+
+    static constexpr int64_t ITEM_BASE = 1000000;     // item j of game g: ITEM_BASE * (g + 1) + j
+    static constexpr int64_t LOCATION_BASE = 5000000; // location j of game g: LOCATION_BASE * (g + 1) + j
+    static constexpr int PRINT_CHUNK = 140;           // PrintJSON per frame, like MultiServer
+
+    SyntheticRoom(const RoomConfig& cfg, SendFn send)
+        : cfg_(cfg), send_(std::move(send)), rng_(cfg.rng_seed)
+    {
+        generate();
+    }
+
+    void on_open(ClientId id)
+    {
+        clients_[id] = Client();
+        stats_.connections++;
+        json games = json::array();
+        json checksums = json::object();
+        for (const auto& game : cfg_.games) {
+            games.push_back(game);
+            checksums[game] = checksum(game);
+        }
+        games.push_back("Archipelago");
+        checksums["Archipelago"] = archipelago_data()["checksum"];
+        send(id, json::array({{
+            {"cmd", "RoomInfo"},
+            {"password", !cfg_.password.empty()},
+            {"games", games},
+            {"tags", json::array()},
+            {"version", version()},
+            {"generator_version", version()},
+            {"permissions", {{"release", 2}, {"remaining", 2}, {"collect", 2}}},
+            {"hint_cost", 10},
+            {"location_check_points", 1},
+            {"datapackage_checksums", checksums},
+            {"seed_name", cfg_.seed_name},
+            {"time", std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count()},
+        }}));
+    }
+
+    void on_close(ClientId id)
+    {
+        auto it = clients_.find(id);
+        if (it == clients_.end())
+            return;
+        if (it->second.slot)
+            stats_.authenticated--;
+        stats_.connections--;
+        clients_.erase(it);
+    }
+
+    void on_message(ClientId id, const std::string& frame)
+    {
+        auto it = clients_.find(id);
+        if (it == clients_.end())
+            return;
+        stats_.frames_in++;
+        json packet = json::parse(frame, nullptr, false);
+        if (!packet.is_array()) {
+            send(id, json::array({{{"cmd", "InvalidPacket"}, {"type", "cmd"}, {"original_cmd", nullptr},
+                                   {"text", "Could not decode JSON"}}}));
+            return;
+        }
+        for (auto& command : packet) {
+            if (!command.is_object() || !command.contains("cmd") || !command["cmd"].is_string())
+                continue;
+            try {
+                handle(id, command);
+            } catch (const json::exception&) {
+                // wrong argument types, e.g. "locations": ["x"]: the server answers, it doesn't go down
+                send(id, json::array({{{"cmd", "InvalidPacket"}, {"type", "arg"}, {"original_cmd", command["cmd"]},
+                                       {"text", "Invalid arguments"}}}));
+            }
+            if (clients_.find(id) == clients_.end())
+                return;
+        }
+    }
+
+    // Drive random events and storms. now_sec: seconds since the server started, increasing.
+    void tick(double now_sec)
+    {
+        double dt = std::max(0.0, now_sec - now_sec_);
+        now_sec_ = now_sec;
+
+        for (const auto& storm : cfg_.storms) {
+            if (storm.at_sec > now_sec || storms_done_.count(&storm))
+                continue;
+            storms_done_.insert(&storm);
+            if (storm.slot < 1 || storm.slot > cfg_.slots)
+                continue;
+            if (storm.type == Storm::RELEASE) {
+                std::vector<int64_t> locations;
+                for (size_t j = 0; j < slots_[storm.slot].checked.size(); j++)
+                    if (!slots_[storm.slot].checked[j])
+                        locations.push_back(location_id(slots_[storm.slot].game, (int)j));
+                check(storm.slot, locations);
+            } else {
+                for (int finder = 1; finder <= cfg_.slots; finder++) {
+                    std::vector<int64_t> locations;
+                    const auto& s = slots_[finder];
+                    for (size_t j = 0; j < s.placement.size(); j++)
+                        if (!s.checked[j] && s.placement[j].receiver == storm.slot)
+                            locations.push_back(location_id(s.game, (int)j));
+                    check(finder, locations);
+                }
+            }
+        }
+
+        for (int n = events(cfg_.checks_per_sec * dt, check_carry_); n > 0; n--) {
+            int slot = std::uniform_int_distribution<int>(1, cfg_.slots)(rng_);
+            const auto& s = slots_[slot];
+            int j = std::uniform_int_distribution<int>(0, (int)s.checked.size() - 1)(rng_);
+            if (!s.checked[j])
+                check(slot, {location_id(s.game, j)});
+        }
+
+        for (int n = events(cfg_.chat_per_sec * dt, chat_carry_); n > 0; n--) {
+            int slot = std::uniform_int_distribution<int>(1, cfg_.slots)(rng_);
+            std::string text = slot_name(slot) + ": gg " + std::to_string(++chat_count_);
+            broadcast(json::array({{{"cmd", "PrintJSON"}, {"type", "Chat"}, {"team", 0}, {"slot", slot},
+                                    {"message", "gg"}, {"data", json::array({{{"text", text}}})}}}));
+        }
+    }
+
+    const RoomStats& stats() const
+    {
+        return stats_;
+    }
+
+    const RoomConfig& config() const
+    {
+        return cfg_;
+    }
+
+    std::string slot_name(int slot) const
+    {
+        return cfg_.slot_prefix + std::to_string(slot);
+    }
+
+private:
+    struct Placement {
+        int64_t item;
+        int receiver;
+        unsigned flags;
+    };
+
+    struct Slot {
+        int game = 0;
+        std::vector<Placement> placement; // per location index
+        std::vector<bool> checked;
+        json received = json::array();    // NetworkItems, in order
+    };
+
+    struct Client {
+        int slot = 0;                     // 0 until Connect succeeded
+        bool wants_items = true;
+        size_t send_index = 0;            // items of the slot already sent to this client
+        std::set<std::string> tags;
+        std::set<std::string> notify;     // SetNotify keys
+    };
+
+    static json version()
+    {
+        return {{"major", 0}, {"minor", 6}, {"build", 2}, {"class", "Version"}};
+    }
+
+    static int64_t item_id(int game, int j)
+    {
+        return ITEM_BASE * (game + 1) + j;
+    }
+
+    static int64_t location_id(int game, int j)
+    {
+        return LOCATION_BASE * (game + 1) + j;
+    }
+
+    std::string checksum(const std::string& game) const
+    {
+        return cfg_.seed_name + "-" + std::to_string(cfg_.rng_seed) + "-" + std::to_string(cfg_.items_per_game)
+               + "-" + std::to_string(cfg_.locations_per_slot) + "-" + std::to_string(std::hash<std::string>()(game));
+    }
+
+    void generate()
+    {
+        slots_.resize((size_t)cfg_.slots + 1);
+        std::uniform_int_distribution<int> receiver_dist(1, cfg_.slots);
+        std::uniform_int_distribution<int> item_dist(0, cfg_.items_per_game - 1);
+        std::uniform_real_distribution<double> flag_dist(0, 1);
+        for (int slot = 1; slot <= cfg_.slots; slot++) {
+            Slot& s = slots_[slot];
+            s.game = (slot - 1) % (int)cfg_.games.size();
+            s.checked.assign((size_t)cfg_.locations_per_slot, false);
+            for (int j = 0; j < cfg_.locations_per_slot; j++) {
+                Placement p;
+                p.receiver = receiver_dist(rng_);
+                p.item = item_id(slots_game(p.receiver), item_dist(rng_));
+                double f = flag_dist(rng_);
+                p.flags = f < cfg_.advancement_ratio ? 1u : f < cfg_.advancement_ratio + cfg_.trap_ratio ? 4u : 0u;
+                s.placement.push_back(p);
+            }
+        }
+    }
+
+    int slots_game(int slot) const
+    {
+        return (slot - 1) % (int)cfg_.games.size();
+    }
+
+    json game_data(int game) const
+    {
+        json items = json::object();
+        json locations = json::object();
+        for (int j = 0; j < cfg_.items_per_game; j++)
+            items["Item " + std::to_string(j)] = item_id(game, j);
+        for (int j = 0; j < cfg_.locations_per_slot; j++)
+            locations["Location " + std::to_string(j)] = location_id(game, j);
+        return {
+            {"item_name_to_id", items},
+            {"location_name_to_id", locations},
+            {"checksum", checksum(cfg_.games[(size_t)game])},
+        };
+    }
+
+    static json archipelago_data()
+    {
+        return {
+            {"item_name_to_id", {{"Nothing", -1}}},
+            {"location_name_to_id", {{"Cheat Console", -1}, {"Server", -2}}},
+            {"checksum", "loadgen-archipelago"},
+        };
+    }
+
+    int events(double expected, double& carry)
+    {
+        // deterministic rate: carry the fractional part to the next tick
+        carry += expected;
+        int n = (int)carry;
+        carry -= n;
+        return n;
+    }
+
+    void send(ClientId id, const json& packet)
+    {
+        std::string frame = packet.dump();
+        stats_.frames_out++;
+        stats_.bytes_out += frame.size();
+        send_(id, frame);
+    }
+
+    void broadcast(const json& packet)
+    {
+        std::string frame;
+        for (const auto& pair : clients_) {
+            if (!pair.second.slot)
+                continue;
+            if (frame.empty())
+                frame = packet.dump();
+            stats_.frames_out++;
+            stats_.bytes_out += frame.size();
+            send_(pair.first, frame);
+        }
+    }
+
+    void send_slot(int slot, const json& packet)
+    {
+        for (const auto& pair : clients_)
+            if (pair.second.slot == slot)
+                send(pair.first, packet);
+    }
+
+    json players() const
+    {
+        json list = json::array();
+        for (int slot = 1; slot <= cfg_.slots; slot++)
+            list.push_back({{"team", 0}, {"slot", slot}, {"alias", slot_name(slot)}, {"name", slot_name(slot)},
+                            {"class", "NetworkPlayer"}});
+        return list;
+    }
+
+    json slot_info() const
+    {
+        json info = json::object();
+        for (int slot = 1; slot <= cfg_.slots; slot++)
+            info[std::to_string(slot)] = {{"name", slot_name(slot)}, {"game", cfg_.games[(size_t)slots_game(slot)]},
+                                          {"type", 1}, {"group_members", json::array()}, {"class", "NetworkSlot"}};
+        return info;
+    }
+
+    void send_new_items()
+    {
+        for (auto& pair : clients_) {
+            Client& client = pair.second;
+            if (!client.slot || !client.wants_items)
+                continue;
+            const json& received = slots_[client.slot].received;
+            if (received.size() <= client.send_index)
+                continue;
+            json items(json::value_t::array);
+            for (size_t i = client.send_index; i < received.size(); i++)
+                items.push_back(received[i]);
+            send(pair.first, json::array({{{"cmd", "ReceivedItems"}, {"index", client.send_index}, {"items", items}}}));
+            client.send_index = received.size();
+        }
+    }
+
+    void check(int finder, const std::vector<int64_t>& locations)
+    {
+        Slot& s = slots_[finder];
+        json checked = json::array();
+        json prints = json::array();
+        for (int64_t location : locations) {
+            int64_t j = location - location_id(s.game, 0);
+            if (j < 0 || j >= (int64_t)s.checked.size() || s.checked[(size_t)j])
+                continue;
+            s.checked[(size_t)j] = true;
+            const Placement& p = s.placement[(size_t)j];
+            json item = {{"item", p.item}, {"location", location}, {"player", finder}, {"flags", p.flags},
+                         {"class", "NetworkItem"}};
+            slots_[p.receiver].received.push_back(item);
+            checked.push_back(location);
+            stats_.checks++;
+            stats_.items_sent++;
+
+            json data = json::array();
+            data.push_back({{"type", "player_id"}, {"text", std::to_string(finder)}});
+            if (p.receiver == finder) {
+                data.push_back({{"text", " found their "}});
+                data.push_back({{"type", "item_id"}, {"text", std::to_string(p.item)}, {"player", finder}, {"flags", p.flags}});
+            } else {
+                data.push_back({{"text", " sent "}});
+                data.push_back({{"type", "item_id"}, {"text", std::to_string(p.item)}, {"player", p.receiver}, {"flags", p.flags}});
+                data.push_back({{"text", " to "}});
+                data.push_back({{"type", "player_id"}, {"text", std::to_string(p.receiver)}});
+            }
+            data.push_back({{"text", " ("}});
+            data.push_back({{"type", "location_id"}, {"text", std::to_string(location)}, {"player", finder}});
+            data.push_back({{"text", ")"}});
+            prints.push_back({{"cmd", "PrintJSON"}, {"type", "ItemSend"}, {"receiving", p.receiver},
+                              {"item", item}, {"data", data}});
+            if (prints.size() >= (size_t)PRINT_CHUNK) {
+                broadcast(prints);
+                prints = json::array();
+            }
+        }
+        if (!prints.empty())
+            broadcast(prints);
+        if (checked.empty())
+            return;
+        send_new_items();
+        send_slot(finder, json::array({{{"cmd", "RoomUpdate"}, {"hint_points", 0}, {"checked_locations", checked}}}));
+    }
+
+    void refuse(ClientId id, const std::string& error)
+    {
+        send(id, json::array({{{"cmd", "ConnectionRefused"}, {"errors", json::array({error})}}}));
+    }
+
+    void handle_connect(ClientId id, Client& client, const json& command)
+    {
+        if (!cfg_.password.empty() && command.value("password", std::string()) != cfg_.password) {
+            refuse(id, "InvalidPassword");
+            return;
+        }
+        std::string name = command.value("name", std::string());
+        int slot = 0;
+        for (int n = 1; n <= cfg_.slots; n++)
+            if (slot_name(n) == name)
+                slot = n;
+        if (!slot) {
+            refuse(id, "InvalidSlot");
+            return;
+        }
+        std::string game = command.value("game", std::string());
+        if (!game.empty() && game != cfg_.games[(size_t)slots_game(slot)]) {
+            refuse(id, "InvalidGame");
+            return;
+        }
+        if (!client.slot)
+            stats_.authenticated++;
+        client.slot = slot;
+        client.wants_items = command.value("items_handling", 7) != 0;
+        client.tags.clear();
+        if (command.contains("tags") && command["tags"].is_array())
+            for (const auto& tag : command["tags"])
+                if (tag.is_string())
+                    client.tags.insert(tag.get<std::string>());
+
+        const Slot& s = slots_[slot];
+        json checked = json::array();
+        json missing = json::array();
+        for (size_t j = 0; j < s.checked.size(); j++)
+            (s.checked[j] ? checked : missing).push_back(location_id(s.game, (int)j));
+        json reply = json::array();
+        reply.push_back({
+            {"cmd", "Connected"}, {"team", 0}, {"slot", slot}, {"players", players()},
+            {"missing_locations", missing}, {"checked_locations", checked},
+            {"slot_info", slot_info()}, {"hint_points", 0}, {"slot_data", {{"loadgen", true}}},
+        });
+        if (client.wants_items && !s.received.empty())
+            reply.push_back({{"cmd", "ReceivedItems"}, {"index", 0}, {"items", s.received}});
+        client.send_index = client.wants_items ? s.received.size() : 0;
+        send(id, reply);
+    }
+
+    static void apply_operation(json& value, const std::string& op, const json& arg)
+    {
+        if (op == "replace") {
+            value = arg;
+        } else if (op == "default") {
+            // value already defaulted
+        } else if (op == "add" && value.is_array() && arg.is_array()) {
+            for (const auto& v : arg)
+                value.push_back(v);
+        } else if (op == "add" && value.is_number() && arg.is_number()) {
+            value = value.get<double>() + arg.get<double>();
+            if (value.get<double>() == (double)(int64_t)value.get<double>())
+                value = (int64_t)value.get<double>();
+        } else if (op == "mul" && value.is_number() && arg.is_number()) {
+            value = value.get<double>() * arg.get<double>();
+        } else if (op == "max" && value.is_number() && arg.is_number()) {
+            value = std::max(value, arg);
+        } else if (op == "min" && value.is_number() && arg.is_number()) {
+            value = std::min(value, arg);
+        } else if ((op == "and" || op == "or" || op == "xor") && value.is_number_integer() && arg.is_number_integer()) {
+            int64_t a = value.get<int64_t>(), b = arg.get<int64_t>();
+            value = op == "and" ? (a & b) : op == "or" ? (a | b) : (a ^ b);
+        } else if (op == "remove" && value.is_array()) {
+            auto it = std::find(value.begin(), value.end(), arg);
+            if (it != value.end())
+                value.erase(it);
+        } else if (op == "pop" && value.is_array() && arg.is_number_integer()) {
+            int64_t i = arg.get<int64_t>();
+            if (i < 0)
+                i += (int64_t)value.size();
+            if (i >= 0 && i < (int64_t)value.size())
+                value.erase((size_t)i);
+        } else if (op == "pop" && value.is_object() && arg.is_string()) {
+            value.erase(arg.get<std::string>());
+        } else if (op == "update" && value.is_object() && arg.is_object()) {
+            value.update(arg);
+        }
+    }
+
+    void handle_set(ClientId id, const json& command)
+    {
+        if (!command.contains("key") || !command["key"].is_string())
+            return;
+        std::string key = command["key"];
+        auto it = storage_.find(key);
+        json original = it != storage_.end() ? it->second : json(nullptr);
+        json value = it != storage_.end() ? it->second : command.value("default", json(nullptr));
+        if (command.contains("operations") && command["operations"].is_array())
+            for (const auto& op : command["operations"])
+                if (op.is_object())
+                    apply_operation(value, op.value("operation", std::string()), op.value("value", json(nullptr)));
+        storage_[key] = value;
+
+        json reply = command;
+        reply["cmd"] = "SetReply";
+        reply["value"] = value;
+        reply["original_value"] = original;
+        reply["slot"] = clients_[id].slot;
+        reply.erase("operations");
+        json packet = json::array({reply});
+        for (const auto& pair : clients_)
+            if ((pair.first == id && command.value("want_reply", false)) || pair.second.notify.count(key))
+                send(pair.first, packet);
+    }
+
+    void handle(ClientId id, const json& command)
+    {
+        Client& client = clients_[id];
+        const std::string cmd = command["cmd"];
+
+        if (cmd == "GetDataPackage") {
+            std::set<std::string> wanted;
+            if (command.contains("games") && command["games"].is_array())
+                wanted = command["games"].get<std::set<std::string>>();
+            json games = json::object();
+            for (size_t g = 0; g < cfg_.games.size(); g++)
+                if (wanted.empty() || wanted.count(cfg_.games[g]))
+                    games[cfg_.games[g]] = game_data((int)g);
+            if (wanted.empty() || wanted.count("Archipelago"))
+                games["Archipelago"] = archipelago_data();
+            send(id, json::array({{{"cmd", "DataPackage"}, {"data", {{"games", games}}}}}));
+            return;
+        }
+        if (cmd == "Connect") {
+            handle_connect(id, client, command);
+            return;
+        }
+        if (!client.slot) {
+            send(id, json::array({{{"cmd", "InvalidPacket"}, {"type", "cmd"}, {"original_cmd", cmd},
+                                   {"text", "Not connected to a slot"}}}));
+            return;
+        }
+
+        if (cmd == "Sync") {
+            client.send_index = 0;
+            send_new_items();
+        } else if (cmd == "LocationChecks") {
+            if (command.contains("locations") && command["locations"].is_array())
+                check(client.slot, command["locations"].get<std::vector<int64_t>>());
+        } else if (cmd == "LocationScouts") {
+            json infos = json::array();
+            const Slot& s = slots_[client.slot];
+            if (command.contains("locations") && command["locations"].is_array()) {
+                for (const auto& loc : command["locations"]) {
+                    int64_t j = loc.get<int64_t>() - location_id(s.game, 0);
+                    if (j < 0 || j >= (int64_t)s.placement.size())
+                        continue;
+                    const Placement& p = s.placement[(size_t)j];
+                    infos.push_back({{"item", p.item}, {"location", loc}, {"player", p.receiver}, {"flags", p.flags},
+                                     {"class", "NetworkItem"}});
+                }
+            }
+            send(id, json::array({{{"cmd", "LocationInfo"}, {"locations", infos}}}));
+        } else if (cmd == "Say") {
+            std::string text = slot_name(client.slot) + ": " + command.value("text", std::string());
+            broadcast(json::array({{{"cmd", "PrintJSON"}, {"type", "Chat"}, {"team", 0}, {"slot", client.slot},
+                                    {"message", command.value("text", std::string())},
+                                    {"data", json::array({{{"text", text}}})}}}));
+        } else if (cmd == "StatusUpdate") {
+            json set = {{"key", "_read_client_status_0_" + std::to_string(client.slot)},
+                        {"operations", json::array({{{"operation", "replace"}, {"value", command.value("status", 0)}}})}};
+            handle_set(id, set);
+        } else if (cmd == "Get") {
+            json reply = command;
+            reply["cmd"] = "Retrieved";
+            json keys = json::object();
+            if (command.contains("keys") && command["keys"].is_array()) {
+                for (const auto& key : command["keys"]) {
+                    if (!key.is_string())
+                        continue;
+                    auto it = storage_.find(key.get<std::string>());
+                    keys[key.get<std::string>()] = it != storage_.end() ? it->second : json(nullptr);
+                }
+            }
+            reply["keys"] = keys;
+            send(id, json::array({reply}));
+        } else if (cmd == "Set") {
+            handle_set(id, command);
+        } else if (cmd == "SetNotify") {
+            if (command.contains("keys") && command["keys"].is_array())
+                for (const auto& key : command["keys"])
+                    if (key.is_string())
+                        client.notify.insert(key.get<std::string>());
+        } else if (cmd == "Bounce") {
+            json bounced = command;
+            bounced["cmd"] = "Bounced";
+            json packet = json::array({bounced});
+            for (const auto& pair : clients_) {
+                const Client& other = pair.second;
+                if (!other.slot)
+                    continue;
+                bool match = false;
+                if (command.contains("slots") && command["slots"].is_array())
+                    for (const auto& s : command["slots"])
+                        match = match || s == other.slot;
+                if (command.contains("games") && command["games"].is_array())
+                    for (const auto& g : command["games"])
+                        match = match || g == cfg_.games[(size_t)slots_game(other.slot)];
+                if (command.contains("tags") && command["tags"].is_array())
+                    for (const auto& t : command["tags"])
+                        match = match || (t.is_string() && other.tags.count(t.get<std::string>()));
+                if (match)
+                    send(pair.first, packet);
+            }
+        } else if (cmd != "ConnectUpdate" && cmd != "UpdateHint" && cmd != "CreateHints") {
+            send(id, json::array({{{"cmd", "InvalidPacket"}, {"type", "cmd"}, {"original_cmd", cmd},
+                                   {"text", "Unknown command"}}}));
+        }
+    }
+
+    RoomConfig cfg_;
+    SendFn send_;
+    std::mt19937 rng_;
+    std::vector<Slot> slots_;         // index 0 unused
+    std::map<ClientId, Client> clients_;
+    std::map<std::string, json> storage_;
+    std::set<const Storm*> storms_done_;
+    RoomStats stats_;
+    double now_sec_ = 0;
+    double check_carry_ = 0;
+    double chat_carry_ = 0;
+    uint64_t chat_count_ = 0;
+};
+
+} // namespace loadgen
+
+#endif // _LOADGEN_SYNTHETIC_ROOM_HPP
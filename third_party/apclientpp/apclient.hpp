@@ -29,14 +29,23 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 //#define AP_NO_DEFAULT_DATA_PACKAGE_STORE // to disable auto-construction of data package store
 //#define AP_NO_SCHEMA // to disable schema checking
 //#define AP_PREFER_UNENCRYPTED // try unencrypted connection first, then encrypted
+//#define AP_NO_THREADS // to disable background loading of cached data packages
+
+#if defined __EMSCRIPTEN__ && !defined __EMSCRIPTEN_PTHREADS__ && !defined AP_NO_THREADS
+#define AP_NO_THREADS
+#endif
 
 
 #include <wswrap.hpp>
+#include <fstream>
 #include <list>
 #include <map>
 #include <set>
 #include <string>
 #include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #if defined(_MSC_VER) && _MSC_VER < 1910 // older msvc doesn't like the has_include
 #define NO_OPTIONAL
 #else
@@ -57,6 +66,13 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <valijson/validator.hpp>
 #endif
 #include <chrono>
+#include <random>
+#ifndef AP_NO_THREADS
+#include <atomic>
+#include <mutex>
+#include <thread>
+#endif
+#include <memory>
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdio.h>
@@ -82,6 +98,18 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #endif
 
 
+/**
+ * Id/name tables of a single game's data package.
+ *
+ * Filled by `APDataPackageStore::load_names()` so APClient can skip parsing the json data package.
+ */
+struct APDataPackageNames {
+    std::string checksum;
+    std::vector<std::pair<int64_t, std::string>> items;     // sorted by id
+    std::vector<std::pair<int64_t, std::string>> locations; // sorted by id
+};
+
+
 /**
  * Abstract data package storage handler.
  *
@@ -99,12 +127,27 @@ public:
 
     virtual bool load(const std::string& game, const std::string& checksum, json& data) = 0;
     virtual bool save(const std::string& game, const json& data) = 0;
+
+    /**
+     * Optional fast path used for checksum'd data packages.
+     * Fill names without parsing a json document. Return false to have APClient call load() instead.
+     * APClient rebuilds the game's entry in get_data_package() (checksum, item_name_to_id and
+     * location_name_to_id only) from these tables, so data package callbacks still see the game.
+     */
+    virtual bool load_names(const std::string& game, const std::string& checksum, APDataPackageNames& names)
+    {
+        (void)game;
+        (void)checksum;
+        (void)names;
+        return false;
+    }
 };
 
 
 #ifndef AP_NO_DEFAULT_DATA_PACKAGE_STORE
 #include "defaultdatapackagestore.hpp"
 #endif
+#include "locationset.hpp"
 
 
 /**
@@ -132,10 +175,18 @@ public:
     static const char DEFAULT_URI[]; // = "localhost:38281"; // assign this in implementation
 #endif
 
+    /**
+     * Starts connecting to uri right away. schemeFile remembers which of ws:// and wss:// worked per host, and the
+     * first connect already tries that one. It is only used if uri has no scheme. A good place for the file is next
+     * to the one passed to ap_get_uuid.
+     */
     APClient(const std::string& uuid, const std::string& game, const std::string& uri = "localhost:38281",
-             const std::string& certStore="", APDataPackageStore* dataPackageStore = nullptr)
+             const std::string& certStore="", APDataPackageStore* dataPackageStore = nullptr,
+             const std::string& schemeFile="")
         : _dataPackageStore(dataPackageStore)
     {
+        _schemeFile = schemeFile;
+
         // check if certStore is supported and required
         #if WSWRAP_VERSION < 10100 && !defined __EMSCRIPTEN__
         if (!certStore.empty()) {
@@ -183,6 +234,11 @@ public:
                 if (pSlash != _uri.npos) tmp += _uri.substr(pSlash);
                 _uri = tmp;
             }
+            if (_tryWSS && !_schemeFile.empty()) {
+                std::string scheme = load_scheme(_schemeFile, get_uri_host(_uri));
+                if (!scheme.empty())
+                    _uri = scheme + _uri.substr(_uri.find("://"));
+            }
         }
 
         if (!_dataPackageStore) {
@@ -217,6 +273,12 @@ public:
 
     virtual ~APClient()
     {
+        _cancel_data_package_loads();
+#ifndef AP_NO_THREADS
+        // the store may go away with us: wait for loads that are still reading it
+        for (auto& batch: _retiredDataPackageLoads)
+            _join_data_package_loads(*batch);
+#endif
     }
 
     enum class State {
@@ -247,6 +309,12 @@ public:
         FLAG_TRAP = 4,
     };
 
+    enum class NameMatch {
+        EXACT,            ///< Name has to match exactly
+        CASE_INSENSITIVE, ///< ASCII letters are compared case-insensitive
+        NORMALIZED,       ///< Case-insensitive, ignoring whitespace and punctuation
+    };
+
     enum HintStatus {
         HINT_UNSPECIFIED = 0,  ///< The receiving player has not specified any status
         HINT_NO_PRIORITY = 10, ///< The receiving player has specified that the item is unneeded
@@ -372,6 +440,36 @@ public:
         }
     };
 
+    /**
+     * When the phases of the current or last (re)connect happened. Phases that did not happen yet are
+     * time_point(). items_synced is the first ReceivedItems after Connected, which the server skips if
+     * there are no items.
+     */
+    struct ConnectTimings {
+        typedef std::chrono::steady_clock::time_point time_point;
+        time_point started;            // connection lost, or first connect
+        time_point socket_open;
+        time_point room_info;
+        time_point data_package_ready;
+        time_point connected;
+        time_point items_synced;
+        unsigned attempts = 0;         // socket connect attempts since started
+        unsigned reconnects = 0;       // connections lost since the APClient was created
+    };
+
+    /**
+     * Estimated heap bytes held by the client, see get_memory_usage().
+     * Estimates count container nodes and string buffers but not allocator overhead.
+     */
+    struct MemoryUsage {
+        size_t dataPackage = 0; ///< data package json, all games
+        size_t nameMaps = 0;    ///< id -> name maps, global and per game
+        size_t nameIndexes = 0; ///< name -> id lookups per game
+        size_t locations = 0;   ///< checked and missing location sets
+        size_t players = 0;     ///< players and slot info
+        size_t queues = 0;      ///< batched commands and queued checks, scouts and hints
+    };
+
     struct DataStorageOperation {
         std::string operation;
         json value;
@@ -584,16 +682,14 @@ public:
 
     void set_retrieved_handler(std::function<void(const std::map<std::string,json>&)> f)
     {
-        set_retrieved_handler([f](const std::map<std::string, json>& keys, const json&) {
-            if (!f)
-                return;
-
-            f(keys);
-        });
+        // without the message, the values can be moved out of it instead of copied
+        _hOnRetrieved = nullptr;
+        _hOnRetrievedKeys = f;
     }
 
     void set_retrieved_handler(std::function<void(const std::map<std::string,json>&, const json& message)> f)
     {
+        _hOnRetrievedKeys = nullptr;
         _hOnRetrieved = f;
     }
 
@@ -609,6 +705,40 @@ public:
         });
     }
 
+    /**
+     * Called with every frame received from the server, before it is handled, and every frame sent to it.
+     * outgoing is true for sent frames. For recording sessions; see inject_message for replaying them.
+     */
+    void set_frame_handler(std::function<void(bool outgoing, const std::string& frame)> f)
+    {
+        _hOnFrame = f;
+    }
+
+    enum class ProfilePhase {
+        PARSE,    ///< json parsing of a received frame, cmd is empty
+        VALIDATE, ///< schema validation of a received frame (cmd empty) or of one command, not with AP_NO_SCHEMA
+        COMMAND,  ///< handling of one received command, including its validation and the handler set for it
+        DATA_PACKAGE, ///< storing and indexing one game's data package, received or cached, cmd is the game
+    };
+
+    typedef std::chrono::steady_clock::time_point ProfileTime;
+
+    /// When the frame being handled was received. Use in handlers to measure latency from the network.
+    ProfileTime get_frame_time() const
+    {
+        return _frameTime;
+    }
+
+    /**
+     * Profiling hook, called when a phase of handling received frames ended, with when it started and ended.
+     * Runs on the thread that calls poll(), so keep it cheap. Without a hook, no time is taken.
+     */
+    void set_profile_handler(std::function<void(ProfilePhase phase, const std::string& cmd,
+                                                ProfileTime start, ProfileTime end)> f)
+    {
+        _hOnProfile = f;
+    }
+
     /// Set location sending/receiving mode:
     /// If receiveOwnLocations is set to true, missing and checked locations
     /// won't update until the server acknowledges the LocationChecks and
@@ -625,33 +755,217 @@ public:
         return _receiveOwnLocations;
     }
 
+    /// Set the number of threads used to load and parse cached data packages on RoomInfo.
+    /// With 0 (the default) they are loaded on the network thread before the RoomInfo is done being handled.
+    /// Otherwise they are loaded in the background and each game becomes available on poll() once ready.
+    /// The data package store has to support concurrent load()/load_names() calls for different games.
+    void set_data_package_load_threads(unsigned threads)
+    {
+#ifndef AP_NO_THREADS
+        _dataPackageLoadThreads = threads;
+#else
+        (void)threads;
+#endif
+    }
+
+    const ConnectTimings& get_connect_timings() const
+    {
+        return _connectTimings;
+    }
+
+    /// Walks the client's tables to estimate their size, which takes a while for big data packages
+    MemoryUsage get_memory_usage() const
+    {
+        MemoryUsage usage;
+        usage.dataPackage = estimate_json_bytes(_dataPackage);
+        usage.nameMaps = _id_map_bytes(_items) + _id_map_bytes(_locations);
+        for (const auto& pair: _gameItems)
+            usage.nameMaps += _treeNodeBytes + sizeof(pair) + _string_bytes(pair.first) + _id_map_bytes(pair.second);
+        for (const auto& pair: _gameLocations)
+            usage.nameMaps += _treeNodeBytes + sizeof(pair) + _string_bytes(pair.first) + _id_map_bytes(pair.second);
+        for (const auto& pair: _gameItemIds)
+            usage.nameIndexes += _treeNodeBytes + sizeof(pair) + _string_bytes(pair.first) + _name_index_bytes(pair.second);
+        for (const auto& pair: _gameLocationIds)
+            usage.nameIndexes += _treeNodeBytes + sizeof(pair) + _string_bytes(pair.first) + _name_index_bytes(pair.second);
+        usage.locations = _checkedLocations.memory_bytes() + _missingLocations.memory_bytes();
+        usage.players = _players.capacity() * sizeof(NetworkPlayer);
+        for (const auto& player: _players)
+            usage.players += _string_bytes(player.alias) + _string_bytes(player.name);
+        for (const auto& pair: _slotInfo) {
+            usage.players += _treeNodeBytes + sizeof(pair) + _string_bytes(pair.second.name)
+                             + _string_bytes(pair.second.game)
+                             + pair.second.members.size() * (2 * sizeof(void*) + sizeof(int));
+        }
+        usage.queues = estimate_json_bytes(_outgoingBatch) + _checkQueue.size() * (_treeNodeBytes + sizeof(int64_t))
+                       + _updateHintQueue.capacity() * sizeof(_updateHintQueue[0]);
+        for (const auto& pair: _scoutQueues)
+            usage.queues += _treeNodeBytes + sizeof(pair) + pair.second.size() * (_treeNodeBytes + sizeof(int64_t));
+        for (const auto& pair: _createHintsQueueByPlayerAndStatus)
+            usage.queues += _treeNodeBytes + sizeof(pair) + pair.second.size() * (_treeNodeBytes + sizeof(int64_t));
+        return usage;
+    }
+
+#if WSWRAP_VERSION >= 10400
+    /// Bytes zlib and its buffers hold for permessage-deflate, counted by wswrap for all connections of the process
+    static size_t get_compression_memory_usage()
+    {
+        return wswrap::WS::compression_memory_usage();
+    }
+#endif
+
+    /// Estimated heap bytes of a json value's children (not counting sizeof(json) itself)
+    static size_t estimate_json_bytes(const json& j)
+    {
+        switch (j.type()) {
+            case json::value_t::object: {
+                size_t n = sizeof(json::object_t);
+                for (auto it = j.begin(); it != j.end(); ++it) {
+                    n += _treeNodeBytes + sizeof(json::object_t::value_type) + _string_bytes(it.key())
+                         + estimate_json_bytes(it.value());
+                }
+                return n;
+            }
+            case json::value_t::array: {
+                size_t n = sizeof(json::array_t) + j.get_ref<const json::array_t&>().capacity() * sizeof(json);
+                for (const auto& value: j)
+                    n += estimate_json_bytes(value);
+                return n;
+            }
+            case json::value_t::string:
+                return sizeof(json::string_t) + _string_bytes(j.get_ref<const json::string_t&>());
+            case json::value_t::binary:
+                return sizeof(json::binary_t) + j.get_binary().capacity();
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * Reconnect delays. After each failed attempt the delay doubles from minMs up to maxMs.
+     * jitter (0..1) is the part of each delay that is randomized, so clients don't retry in lockstep.
+     */
+    void set_reconnect_backoff(unsigned long minMs, unsigned long maxMs, double jitter = 0)
+    {
+        _reconnectMinInterval = minMs;
+        _reconnectMaxInterval = std::max(minMs, maxMs);
+        _reconnectJitter = std::min(std::max(jitter, 0.), 1.);
+        _reconnectBackoff = std::min(std::max(_reconnectBackoff, minMs), _reconnectMaxInterval);
+        if (_state < State::SOCKET_CONNECTED)
+            _socketReconnectInterval = std::min(std::max(_socketReconnectInterval, minMs), _reconnectMaxInterval);
+    }
+
+    /**
+     * Fast resync: for windowMs after losing a working connection, e.g. a server restart, retry every intervalMs
+     * (jittered) instead of backing off. A hanging attempt is still given the minimum backoff delay to finish.
+     * 0 disables.
+     */
+    void set_fast_reconnect(unsigned long intervalMs, unsigned long windowMs)
+    {
+        _fastReconnectInterval = intervalMs;
+        _fastReconnectWindow = windowMs;
+    }
+
+#if WSWRAP_VERSION >= 10400
+    /// permessage-deflate offer, used from the next (re)connect on
+    void set_compression_options(const wswrap::compression_options& options)
+    {
+        _compressionOptions = options;
+    }
+#endif
+
+    /**
+     * Enable or disable batching of outgoing commands.
+     * While enabled, commands are collected and sent as a single frame by flush(), which poll() calls at the end.
+     * Order of commands is preserved. Disabling flushes pending commands.
+     */
+    void set_batch_commands(bool enable)
+    {
+        _batchCommands = enable;
+        if (!enable)
+            flush();
+    }
+
+    bool get_batch_commands() const
+    {
+        return _batchCommands;
+    }
+
+    /// Number of commands waiting for the next flush()
+    size_t get_batch_size() const
+    {
+        return _outgoingBatch.size();
+    }
+
+    /**
+     * Send all commands batched since the last flush as one frame.
+     * Returns true if a frame was sent.
+     */
+    bool flush()
+    {
+        if (_outgoingBatch.empty())
+            return false;
+        if (!_ws) {
+            _drop_outgoing_batch();
+            return false;
+        }
+        debug("> flush " + std::to_string(_outgoingBatch.size()) + " commands");
+        json batch = json::array();
+        std::swap(batch, _outgoingBatch);
+        send_frame(batch.dump());
+        return true;
+    }
+
     const std::set<int64_t> get_checked_locations() const
     {
-        return _checkedLocations;
+        return _checkedLocations.to_set();
     }
 
     const std::set<int64_t> get_missing_locations() const
+    {
+        return _missingLocations.to_set();
+    }
+
+    /// Checked locations without a copy. The universe is all locations of the slot once connected.
+    const LocationSet& get_checked_location_set() const
+    {
+        return _checkedLocations;
+    }
+
+    /// Missing locations without a copy. The universe is all locations of the slot once connected.
+    const LocationSet& get_missing_location_set() const
     {
         return _missingLocations;
     }
 
-    const std::list<NetworkPlayer>& get_players() const
+    const std::vector<NetworkPlayer>& get_players() const
     {
         return _players;
     }
 
-    std::string get_player_alias(int slot)
+    const std::string& get_player_alias(int slot) const
     {
+        static const std::string SERVER_STRING = "Server";
+        static const std::string UNKNOWN_STRING = "Unknown";
+
         if (slot == 0)
-            return "Server";
+            return SERVER_STRING;
 
-        for (const auto& player: _players) {
-            if (player.team == _team && player.slot == slot) {
-                return player.alias;
-            }
-        }
+        const NetworkPlayer* player = find_player(_team, slot);
+        if (player)
+            return player->alias;
 
-        return "Unknown";
+        return UNKNOWN_STRING;
+    }
+
+    /// Get the player for team and slot or nullptr if unknown
+    const NetworkPlayer* find_player(int team, int slot) const
+    {
+        if (team < 0 || slot < 0 || (size_t)team >= _playerIndex.size())
+            return nullptr;
+        const auto& slots = _playerIndex[team];
+        if ((size_t)slot >= slots.size() || slots[slot] < 0)
+            return nullptr;
+        return &_players[slots[slot]];
     }
 
     const std::string& get_player_game(int player)
@@ -700,13 +1014,17 @@ public:
      */
     int64_t get_location_id(const std::string& name) const
     {
-        if (_dataPackage["games"].contains(_game)) {
-            for (const auto& pair: _dataPackage["games"][_game]["location_name_to_id"].items()) {
-                if (pair.key() == name)
-                    return pair.value().get<int64_t>();
-            }
-        }
-        return INVALID_NAME_ID;
+        return get_location_id(name, _game);
+    }
+
+    /**
+     * Return the id associated with the location name in game
+     * Return APClient::INVALID_NAME_ID when undefined
+     */
+    int64_t get_location_id(const std::string& name, const std::string& game,
+                            NameMatch match = NameMatch::EXACT) const
+    {
+        return find_name_id(_gameLocationIds, name, game, match);
     }
 
     std::string get_item_name(int64_t code, const std::string& game)
@@ -734,13 +1052,17 @@ public:
      */
     int64_t get_item_id(const std::string& name) const
     {
-        if (_dataPackage["games"].contains(_game)) {
-            for (const auto& pair: _dataPackage["games"][_game]["item_name_to_id"].items()) {
-                if (pair.key() == name)
-                    return pair.value().get<int64_t>();
-            }
-        }
-        return INVALID_NAME_ID;
+        return get_item_id(name, _game);
+    }
+
+    /**
+     * Return the id associated with the item name in game
+     * Return APClient::INVALID_NAME_ID when undefined
+     */
+    int64_t get_item_id(const std::string& name, const std::string& game,
+                        NameMatch match = NameMatch::EXACT) const
+    {
+        return find_name_id(_gameItemIds, name, game, match);
     }
 
     bool slot_concerns_self(int slot) const
@@ -823,7 +1145,7 @@ public:
             }};
 
             debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-            _ws->send(packet.dump());
+            send_packet(std::move(packet));
         } else {
             _checkQueue.insert(locations.begin(), locations.end());
         }
@@ -848,7 +1170,7 @@ public:
             }};
 
             debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-            _ws->send(packet.dump());
+            send_packet(std::move(packet));
         } else {
             _scoutQueues[create_as_hint].insert(locations.begin(), locations.end());
         }
@@ -870,7 +1192,7 @@ public:
             }};
 
             debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-            _ws->send(packet.dump());
+            send_packet(std::move(packet));
         } else {
             _updateHintQueue.emplace_back(player, location, status);
         }
@@ -900,7 +1222,7 @@ public:
             }
 
             debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-            _ws->send(packet.dump());
+            send_packet(std::move(packet));
         }
         else {
             _createHintsQueueByPlayerAndStatus[{target_player, hint_status}].insert(locations.begin(), locations.end());
@@ -919,7 +1241,7 @@ public:
             }};
 
             debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-            _ws->send(packet.dump());
+            send_packet(std::move(packet));
             return true;
         }
 
@@ -947,7 +1269,7 @@ public:
         }};
 
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -979,7 +1301,7 @@ public:
         if (send_tags) packet[0]["tags"] = tags;
 
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -993,7 +1315,7 @@ public:
         }};
 
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -1031,7 +1353,7 @@ public:
                 {"games", games}, // since 0.3.2
             }};
             debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-            _ws->send(packet.dump());
+            send_packet(std::move(packet));
             _pendingDataPackageRequests++;
             games.clear();
         }
@@ -1060,7 +1382,7 @@ public:
         if (dump.size() > maxDumpLen-3) dump = dump.substr(0, maxDumpLen-3) + "...";
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + dump);
 #endif
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -1074,7 +1396,7 @@ public:
             {"text", text},
         }};
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
 
         return true;
     }
@@ -1093,7 +1415,7 @@ public:
             packet[0].update(extras);
 
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -1115,7 +1437,7 @@ public:
             packet[0].update(extras);
 
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -1130,7 +1452,7 @@ public:
         }};
 
         debug("> " + packet[0]["cmd"].get<std::string>() + ": " + packet.dump());
-        _ws->send(packet.dump());
+        send_packet(std::move(packet));
         return true;
     }
 
@@ -1225,9 +1547,16 @@ public:
             _ws.reset();
         if (_ws)
             _ws->poll();
-        if (_state < State::SOCKET_CONNECTED) {
+#ifndef AP_NO_THREADS
+        _poll_data_package_loads();
+#endif
+        flush();
+        if (_state < State::SOCKET_CONNECTED && !_uri.empty()) {
             auto t = now();
-            if (t - _lastSocketConnect > _socketReconnectInterval || _reconnectNow) {
+            auto interval = _socketReconnectInterval;
+            if (_state == State::SOCKET_CONNECTING && interval < _reconnectMinInterval)
+                interval = _reconnectMinInterval; // fast reconnect: let the attempt finish
+            if (t - _lastSocketConnect > interval || _reconnectNow) {
                 if (_state != State::DISCONNECTED)
                     log("Connect timed out. Retrying.");
                 else
@@ -1253,12 +1582,81 @@ public:
         _hintCostPercent = 0;
         _hintPoints = 0;
         _players.clear();
+        _playerIndex.clear();
+        _cancel_data_package_loads();
+        _outgoingBatch = json::array(); // _checkQueue is cleared above, nothing to keep
         _ws.reset();
         _state = State::DISCONNECTED;
         _hasPassword = false;
     }
 
+    /**
+     * Handle a frame as if it was received from the server, without going through the socket.
+     * For benchmarks and replaying recorded sessions. Handlers run on the calling thread.
+     */
+    void inject_message(std::string s)
+    {
+        onmessage(std::move(s));
+    }
+
 private:
+    /// Reports a phase to the profile hook when it goes out of scope, if there is a hook
+    class ProfileScope final {
+    public:
+        ProfileScope(APClient* client, ProfilePhase phase, const std::string& cmd = no_cmd())
+            : _client(client), _phase(phase), _cmd(cmd)
+        {
+            if (_client->_hOnProfile)
+                _start = std::chrono::steady_clock::now();
+        }
+
+        ~ProfileScope()
+        {
+            if (_client->_hOnProfile && _start != ProfileTime())
+                _client->_hOnProfile(_phase, _cmd, _start, std::chrono::steady_clock::now());
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+        static const std::string& no_cmd()
+        {
+            static const std::string empty;
+            return empty;
+        }
+
+    private:
+        APClient* _client;
+        ProfilePhase _phase;
+        const std::string& _cmd;
+        ProfileTime _start;
+    };
+
+    /// A cached game's data package as loaded at RoomInfo
+    struct DataPackageLoad {
+        std::string game;
+        std::string checksum;
+        int version = 0;
+        bool hasNames = false;
+        APDataPackageNames names;
+        bool hasData = false;
+        json data;
+    };
+
+#ifndef AP_NO_THREADS
+    struct DataPackageLoadBatch {
+        std::vector<DataPackageLoad> loads;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> cancel{false};
+        std::mutex mutex;
+        std::vector<size_t> done; // indices into loads, guarded by mutex
+        size_t applied = 0;
+        std::list<std::string> include;
+        std::vector<std::thread> threads;
+        std::atomic<size_t> running{0}; // threads that didn't return yet
+    };
+#endif
+
     void log(const char* msg)
     {
         printf("APClient: %s\n", msg);
@@ -1283,6 +1681,39 @@ private:
         debug(msg.c_str());
     }
 
+    /// Send packet (an array of commands) now, or move its commands to the outgoing batch
+    void send_packet(json&& packet)
+    {
+        if (!_batchCommands) {
+            send_frame(packet.dump());
+            return;
+        }
+        for (auto& command: packet)
+            _outgoingBatch.push_back(std::move(command));
+    }
+
+    /// Drop batched commands, except checks: those go back to _checkQueue and are sent after the next Connected
+    void _drop_outgoing_batch()
+    {
+        for (const auto& command: _outgoingBatch) {
+            auto itCmd = command.find("cmd");
+            auto itLocations = command.find("locations");
+            if (itCmd == command.end() || *itCmd != "LocationChecks" || itLocations == command.end())
+                continue;
+            for (const auto& location: *itLocations)
+                _checkQueue.insert(location.get<int64_t>());
+        }
+        _outgoingBatch = json::array();
+    }
+
+    void send_frame(const std::string& frame)
+    {
+        if (_hOnFrame)
+            _hOnFrame(true, frame);
+        if (_ws) // no socket when replaying injected frames
+            _ws->send(frame);
+    }
+
     void onopen()
     {
         debug("onopen()");
@@ -1290,8 +1721,20 @@ private:
         _state = State::SOCKET_CONNECTED;
         _pendingDataPackageRequests = 0;
         _serverVersion = _generatorVersion = Version{0, 0, 0};
+        _connectTimings.socket_open = std::chrono::steady_clock::now();
         if (_hOnSocketConnected) _hOnSocketConnected();
-        _socketReconnectInterval = 1500;
+        _socketReconnectInterval = _reconnectBackoff = _reconnectMinInterval;
+        _schemeFailures = 0;
+        _probingScheme = false;
+        if (_tryWSS) {
+            _schemeConfirmed = true;
+            if (!_schemeFile.empty()) {
+                std::string scheme = _uri.substr(0, _uri.find("://"));
+                std::string host = get_uri_host(_uri);
+                if (load_scheme(_schemeFile, host) != scheme && !save_scheme(_schemeFile, host, scheme))
+                    log("Could not write scheme file");
+            }
+        }
     }
 
     void onclose()
@@ -1299,30 +1742,78 @@ private:
         debug("onclose()");
         if (_state > State::SOCKET_CONNECTING) {
             log("Server disconnected");
+            _start_connect_timings();
+            _connectTimings.reconnects++;
+            _fastReconnectUntil = _fastReconnectWindow ? now() + _fastReconnectWindow : 0;
             _state = State::DISCONNECTED;
             if (_hOnSocketDisconnected) _hOnSocketDisconnected();
         }
         _state = State::DISCONNECTED;
         _seed = "";
+        _cancel_data_package_loads();
+        _drop_outgoing_batch(); // commands were meant for this connection
     }
 
     void onmessage(const std::string& s)
+    {
+        _frameTime = std::chrono::steady_clock::now();
+        if (_hOnFrame)
+            _hOnFrame(false, s);
+        json packet;
+        if (parse_packet(s, packet))
+            onpacket(packet);
+    }
+
+    /// Takes ownership of the frame and frees it once parsed, so it is not kept alive while handlers run
+    void onmessage(std::string&& s)
+    {
+        _frameTime = std::chrono::steady_clock::now();
+        if (_hOnFrame)
+            _hOnFrame(false, s);
+        json packet;
+        bool ok = parse_packet(s, packet);
+        std::string().swap(s);
+        if (ok)
+            onpacket(packet);
+    }
+
+    bool parse_packet(const std::string& s, json& packet)
     {
         try {
-            json packet = json::parse(s);
+            {
+                ProfileScope scope(this, ProfilePhase::PARSE);
+                packet = json::parse(s);
+            }
 #ifndef AP_NO_SCHEMA
+            ProfileScope scope(this, ProfilePhase::VALIDATE);
             valijson::Validator validator;
             JsonSchemaAdapter packetAdapter(packet);
             if (!validator.validate(_packetSchema, packetAdapter, nullptr)) {
                 throw std::runtime_error("Packet validation failed");
             }
+#endif
+            return true;
+        } catch (const std::exception& ex) {
+            log((std::string("onmessage() error: ") + ex.what()).c_str());
+            return false;
+        }
+    }
+
+    /// Dispatch a parsed packet. Commands are consumed: handlers get references into it, data may be moved out.
+    void onpacket(json& packet)
+    {
+        try {
+#ifndef AP_NO_SCHEMA
+            valijson::Validator validator;
 #endif
             for (auto& command: packet) {
                 std::string cmd = command["cmd"];
+                ProfileScope commandScope(this, ProfilePhase::COMMAND, cmd);
 #ifndef AP_NO_SCHEMA
                 JsonSchemaAdapter commandAdapter(command);
                 auto schemaIt = _commandSchemas.find(cmd);
                 if (schemaIt != _commandSchemas.end()) {
+                    ProfileScope validateScope(this, ProfilePhase::VALIDATE, cmd);
                     if (!validator.validate(schemaIt->second, commandAdapter, nullptr)) {
                         throw std::runtime_error("Command validation failed");
                     }
@@ -1343,13 +1834,12 @@ private:
                     _hintCostPercent = command.value("hint_cost", 0);
                     _hasPassword = command.value("password", false);
                     if (_state < State::ROOM_INFO) _state = State::ROOM_INFO;
+                    _connectTimings.room_info = std::chrono::steady_clock::now();
                     if (_hOnRoomInfo) _hOnRoomInfo();
 
                     // check if cached data package is already valid
                     // if not, build a list to query
                     _dataPackageValid = true;
-                    std::list<std::string> exclude;
-                    std::list<std::string> include;
                     std::set<std::string> playedGames;
                     auto itGames = command.find("games");
                     if (itGames != command.end() && itGames->is_array()) {
@@ -1371,70 +1861,42 @@ private:
                     auto itChecksums = command.find("datapackage_checksums");
                     if (itChecksums != command.end() && !itChecksums->is_object()) itChecksums = command.end();
 
-                    if (itVersions != command.end() && !playedGames.empty()) {
-                        // pre 0.3.2: exclude games that exist but are not being played
-                        for (auto itV: command["datapackage_versions"].items()) {
-                            if (!playedGames.count(itV.key())) {
-                                exclude.push_back(itV.key());
-                            }
-                        }
-                    }
-
+                    std::vector<DataPackageLoad> loads;
                     for (const auto& game: playedGames) {
-                        std::string remoteChecksum;
-                        int remoteVersion = 0;
+                        DataPackageLoad load;
+                        load.game = game;
                         if (itChecksums != command.end()) {
                             auto itChecksum = itChecksums->find(game);
                             if (itChecksum != itChecksums->end() && itChecksum->is_string())
-                                remoteChecksum = *itChecksum;
+                                load.checksum = *itChecksum;
                         }
                         if (itVersions != command.end()) {
                             auto itVersion = itVersions->find(game);
                             if (itVersion != itVersions->end() && itVersion->is_number_integer())
-                                remoteVersion = *itVersion;
+                                load.version = *itVersion;
                         }
-                        json localData;
-                        if (!_dataPackageStore || !_dataPackageStore->load(game, remoteChecksum, localData)) {
-                            if (remoteChecksum.empty() && remoteVersion != 0) {
-                                auto itOld = _dataPackage["games"].find(game);
-                                if (itOld != _dataPackage["games"].end()) {
-                                    // exists in migrated cache
-                                    auto itOldVersion = itOld->find("version");
-                                    if (itOldVersion != itOld->end() && *itOldVersion == remoteVersion) {
-                                        // and is recent
-                                        exclude.push_back(game);
-                                        continue;
-                                    }
-                                }
-                            }
-                            include.push_back(game);
+                        loads.push_back(std::move(load));
+                    }
+
+                    _cancel_data_package_loads();
+#ifndef AP_NO_THREADS
+                    if (_dataPackageLoadThreads > 0 && !loads.empty()) {
+                        // load and index cached games in the background, see _poll_data_package_loads()
+                        _dataPackageValid = false;
+                        _start_data_package_loads(std::move(loads));
+                        continue;
+                    }
+#endif
+                    std::list<std::string> include;
+                    for (auto& load: loads) {
+                        _load_cached_data_package(_dataPackageStore, load);
+                        if (!_apply_cached_data_package(load)) {
+                            include.push_back(load.game);
                             _dataPackageValid = false;
-                        } else if (!remoteChecksum.empty()) {
-                            // compare checksum
-                            auto it = localData.find("checksum");
-                            if (it != localData.end() && it->is_string() && *it == remoteChecksum) {
-                                _dataPackage["games"][game] = localData;
-                                exclude.push_back(game);
-                            } else {
-                                include.push_back(game);
-                                _dataPackageValid = false;
-                            }
-                        } else {
-                            const auto it = localData.find("version");
-                            if (remoteVersion != 0 && it != localData.end() && it->is_number_integer() && *it == remoteVersion) {
-                                _dataPackage["games"][game] = localData;
-                                exclude.push_back(game);
-                            } else {
-                                include.push_back(game);
-                                _dataPackageValid = false;
-                            }
                         }
                     }
-
-                    if (!exclude.empty())
-                        _set_data_package(_dataPackage);  // apply loaded strings
                     if (!_dataPackageValid) GetDataPackage(include);
-                    else debug("Data package up to date");
+                    else _data_package_ready();
                 }
                 else if (cmd == "ConnectionRefused") {
                     if (_hOnSlotRefused) {
@@ -1447,21 +1909,26 @@ private:
                 else if (cmd == "Connected") {
                     // store data
                     _state = State::SLOT_CONNECTED;
+                    _connectTimings.connected = std::chrono::steady_clock::now();
                     _team = command["team"];
                     _slotnr = command["slot"];
                     _hintPoints = command.value("hint_points", command["checked_locations"].size());
                     _locationCount = command["missing_locations"].size() + command["checked_locations"].size();
-                    _players.clear();
-                    for (auto& player: command["players"]) {
-                        _players.push_back({
-                            player["team"].get<int>(),
-                            player["slot"].get<int>(),
-                            player["alias"].get<std::string>(),
-                            player["name"].get<std::string>(),
-                        });
+                    _update_players(command["players"]);
+                    {
+                        auto checked = command.value<std::vector<int64_t>>("checked_locations", {});
+                        auto missing = command.value<std::vector<int64_t>>("missing_locations", {});
+                        std::vector<int64_t> universe = checked;
+                        universe.insert(universe.end(), missing.begin(), missing.end());
+                        _checkedLocations.clear();
+                        _checkedLocations.set_universe(universe);
+                        for (int64_t location: checked)
+                            _checkedLocations.insert(location);
+                        _missingLocations.clear();
+                        _missingLocations.set_universe(std::move(universe));
+                        for (int64_t location: missing)
+                            _missingLocations.insert(location);
                     }
-                    _checkedLocations = command.value<std::set<int64_t>>("checked_locations", {});
-                    _missingLocations = command.value<std::set<int64_t>>("missing_locations", {});
                     // send queued checks if any - this makes sure checked/missing is up to date
                     if (!_checkQueue.empty()) {
                         std::list<int64_t> queuedChecks;
@@ -1527,6 +1994,9 @@ private:
                     }
                 }
                 else if (cmd == "ReceivedItems") {
+                    if (_connectTimings.items_synced == ConnectTimings::time_point()
+                            && _connectTimings.connected != ConnectTimings::time_point())
+                        _connectTimings.items_synced = std::chrono::steady_clock::now();
                     std::list<NetworkItem> items;
                     int index = command["index"].get<int>();
                     for (const auto& j: command["items"]) {
@@ -1557,7 +2027,7 @@ private:
                     std::list<int64_t> checkedLocations;
                     for (const auto& j: command["checked_locations"]) {
                         int64_t location = j.get<int64_t>();
-                        if (_checkedLocations.emplace(location).second) {
+                        if (_checkedLocations.insert(location)) {
                             checkedLocations.push_back(location);
                             _missingLocations.erase(location);
                         }
@@ -1567,37 +2037,31 @@ private:
                     if (command["hint_points"].is_number_integer())
                         _hintPoints = command["hint_points"];
                     if (command["players"].is_array()) {
-                        _players.clear();
-                        for (auto& player: command["players"]) {
-                            _players.push_back({
-                                player["team"].get<int>(),
-                                player["slot"].get<int>(),
-                                player["alias"].get<std::string>(),
-                                player["name"].get<std::string>(),
-                            });
-                        }
+                        _update_players(command["players"]);
                     }
                     if (_hOnRoomUpdate)
                         _hOnRoomUpdate();
                 }
                 else if (cmd == "DataPackage") {
-                    auto data = _dataPackage;
-                    if (!data["games"].is_object())
-                        data["games"] = json(json::value_t::object);
+                    // the packet is ours: move games into _dataPackage instead of copying, index only new games
+                    json& games = _dataPackage["games"];
+                    if (!games.is_object())
+                        games = json(json::value_t::object);
                     for (auto gamepair: command["data"]["games"].items()) {
+                        ProfileScope gameScope(this, ProfilePhase::DATA_PACKAGE, gamepair.key());
                         if (_dataPackageStore)
                             _dataPackageStore->save(gamepair.key(), gamepair.value());
-                        data["games"][gamepair.key()] = gamepair.value();
+                        json& gamedata = games[gamepair.key()];
+                        gamedata = std::move(gamepair.value());
+                        _index_game(gamepair.key(), gamedata);
                     }
-                    data["version"] = command["data"].value<int>("version", -1); // -1 for backwards compatibility
+                    _dataPackage["version"] = command["data"].value<int>("version", -1); // -1 for backwards compatibility
                     _dataPackageValid = false;
-                    _set_data_package(data);
                     if (_pendingDataPackageRequests > 0) {
                         _pendingDataPackageRequests--;
-                        if (_pendingDataPackageRequests == 0) {
-                            _dataPackageValid = true;
-                            if (_hOnDataPackageChanged) _hOnDataPackageChanged(_dataPackage);
-                        }
+                        // cached games still loading: _poll_data_package_loads() marks it ready
+                        if (_pendingDataPackageRequests == 0 && !_data_package_loading())
+                            _data_package_ready();
                     }
                 }
                 else if (cmd == "Print") {
@@ -1615,6 +2079,12 @@ private:
                         for (auto& pair: command["keys"].items())
                             keys[pair.key()] = pair.value();
                         _hOnRetrieved(keys, command);
+                    } else if (_hOnRetrievedKeys) {
+                        // handler does not see the message, so take the values from it
+                        std::map<std::string, json> keys;
+                        for (auto& pair: command["keys"].items())
+                            keys.emplace(pair.key(), std::move(pair.value()));
+                        _hOnRetrievedKeys(keys);
                     }
                 }
                 else if (cmd == "SetReply") {
@@ -1638,6 +2108,15 @@ private:
         if (_hOnSocketError) _hOnSocketError(msg);
         // TODO: on desktop, we could check if the error was handle_read_http_response before switching to wss://
         //       and handle_transport_init before switching to ws://
+        // once a scheme worked, errors are most likely the server restarting, so only probe the other one sometimes
+        if (_schemeConfirmed) {
+            if (_probingScheme)
+                _probingScheme = false; // switch back
+            else if (++_schemeFailures % SCHEME_PROBE_INTERVAL != 0)
+                return;
+            else
+                _probingScheme = true;
+        }
         if (_tryWSS && _uri.rfind("ws://", 0) == 0) {
             _uri = "wss://" + _uri.substr(5);
             if (_state == State::SOCKET_CONNECTING)
@@ -1647,9 +2126,55 @@ private:
         }
     }
 
+    /// host:port part of a ws:// or wss:// uri
+    static std::string get_uri_host(const std::string& uri)
+    {
+        auto p = uri.find("://");
+        if (p == uri.npos)
+            return uri;
+        return uri.substr(p + 3, uri.find('/', p + 3) - (p + 3));
+    }
+
+    /// Scheme file: one "host:port scheme" per line
+    static std::string load_scheme(const std::string& file, const std::string& host)
+    {
+        std::ifstream f(file);
+        std::string key, scheme;
+        while (f >> key >> scheme) {
+            if (key == host)
+                return scheme;
+        }
+        return "";
+    }
+
+    static bool save_scheme(const std::string& file, const std::string& host, const std::string& scheme)
+    {
+        std::string out;
+        {
+            std::ifstream f(file);
+            std::string key, value;
+            while (f >> key >> value) {
+                if (key != host)
+                    out += key + " " + value + "\n";
+            }
+        }
+        out += host + " " + scheme + "\n";
+        std::string tmp = file + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!(f << out))
+                return false;
+        }
+        if (rename(tmp.c_str(), file.c_str()) == 0)
+            return true;
+        remove(file.c_str()); // windows does not replace on rename
+        return rename(tmp.c_str(), file.c_str()) == 0;
+    }
+
     void connect_socket()
     {
         _reconnectNow = false;
+        _drop_outgoing_batch();
         _ws.reset();
         if (_uri.empty()) {
             _ws = nullptr;
@@ -1670,8 +2195,14 @@ private:
 #endif
 #if WSWRAP_VERSION >= 10100
                     , _certStore
+#endif
+#if WSWRAP_VERSION >= 10400
+                    , _compressionOptions
 #endif
             ));
+#if WSWRAP_VERSION >= 10400
+            _ws->set_message_move_handler([this](std::string&& s) { onmessage(std::move(s)); });
+#endif
         } catch (const std::exception& ex) {
             _ws = nullptr;
             if (_tryWSS && _uri.rfind("ws://", 0) == 0) {
@@ -1682,36 +2213,411 @@ private:
             log((std::string("error connecting: ") + ex.what()).c_str());
         }
         _lastSocketConnect = now();
-        _socketReconnectInterval *= 2;
+        if (_connectTimings.started == ConnectTimings::time_point())
+            _start_connect_timings();
+        _connectTimings.attempts++;
         // NOTE: browsers have a very badly implemented connection rate limit
         // alternatively we could always wait for onclose() to get the actual
         // allowed rate once we are over it
-        unsigned long maxReconnectInterval = std::max(15000UL, _ws ? _ws->get_ok_connect_interval() : 0);
-        if (_socketReconnectInterval > maxReconnectInterval)
-            _socketReconnectInterval = maxReconnectInterval;
+        unsigned long okConnectInterval = _ws ? _ws->get_ok_connect_interval() : 0;
+        if (_fastReconnectUntil && (long)(_fastReconnectUntil - _lastSocketConnect) > 0) {
+            _socketReconnectInterval = std::max(_jittered(_fastReconnectInterval), okConnectInterval);
+        } else {
+            _fastReconnectUntil = 0;
+            unsigned long maxReconnectInterval = std::max(_reconnectMaxInterval, okConnectInterval);
+            _reconnectBackoff = std::min(_reconnectBackoff * 2, maxReconnectInterval);
+            _socketReconnectInterval = _jittered(_reconnectBackoff);
+        }
+    }
+
+    unsigned long _jittered(unsigned long ms)
+    {
+        if (_reconnectJitter <= 0)
+            return ms;
+        std::uniform_real_distribution<double> dist(0, _reconnectJitter);
+        return (unsigned long)((double)ms * (1 - dist(_rng)));
     }
 
-    void _set_data_package(const json& data)
+    void _start_connect_timings()
     {
-        _dataPackage = data;
-        for (auto gamepair: _dataPackage["games"].items()) {
-            const auto& gamedata = gamepair.value();
-            _dataPackage["games"][gamepair.key()] = gamedata;
-            auto& gameItems = _gameItems[gamepair.key()];
-            for (auto pair: gamedata["item_name_to_id"].items()) {
+        unsigned reconnects = _connectTimings.reconnects;
+        _connectTimings = ConnectTimings();
+        _connectTimings.reconnects = reconnects;
+        _connectTimings.started = std::chrono::steady_clock::now();
+    }
+
+    /// The only place the data package changed callback fires, whichever way the games came in
+    void _data_package_ready()
+    {
+        _dataPackageValid = true;
+        _connectTimings.data_package_ready = std::chrono::steady_clock::now();
+        debug("Data package up to date");
+        if (_hOnDataPackageChanged) _hOnDataPackageChanged(_dataPackage);
+    }
+
+    /// Patch the player table in place. Usually only aliases change, which reuses the existing strings' storage.
+    void _update_players(const json& players)
+    {
+        bool rebuildIndex = players.size() != _players.size();
+        _players.resize(players.size());
+        size_t n = 0;
+        for (const auto& player: players) {
+            auto& entry = _players[n++];
+            int team = player["team"].get<int>();
+            int slot = player["slot"].get<int>();
+            if (entry.team != team || entry.slot != slot) {
+                entry.team = team;
+                entry.slot = slot;
+                rebuildIndex = true;
+            }
+            const auto& alias = player["alias"].get_ref<const std::string&>();
+            if (entry.alias != alias)
+                entry.alias = alias;
+            const auto& name = player["name"].get_ref<const std::string&>();
+            if (entry.name != name)
+                entry.name = name;
+        }
+        if (!rebuildIndex)
+            return;
+
+        for (auto& slots: _playerIndex)
+            std::fill(slots.begin(), slots.end(), -1);
+        for (size_t i = 0; i < _players.size(); i++) {
+            const auto& entry = _players[i];
+            if (entry.team < 0 || entry.slot < 0)
+                continue;
+            if ((size_t)entry.team >= _playerIndex.size())
+                _playerIndex.resize(entry.team + 1);
+            auto& slots = _playerIndex[entry.team];
+            if ((size_t)entry.slot >= slots.size())
+                slots.resize(entry.slot + 1, -1);
+            slots[entry.slot] = (int)i;
+        }
+    }
+
+    void _index_game(const std::string& game, const json& gamedata)
+    {
+        auto& gameItems = _gameItems[game];
+        auto& itemIds = _gameItemIds[game];
+        itemIds = NameIndex();
+        auto itItems = gamedata.find("item_name_to_id");
+        if (itItems != gamedata.end() && itItems->is_object()) {
+            itemIds.reserve(itItems->size());
+            for (const auto& pair: itItems->items()) {
                 auto id = pair.value().get<int64_t>();
                 _items[id] = pair.key();
                 gameItems[id] = pair.key();
+                itemIds.add(pair.key(), id);
             }
-            auto& gameLocations = _gameLocations[gamepair.key()];
-            for (auto pair: gamedata["location_name_to_id"].items()) {
+        }
+        auto& gameLocations = _gameLocations[game];
+        auto& locationIds = _gameLocationIds[game];
+        locationIds = NameIndex();
+        auto itLocations = gamedata.find("location_name_to_id");
+        if (itLocations != gamedata.end() && itLocations->is_object()) {
+            locationIds.reserve(itLocations->size());
+            for (const auto& pair: itLocations->items()) {
                 auto id = pair.value().get<int64_t>();
                 _locations[id] = pair.key();
                 gameLocations[id] = pair.key();
+                locationIds.add(pair.key(), id);
             }
         }
     }
 
+    void _index_game(const std::string& game, const APDataPackageNames& names)
+    {
+        auto& gameItems = _gameItems[game];
+        auto& itemIds = _gameItemIds[game];
+        itemIds = NameIndex();
+        itemIds.reserve(names.items.size());
+        for (const auto& pair: names.items) {
+            _items[pair.first] = pair.second;
+            gameItems.emplace_hint(gameItems.end(), pair.first, pair.second)->second = pair.second;
+            itemIds.add(pair.second, pair.first);
+        }
+        auto& gameLocations = _gameLocations[game];
+        auto& locationIds = _gameLocationIds[game];
+        locationIds = NameIndex();
+        locationIds.reserve(names.locations.size());
+        for (const auto& pair: names.locations) {
+            _locations[pair.first] = pair.second;
+            gameLocations.emplace_hint(gameLocations.end(), pair.first, pair.second)->second = pair.second;
+            locationIds.add(pair.second, pair.first);
+        }
+    }
+
+    /// Fill load from the cache. Only touches load and store, so this can run on a worker thread.
+    static void _load_cached_data_package(APDataPackageStore* store, DataPackageLoad& load)
+    {
+        if (!store)
+            return;
+        if (!load.checksum.empty() && store->load_names(load.game, load.checksum, load.names)
+                && load.names.checksum == load.checksum) {
+            load.hasNames = true;
+            load.data = _names_to_json(load.names);
+            return;
+        }
+        load.hasData = store->load(load.game, load.checksum, load.data);
+    }
+
+    /// The part of a game's data package that name tables carry
+    static json _names_to_json(const APDataPackageNames& names)
+    {
+        json gamedata = {
+            {"checksum", names.checksum},
+            {"item_name_to_id", json::object()},
+            {"location_name_to_id", json::object()},
+        };
+        json& items = gamedata["item_name_to_id"];
+        for (const auto& pair: names.items)
+            items[pair.second] = pair.first;
+        json& locations = gamedata["location_name_to_id"];
+        for (const auto& pair: names.locations)
+            locations[pair.second] = pair.first;
+        return gamedata;
+    }
+
+    /// Index a cached data package if it matches what the server announced. Returns false if it has to be fetched.
+    bool _apply_cached_data_package(DataPackageLoad& load)
+    {
+        ProfileScope scope(this, ProfilePhase::DATA_PACKAGE, load.game);
+        if (load.hasNames) {
+            _index_game(load.game, load.names);
+            _dataPackage["games"][load.game] = std::move(load.data);
+            return true;
+        }
+        if (!load.hasData) {
+            if (load.checksum.empty() && load.version != 0) {
+                auto itOld = _dataPackage["games"].find(load.game);
+                if (itOld != _dataPackage["games"].end()) {
+                    // exists in migrated cache
+                    auto itOldVersion = itOld->find("version");
+                    if (itOldVersion != itOld->end() && *itOldVersion == load.version) {
+                        // and is recent
+                        _index_game(load.game, *itOld);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        if (!load.checksum.empty()) {
+            // compare checksum
+            auto it = load.data.find("checksum");
+            if (it == load.data.end() || !it->is_string() || *it != load.checksum)
+                return false;
+        } else {
+            const auto it = load.data.find("version");
+            if (load.version == 0 || it == load.data.end() || !it->is_number_integer() || *it != load.version)
+                return false;
+        }
+        auto& gamedata = _dataPackage["games"][load.game];
+        gamedata = std::move(load.data);
+        _index_game(load.game, gamedata);
+        return true;
+    }
+
+#ifndef AP_NO_THREADS
+    void _start_data_package_loads(std::vector<DataPackageLoad>&& loads)
+    {
+        _dataPackageLoads.reset(new DataPackageLoadBatch());
+        _dataPackageLoads->loads = std::move(loads);
+        size_t threads = std::min((size_t)_dataPackageLoadThreads, _dataPackageLoads->loads.size());
+        APDataPackageStore* store = _dataPackageStore;
+        DataPackageLoadBatch* batch = _dataPackageLoads.get();
+        batch->running = threads;
+        for (size_t i = 0; i < threads; i++) {
+            batch->threads.emplace_back([store, batch]() {
+                while (!batch->cancel) {
+                    size_t n = batch->next++;
+                    if (n >= batch->loads.size())
+                        break;
+                    _load_cached_data_package(store, batch->loads[n]);
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    batch->done.push_back(n);
+                }
+                batch->running--;
+            });
+        }
+    }
+
+    static void _join_data_package_loads(DataPackageLoadBatch& batch)
+    {
+        for (auto& thread: batch.threads)
+            thread.join();
+        batch.threads.clear();
+    }
+
+    /// Join cancelled batches whose threads are done, so that never waits on a disk read
+    void _reap_data_package_loads()
+    {
+        auto it = _retiredDataPackageLoads.begin();
+        while (it != _retiredDataPackageLoads.end()) {
+            if ((*it)->running == 0) {
+                _join_data_package_loads(**it);
+                it = _retiredDataPackageLoads.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Apply finished background loads, then request whatever is missing once all games are done
+    void _poll_data_package_loads()
+    {
+        if (!_retiredDataPackageLoads.empty())
+            _reap_data_package_loads();
+        if (!_dataPackageLoads)
+            return;
+        auto& batch = *_dataPackageLoads;
+        std::vector<size_t> done;
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            done.swap(batch.done);
+        }
+        for (size_t n: done) {
+            auto& load = batch.loads[n];
+            if (!_apply_cached_data_package(load))
+                batch.include.push_back(load.game);
+            load = DataPackageLoad(); // release memory early
+            batch.applied++;
+        }
+        if (batch.applied < batch.loads.size())
+            return;
+
+        auto include = std::move(batch.include);
+        _join_data_package_loads(batch); // every game was applied: the threads are returning
+        _dataPackageLoads.reset();
+        if (!include.empty()) {
+            GetDataPackage(include); // the DataPackage reply reports the whole package
+        } else if (_pendingDataPackageRequests == 0) {
+            _data_package_ready();
+        }
+    }
+#endif
+
+    bool _data_package_loading() const
+    {
+#ifndef AP_NO_THREADS
+        return !!_dataPackageLoads;
+#else
+        return false;
+#endif
+    }
+
+    /// Stop a batch between two games without waiting for the one being read; poll() joins it later
+    void _cancel_data_package_loads()
+    {
+#ifndef AP_NO_THREADS
+        if (!_dataPackageLoads)
+            return;
+        _dataPackageLoads->cancel = true;
+        _retiredDataPackageLoads.push_back(std::move(_dataPackageLoads));
+#endif
+    }
+
+    /// Lower-case ASCII letters; other bytes (incl. UTF-8 sequences) are kept as-is
+    static std::string fold_name(const std::string& name)
+    {
+        std::string res = name;
+        for (auto& c: res) {
+            if (c >= 'A' && c <= 'Z')
+                c = (char)(c - 'A' + 'a');
+        }
+        return res;
+    }
+
+    /// Fold case and drop ASCII whitespace and punctuation, so "HM01 Cut" and "hm01-cut" compare equal
+    static std::string normalize_name(const std::string& name)
+    {
+        std::string res;
+        res.reserve(name.size());
+        for (char c: name) {
+            if (c >= 'A' && c <= 'Z')
+                res += (char)(c - 'A' + 'a');
+            else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (unsigned char)c >= 0x80)
+                res += c;
+        }
+        return res;
+    }
+
+    /// rb-tree node header of std::map/std::set, for memory estimates
+    static constexpr size_t _treeNodeBytes = 4 * sizeof(void*);
+
+    /// Heap buffer of a string, 0 if it fits the small string buffer
+    static size_t _string_bytes(const std::string& s)
+    {
+        return s.capacity() > 15 ? s.capacity() + 1 : 0;
+    }
+
+    static size_t _id_map_bytes(const std::map<int64_t, std::string>& map)
+    {
+        size_t n = map.size() * (_treeNodeBytes + sizeof(std::pair<const int64_t, std::string>));
+        for (const auto& pair: map)
+            n += _string_bytes(pair.second);
+        return n;
+    }
+
+    struct NameIndex;
+
+    static size_t _name_index_bytes(const NameIndex& index)
+    {
+        size_t n = 0;
+        for (const auto* map: {&index.exact, &index.folded, &index.normalized}) {
+            // buckets, then nodes with a next pointer and the cached hash
+            n += map->bucket_count() * sizeof(void*)
+                 + map->size() * (2 * sizeof(void*) + sizeof(std::pair<const std::string, int64_t>));
+            for (const auto& pair: *map)
+                n += _string_bytes(pair.first);
+        }
+        return n;
+    }
+
+    struct NameIndex {
+        std::unordered_map<std::string, int64_t> exact;
+        std::unordered_map<std::string, int64_t> folded;     // first name wins on collision
+        std::unordered_map<std::string, int64_t> normalized; // first name wins on collision
+
+        void reserve(size_t n)
+        {
+            exact.reserve(n);
+            folded.reserve(n);
+            normalized.reserve(n);
+        }
+
+        void add(const std::string& name, int64_t id)
+        {
+            exact[name] = id;
+            folded.emplace(fold_name(name), id);
+            normalized.emplace(normalize_name(name), id);
+        }
+    };
+
+    static int64_t find_name_id(const std::map<std::string, NameIndex>& indices, const std::string& name,
+                                const std::string& game, NameMatch match)
+    {
+        auto gameIt = indices.find(game);
+        if (gameIt == indices.end())
+            return INVALID_NAME_ID;
+        const auto& index = gameIt->second;
+        std::unordered_map<std::string, int64_t>::const_iterator it;
+        if (match == NameMatch::EXACT) {
+            it = index.exact.find(name);
+            if (it != index.exact.end())
+                return it->second;
+        } else if (match == NameMatch::CASE_INSENSITIVE) {
+            it = index.folded.find(fold_name(name));
+            if (it != index.folded.end())
+                return it->second;
+        } else {
+            it = index.normalized.find(normalize_name(name));
+            if (it != index.normalized.end())
+                return it->second;
+        }
+        return INVALID_NAME_ID;
+    }
+
     std::string color2ansi(const std::string& color)
     {
         // convert color to ansi color command
@@ -1752,9 +2658,19 @@ private:
     std::string _game;
     std::string _uuid;
     std::string _certStore;
+#if WSWRAP_VERSION >= 10400
+    wswrap::compression_options _compressionOptions;
+#endif
     std::unique_ptr<WS> _ws;
+    bool _batchCommands = false;
+    json _outgoingBatch = json::array(); // commands waiting for flush()
     State _state = State::DISCONNECTED;
     bool _tryWSS = false;
+    static constexpr unsigned SCHEME_PROBE_INTERVAL = 4; // failed attempts per probe of the other scheme
+    bool _schemeConfirmed = false; // a connection with the current scheme succeeded
+    unsigned _schemeFailures = 0;
+    bool _probingScheme = false;
+    std::string _schemeFile;
 
     std::function<void(void)> _hOnSocketConnected = nullptr;
     std::function<void(const std::string&)> _hOnSocketError = nullptr;
@@ -1772,10 +2688,23 @@ private:
     std::function<void(const json&)> _hOnBounced = nullptr;
     std::function<void(const std::list<int64_t>&)> _hOnLocationChecked = nullptr;
     std::function<void(const std::map<std::string, json>&, const json&)> _hOnRetrieved = nullptr;
+    std::function<void(const std::map<std::string, json>&)> _hOnRetrievedKeys = nullptr;
     std::function<void(const json&)> _hOnSetReply = nullptr;
+    std::function<void(bool, const std::string&)> _hOnFrame = nullptr;
+    std::function<void(ProfilePhase, const std::string&, ProfileTime, ProfileTime)> _hOnProfile = nullptr;
+    ProfileTime _frameTime;
 
     unsigned long _lastSocketConnect;
     unsigned long _socketReconnectInterval = 1500;
+    unsigned long _reconnectMinInterval = 1500;
+    unsigned long _reconnectMaxInterval = 15000;
+    unsigned long _reconnectBackoff = 1500; // delay before jitter
+    double _reconnectJitter = 0;
+    unsigned long _fastReconnectInterval = 0;
+    unsigned long _fastReconnectWindow = 0;
+    unsigned long _fastReconnectUntil = 0; // now() until which to reconnect fast, 0 if not
+    std::minstd_rand _rng{(std::minstd_rand::result_type)std::chrono::steady_clock::now().time_since_epoch().count()};
+    ConnectTimings _connectTimings;
     bool _reconnectNow = false;
     std::set<int64_t> _checkQueue;
     std::map<int, std::set<int64_t>> _scoutQueues;
@@ -1787,11 +2716,14 @@ private:
     bool _hasPassword = false;
     int _team = -1;
     int _slotnr = -1;
-    std::list<NetworkPlayer> _players;
+    std::vector<NetworkPlayer> _players;
+    std::vector<std::vector<int>> _playerIndex; // [team][slot] -> index into _players or -1
     std::map<int64_t, std::string> _locations;
     std::map<int64_t, std::string> _items;
     std::map<std::string, std::map<int64_t, std::string>> _gameLocations;
     std::map<std::string, std::map<int64_t, std::string>> _gameItems;
+    std::map<std::string, NameIndex> _gameLocationIds;
+    std::map<std::string, NameIndex> _gameItemIds;
     bool _dataPackageValid = false;
     size_t _pendingDataPackageRequests = 0;
     json _dataPackage;
@@ -1803,13 +2735,18 @@ private:
     int _hintCostPercent = 0;
     int _hintPoints = 0;
     bool _receiveOwnLocations = false;
-    std::set<int64_t> _checkedLocations;
-    std::set<int64_t> _missingLocations;
+    LocationSet _checkedLocations;
+    LocationSet _missingLocations;
     APDataPackageStore* _dataPackageStore;
 #ifndef AP_NO_DEFAULT_DATA_PACKAGE_STORE
     std::unique_ptr<APDataPackageStore> _autoDataPackageStore;
 #endif
     std::map<int, NetworkSlot> _slotInfo;
+    unsigned _dataPackageLoadThreads = 0;
+#ifndef AP_NO_THREADS
+    std::unique_ptr<DataPackageLoadBatch> _dataPackageLoads;
+    std::list<std::unique_ptr<DataPackageLoadBatch>> _retiredDataPackageLoads; // cancelled, threads not joined yet
+#endif
 
 #ifndef AP_NO_SCHEMA
     const json _packetSchemaJson = R"({
@@ -0,0 +1,305 @@
+#ifndef _COMPILEDDATAPACKAGESTORE_HPP
+#define _COMPILEDDATAPACKAGESTORE_HPP
+
+#include "defaultdatapackagestore.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#if !defined WIN32 && !defined _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * Data package store that keeps a compiled binary copy of each checksum'd data package next to the json file.
+ *
+ * The json file stays the source of truth. The binary `<checksum>.apdp` is written on `save()` and rebuilt by
+ * `load_names()` when it is missing or does not match the json anymore. `load_names()` memory-maps the binary and
+ * copies its id-sorted tables out for APClient: no json is parsed on start, but every name is still copied once
+ * (the mapping is closed before returning).
+ *
+ * File layout (native byte order, a file from a different architecture fails the format check and is rebuilt):
+ *   FileHeader, FileEntry items[itemCount], FileEntry locations[locationCount], char pool[poolSize]
+ * The checksum is stored at the start of the string pool.
+ */
+class CompiledDataPackageStore : public DefaultDataPackageStore
+{
+public:
+    CompiledDataPackageStore(const std::string fallbackPath = "")
+        : DefaultDataPackageStore(fallbackPath)
+    {
+    }
+
+    virtual bool save(const std::string& game, const json& data) override
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mutex); // evict() waits for the .apdp too
+        if (!DefaultDataPackageStore::save(game, data))
+            return false;
+        auto it = data.find("checksum");
+        if (it != data.end() && it->is_string() && !compile(game, *it, data))
+            log("Could not write compiled datapackage");
+        return true; // json was saved, which is what matters
+    }
+
+    virtual bool load_names(const std::string& game, const std::string& checksum, APDataPackageNames& names) override
+    {
+        auto jsonPath = get_path(game, checksum);
+        auto binPath = get_path(game, checksum, compiled_ext());
+        uint64_t jsonSize = 0;
+        if (checksum.empty() || jsonPath.empty() || binPath.empty() || !get_file_size(jsonPath, jsonSize))
+            return false;
+
+        uint64_t binSize = 0;
+        if (read_compiled(binPath, checksum, jsonSize, names, binSize)) {
+            count_hit(binSize);
+            touch(jsonPath); // update file times to keep them in cache
+            touch(binPath);
+            return true;
+        }
+
+        // missing or stale: rebuild from json
+        json data;
+        if (!DefaultDataPackageStore::load(game, checksum, data))
+            return false;
+        names_from_json(data, names);
+        if (names.checksum != checksum)
+            return false;
+        if (!compile(game, checksum, data))
+            log("Could not write compiled datapackage");
+        return true;
+    }
+
+    static const char* compiled_ext()
+    {
+        return ".apdp";
+    }
+
+protected:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    struct FileHeader {
+        char magic[4];         // "APDP"
+        uint32_t format;       // FORMAT_VERSION
+        uint64_t jsonSize;     // size of the json file this was compiled from
+        uint32_t checksumSize; // length of the checksum at the start of the pool
+        uint32_t itemCount;
+        uint32_t locationCount;
+        uint32_t reserved;
+        uint64_t poolSize;
+    };
+
+    struct FileEntry {
+        int64_t id;
+        uint32_t offset; // into the string pool
+        uint32_t size;
+    };
+
+    static_assert(sizeof(FileHeader) == 40, "unexpected FileHeader padding");
+    static_assert(sizeof(FileEntry) == 16, "unexpected FileEntry padding");
+
+    /// Read-only view of a whole file. Memory-mapped where supported.
+    class MappedFile final
+    {
+    public:
+        explicit MappedFile(const path& p)
+        {
+#if defined WIN32 || defined _WIN32
+#ifdef NO_STD_FILESYSTEM
+            std::ifstream f(p.c_str(), std::ios::binary);
+#else
+            std::ifstream f(p, std::ios::binary);
+#endif
+            if (!f)
+                return;
+            _buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+            _data = _buffer.data();
+            _size = _buffer.size();
+#else
+            int fd = open(p.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED) {
+                    _data = (const char*)map;
+                    _size = (size_t)st.st_size;
+                }
+            }
+            close(fd);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#if !defined WIN32 && !defined _WIN32
+            if (_data)
+                munmap((void*)_data, _size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const
+        {
+            return _data;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+    private:
+        const char* _data = nullptr;
+        size_t _size = 0;
+#if defined WIN32 || defined _WIN32
+        std::vector<char> _buffer;
+#endif
+    };
+
+    static void collect_names(const json& data, const char* key, std::vector<std::pair<int64_t, std::string>>& out)
+    {
+        out.clear();
+        auto it = data.find(key);
+        if (it == data.end() || !it->is_object())
+            return;
+        out.reserve(it->size());
+        for (const auto& pair: it->items())
+            out.emplace_back(pair.value().get<int64_t>(), pair.key());
+        std::sort(out.begin(), out.end());
+    }
+
+    static void names_from_json(const json& data, APDataPackageNames& names)
+    {
+        auto it = data.find("checksum");
+        names.checksum = (it != data.end() && it->is_string()) ? it->get<std::string>() : "";
+        collect_names(data, "item_name_to_id", names.items);
+        collect_names(data, "location_name_to_id", names.locations);
+    }
+
+    static bool read_entries(const char* src, uint32_t count, const char* pool, uint64_t poolSize,
+                             std::vector<std::pair<int64_t, std::string>>& out)
+    {
+        out.clear();
+        out.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            FileEntry entry;
+            memcpy(&entry, src + i * sizeof(FileEntry), sizeof(FileEntry));
+            if ((uint64_t)entry.offset + entry.size > poolSize)
+                return false;
+            out.emplace_back(entry.id, std::string(pool + entry.offset, entry.size));
+        }
+        return true;
+    }
+
+    bool read_compiled(const path& binPath, const std::string& checksum, uint64_t jsonSize,
+                       APDataPackageNames& names, uint64_t& fileSize) const
+    {
+        MappedFile file(binPath);
+        if (!file.data() || file.size() < sizeof(FileHeader))
+            return false;
+        fileSize = file.size();
+
+        FileHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, "APDP", 4) != 0 || header.format != FORMAT_VERSION || header.jsonSize != jsonSize)
+            return false;
+        uint64_t entriesSize = ((uint64_t)header.itemCount + header.locationCount) * sizeof(FileEntry);
+        if (file.size() != sizeof(FileHeader) + entriesSize + header.poolSize || header.checksumSize > header.poolSize)
+            return false;
+
+        const char* entries = file.data() + sizeof(FileHeader);
+        const char* pool = entries + entriesSize;
+        if (checksum.size() != header.checksumSize || memcmp(pool, checksum.data(), checksum.size()) != 0)
+            return false;
+
+        names.checksum = checksum;
+        return read_entries(entries, header.itemCount, pool, header.poolSize, names.items)
+            && read_entries(entries + header.itemCount * sizeof(FileEntry), header.locationCount,
+                            pool, header.poolSize, names.locations);
+    }
+
+    static void append_entries(const std::vector<std::pair<int64_t, std::string>>& names,
+                               std::string& entries, std::string& pool)
+    {
+        for (const auto& pair: names) {
+            FileEntry entry;
+            entry.id = pair.first;
+            entry.offset = (uint32_t)pool.size();
+            entry.size = (uint32_t)pair.second.size();
+            entries.append((const char*)&entry, sizeof(entry));
+            pool += pair.second;
+        }
+    }
+
+    bool compile(const std::string& game, const std::string& checksum, const json& data)
+    {
+        auto jsonPath = get_path(game, checksum);
+        auto binPath = get_path(game, checksum, compiled_ext());
+        auto tmpPath = get_path(game, checksum, std::string(compiled_ext()) + ".tmp");
+        FileHeader header;
+        if (jsonPath.empty() || binPath.empty() || !get_file_size(jsonPath, header.jsonSize))
+            return false;
+
+        APDataPackageNames names;
+        names_from_json(data, names);
+        std::string entries;
+        std::string pool = checksum;
+        entries.reserve((names.items.size() + names.locations.size()) * sizeof(FileEntry));
+        append_entries(names.items, entries, pool);
+        append_entries(names.locations, entries, pool);
+        if (pool.size() > UINT32_MAX)
+            return false;
+
+        memcpy(header.magic, "APDP", 4);
+        header.format = FORMAT_VERSION;
+        header.checksumSize = (uint32_t)checksum.size();
+        header.itemCount = (uint32_t)names.items.size();
+        header.locationCount = (uint32_t)names.locations.size();
+        header.reserved = 0;
+        header.poolSize = pool.size();
+
+        try {
+            {
+#ifdef NO_STD_FILESYSTEM
+                std::ofstream f(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+#else
+                std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+#endif
+                f.write((const char*)&header, sizeof(header));
+                f.write(entries.data(), (std::streamsize)entries.size());
+                f.write(pool.data(), (std::streamsize)pool.size());
+                if (!f)
+                    return false;
+                _bytesWritten += sizeof(header) + entries.size() + pool.size();
+            }
+            // replace atomically so a concurrent reader never sees a partial file
+#ifndef NO_STD_FILESYSTEM
+            std::error_code ec;
+            std::filesystem::rename(tmpPath, binPath, ec);
+            return !ec;
+#elif defined WIN32 || defined _WIN32
+            _wremove(binPath.c_str());
+            return _wrename(tmpPath.c_str(), binPath.c_str()) == 0;
+#else
+            return rename(tmpPath.c_str(), binPath.c_str()) == 0;
+#endif
+        } catch (const std::exception& ex) {
+            log(ex.what());
+            return false;
+        }
+    }
+};
+
+#endif // _COMPILEDDATAPACKAGESTORE_HPP
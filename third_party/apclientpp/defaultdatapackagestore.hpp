@@ -12,15 +12,25 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #include "apclient.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include <time.h>
 
 #if defined WIN32 || defined _WIN32
 #include <shlobj.h>
+#include <sys/stat.h>
 #include <sys/utime.h>
 #else
+#include <sys/stat.h>
 #include <utime.h>
 #endif
 
@@ -54,7 +64,19 @@ public:
     typedef char TCHAR;
     static const char CSLASH = '/';
 #endif
-private:
+
+    struct CacheStats {
+        uint64_t hits = 0;         ///< successful loads
+        uint64_t misses = 0;       ///< loads of files that are missing or invalid
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t evictedFiles = 0;
+        uint64_t evictedBytes = 0;
+        uint64_t cacheFiles = 0;   ///< as of the last evict()
+        uint64_t cacheBytes = 0;   ///< as of the last evict()
+    };
+
+protected:
 
     typedef nlohmann::json json;
 #ifndef NO_STD_FILESYSTEM
@@ -188,6 +210,106 @@ done:
 #endif
 
     path _path;
+    uint64_t _maxCacheBytes = 0;
+    std::chrono::seconds _maxCacheAge{0};
+
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+    std::atomic<uint64_t> _bytesRead{0};
+    std::atomic<uint64_t> _bytesWritten{0};
+    std::atomic<uint64_t> _evictedFiles{0};
+    std::atomic<uint64_t> _evictedBytes{0};
+    std::atomic<uint64_t> _cacheFiles{0};
+    std::atomic<uint64_t> _cacheBytes{0};
+
+    void count_hit(uint64_t bytes)
+    {
+        _hits++;
+        _bytesRead += bytes;
+    }
+
+    void count_miss()
+    {
+        _misses++;
+    }
+
+    static bool get_file_size(const path& p, uint64_t& size)
+    {
+#if defined WIN32 || defined _WIN32
+        struct __stat64 st;
+        if (_wstat64(p.c_str(), &st) != 0)
+            return false;
+#else
+        struct stat st;
+        if (stat(p.c_str(), &st) != 0)
+            return false;
+#endif
+        size = (uint64_t)st.st_size;
+        return true;
+    }
+
+    // Entries saved by this store, which evict() may remove: "<game>/<checksum>" or "<game>",
+    // one per line in owned_path(). Guarded by _mutex.
+    std::recursive_mutex _mutex; // derived stores hold it across save() and their own files
+    std::set<std::string> _owned;
+    bool _ownedLoaded = false;
+
+    path owned_path() const
+    {
+        return _path / "apclientpp-owned.txt";
+    }
+
+    static std::string entry_key(const std::string& game, const std::string& checksum)
+    {
+        std::string key;
+        const std::string exclude = "<>:\"/\\|?*"; // same as get_path()
+        std::copy_if(game.begin(), game.end(), std::back_inserter(key),
+                     [&](char c) { return exclude.find(c) == std::string::npos; });
+        if (!checksum.empty())
+            key += "/" + checksum;
+        return key;
+    }
+
+    void load_owned()
+    {
+        if (_ownedLoaded)
+            return;
+        _ownedLoaded = true;
+#ifdef NO_STD_FILESYSTEM
+        std::ifstream f(owned_path().c_str());
+#else
+        std::ifstream f(owned_path());
+#endif
+        std::string line;
+        while (std::getline(f, line)) {
+            if (!line.empty())
+                _owned.insert(line);
+        }
+    }
+
+    void add_owned(const std::string& key)
+    {
+        load_owned();
+        if (!_owned.insert(key).second)
+            return;
+#ifdef NO_STD_FILESYSTEM
+        std::ofstream f(owned_path().c_str(), std::ios::app);
+#else
+        std::ofstream f(owned_path(), std::ios::app);
+#endif
+        f << key << "\n";
+    }
+
+    void save_owned()
+    {
+#ifdef NO_STD_FILESYSTEM
+        std::ofstream f(owned_path().c_str(), std::ios::trunc);
+#else
+        std::ofstream f(owned_path(), std::ios::trunc);
+#endif
+        for (const auto& key: _owned)
+            f << key << "\n";
+    }
 
 
     void log(const char* msg)
@@ -195,7 +317,7 @@ done:
         printf("APClient: %s\n", msg);
     }
 
-    path get_path(const std::string& game, const std::string& checksum) const
+    path get_path(const std::string& game, const std::string& checksum, const std::string& ext = ".json") const
     {
         std::string safe_game, safe_checksum;
         const std::string exclude = "<>:\"/\\|?*";
@@ -206,8 +328,8 @@ done:
         if (safe_game.empty() || safe_checksum != checksum)
             return {}; // invalid
         if (checksum.empty())
-            return _path / (safe_game + ".json");
-        return (_path / safe_game) / (safe_checksum + ".json");
+            return _path / (safe_game + ext);
+        return (_path / safe_game) / (safe_checksum + ext);
     }
 
     static void touch(const path& filename)
@@ -274,12 +396,18 @@ public:
 #else
             std::ifstream f(p, std::ios::binary);
 #endif
-            if (f.fail() || f.eof())
+            if (f.fail() || f.eof()) {
+                count_miss();
                 return false;
+            }
+            uint64_t size = 0;
+            get_file_size(p, size); // tellg() after parsing to EOF would return -1
             data = json::parse(f);
+            count_hit(size);
             touch(p); // update file time to keep it in cache
             return true;
         } catch (const std::exception& ex) {
+            count_miss();
             log(("Failed to load " + p.string() + ":").c_str());
             log(ex.what());
             return false;
@@ -303,6 +431,8 @@ public:
         if (p.empty())
             return false;
 
+        // evict() must not remove the game folder between creating it and writing the file
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::error_code ec;
         create_directories(p.parent_path(), ec);
         if (ec) {
@@ -316,13 +446,168 @@ public:
 #else
             std::ofstream f(p, std::ios::binary);
 #endif
-            f << data.dump();
+            auto dump = data.dump();
+            f << dump;
+            _bytesWritten += dump.size();
+            add_owned(entry_key(game, it == data.end() ? "" : it->get<std::string>()));
             return true;
         } catch (const std::exception& ex) {
             log(ex.what());
             return false;
         }
     }
+
+    /// Limit the size and age of the on-disk cache for evict(). 0 disables the respective limit.
+    void set_cache_budget(uint64_t maxBytes, std::chrono::seconds maxAge)
+    {
+        _maxCacheBytes = maxBytes;
+        _maxCacheAge = maxAge;
+    }
+
+    CacheStats get_stats() const
+    {
+        CacheStats stats;
+        stats.hits = _hits;
+        stats.misses = _misses;
+        stats.bytesRead = _bytesRead;
+        stats.bytesWritten = _bytesWritten;
+        stats.evictedFiles = _evictedFiles;
+        stats.evictedBytes = _evictedBytes;
+        stats.cacheFiles = _cacheFiles;
+        stats.cacheBytes = _cacheBytes;
+        return stats;
+    }
+
+    /**
+     * Apply the cache budget: drop entries older than the max age, then the least recently used entries (by file
+     * time, which load() updates) until the cache fits the max size. Files that share a name but not the extension
+     * (i.e. `<checksum>.json` and derived files) are one entry. Derived files without json, leftover temp files and
+     * empty game folders are removed as well.
+     * The folder is shared with other Archipelago clients: only entries this store saved (listed in the owned
+     * file, see add_owned()) are removed or counted, and folders changed in the last minute are left alone.
+     * This scans the whole cache folder, so call it off the hot path. Returns false if not supported.
+     */
+    bool evict()
+    {
+#ifdef NO_STD_FILESYSTEM
+        return false;
+#else
+        namespace fs = std::filesystem;
+        struct Entry {
+            std::vector<fs::path> files;
+            uint64_t size = 0;
+            fs::file_time_type time = fs::file_time_type::min();
+            bool hasJson = false;
+        };
+
+        std::lock_guard<std::recursive_mutex> lock(_mutex); // same as save()
+        std::error_code ec;
+        if (!fs::is_directory(_path, ec))
+            return true;
+        load_owned();
+
+        auto now = fs::file_time_type::clock::now();
+        std::map<fs::path, Entry> entries;
+        std::vector<fs::path> dirs;
+        for (fs::recursive_directory_iterator it(_path, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec)) {
+                dirs.push_back(it->path());
+                continue;
+            }
+            if (!it->is_regular_file(ec) || it->path() == owned_path())
+                continue;
+            auto key = it->path();
+            const bool tmp = key.extension() == ".tmp";
+            if (tmp)
+                key.replace_extension(); // <checksum>.apdp.tmp
+            key.replace_extension();
+            if (!_owned.count(key.lexically_relative(_path).generic_string()))
+                continue; // another client's
+            auto size = it->file_size(ec);
+            auto time = it->last_write_time(ec);
+            if (ec)
+                continue;
+            if (tmp) {
+                // write was interrupted
+                if (now - time > std::chrono::hours(1))
+                    remove_cache_file(it->path(), size);
+                continue;
+            }
+            auto& entry = entries[key];
+            entry.files.push_back(it->path());
+            entry.size += size;
+            entry.time = std::max(entry.time, time);
+            entry.hasJson |= it->path().extension() == ".json";
+        }
+
+        std::vector<std::pair<fs::file_time_type, const Entry*>> lru;
+        uint64_t totalFiles = 0;
+        uint64_t totalBytes = 0;
+        for (const auto& pair: entries) {
+            const auto& entry = pair.second;
+            bool expired = _maxCacheAge.count() > 0 && now - entry.time > _maxCacheAge;
+            if (!entry.hasJson || expired) {
+                for (const auto& file: entry.files)
+                    remove_cache_file(file, 0);
+                _evictedBytes += entry.size;
+                continue;
+            }
+            lru.emplace_back(entry.time, &entry);
+            totalFiles += entry.files.size();
+            totalBytes += entry.size;
+        }
+
+        if (_maxCacheBytes > 0 && totalBytes > _maxCacheBytes) {
+            std::sort(lru.begin(), lru.end(), [](const std::pair<fs::file_time_type, const Entry*>& a,
+                                                 const std::pair<fs::file_time_type, const Entry*>& b) {
+                return a.first < b.first;
+            });
+            for (const auto& pair: lru) {
+                if (totalBytes <= _maxCacheBytes)
+                    break;
+                for (const auto& file: pair.second->files)
+                    remove_cache_file(file, 0);
+                _evictedBytes += pair.second->size;
+                totalFiles -= pair.second->files.size();
+                totalBytes -= pair.second->size;
+            }
+        }
+
+        // deepest first, fails for folders that are not empty
+        std::sort(dirs.begin(), dirs.end(), [](const fs::path& a, const fs::path& b) {
+            return a.native().size() > b.native().size();
+        });
+        for (const auto& dir: dirs) {
+            auto time = fs::last_write_time(dir, ec);
+            if (!ec && now - time > std::chrono::minutes(1))
+                fs::remove(dir, ec);
+        }
+        // entries gone from disk, by us or by hand, are not ours to track anymore
+        for (auto it = _owned.begin(); it != _owned.end();) {
+            if (!fs::exists(_path / (*it + ".json"), ec))
+                it = _owned.erase(it);
+            else
+                ++it;
+        }
+        save_owned();
+
+        _cacheFiles = totalFiles;
+        _cacheBytes = totalBytes;
+        return true;
+#endif
+    }
+
+protected:
+#ifndef NO_STD_FILESYSTEM
+    void remove_cache_file(const path& p, uint64_t size)
+    {
+        std::error_code ec;
+        if (std::filesystem::remove(p, ec)) {
+            _evictedFiles++;
+            _evictedBytes += size;
+        }
+    }
+#endif
 };
 
 
@@ -0,0 +1,206 @@
+#ifndef _LOCATIONSET_HPP
+#define _LOCATIONSET_HPP
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+
+/**
+ * Set of location ids stored as a bitset over a known, sorted universe of locations.
+ *
+ * The universe is usually `checked_locations` + `missing_locations` of the slot. Membership of ids in the universe
+ * is one bit, and for a contiguous universe (the usual case) finding the bit is O(1); otherwise it is a binary
+ * search. Ids outside of the universe are still accepted and kept in a small sorted overflow set, so the set
+ * behaves like a `std::set<int64_t>` before the universe is known.
+ */
+class LocationSet final
+{
+public:
+    LocationSet() = default;
+
+    /// Set the universe of locations. Current members are kept.
+    void set_universe(std::vector<int64_t> universe)
+    {
+        std::vector<int64_t> members = to_vector();
+        std::sort(universe.begin(), universe.end());
+        universe.erase(std::unique(universe.begin(), universe.end()), universe.end());
+        _universe = std::move(universe);
+        _contiguous = _universe.empty() || (uint64_t)(_universe.back() - _universe.front()) + 1 == _universe.size();
+        _bits.assign((_universe.size() + 63) / 64, 0);
+        _count = 0;
+        _overflow.clear();
+        for (int64_t id: members)
+            insert(id);
+    }
+
+    const std::vector<int64_t>& universe() const
+    {
+        return _universe;
+    }
+
+    /// Returns true if id was added, false if it already was a member
+    bool insert(int64_t id)
+    {
+        ptrdiff_t pos = position(id);
+        if (pos < 0)
+            return _overflow.insert(id).second;
+        uint64_t& word = _bits[(size_t)pos / 64];
+        uint64_t mask = (uint64_t)1 << ((size_t)pos % 64);
+        if (word & mask)
+            return false;
+        word |= mask;
+        _count++;
+        return true;
+    }
+
+    /// Returns true if id was removed, false if it was not a member
+    bool erase(int64_t id)
+    {
+        ptrdiff_t pos = position(id);
+        if (pos < 0)
+            return _overflow.erase(id) > 0;
+        uint64_t& word = _bits[(size_t)pos / 64];
+        uint64_t mask = (uint64_t)1 << ((size_t)pos % 64);
+        if (!(word & mask))
+            return false;
+        word &= ~mask;
+        _count--;
+        return true;
+    }
+
+    bool contains(int64_t id) const
+    {
+        ptrdiff_t pos = position(id);
+        if (pos < 0)
+            return _overflow.count(id) > 0;
+        return (_bits[(size_t)pos / 64] >> ((size_t)pos % 64)) & 1;
+    }
+
+    size_t count(int64_t id) const
+    {
+        return contains(id) ? 1 : 0;
+    }
+
+    size_t size() const
+    {
+        return _count + _overflow.size();
+    }
+
+    /// Number of members that are part of the universe, i.e. progress out of universe().size()
+    size_t size_in_universe() const
+    {
+        return _count;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /// Estimated heap bytes used, for memory reports
+    size_t memory_bytes() const
+    {
+        return _universe.capacity() * sizeof(int64_t) + _bits.capacity() * sizeof(uint64_t)
+               + _overflow.size() * (sizeof(int64_t) + 4 * sizeof(void*));
+    }
+
+    void clear()
+    {
+        std::fill(_bits.begin(), _bits.end(), 0);
+        _count = 0;
+        _overflow.clear();
+    }
+
+    /// Call f(id) for each member in ascending order
+    template<class F>
+    void for_each(F f) const
+    {
+        auto itOverflow = _overflow.begin();
+        for (size_t w = 0; w < _bits.size(); w++) {
+            uint64_t word = _bits[w];
+            while (word) {
+                int64_t id = _universe[w * 64 + ctz(word)];
+                for (; itOverflow != _overflow.end() && *itOverflow < id; ++itOverflow)
+                    f(*itOverflow);
+                f(id);
+                word &= word - 1;
+            }
+        }
+        for (; itOverflow != _overflow.end(); ++itOverflow)
+            f(*itOverflow);
+    }
+
+    std::vector<int64_t> to_vector() const
+    {
+        std::vector<int64_t> res;
+        res.reserve(size());
+        for_each([&res](int64_t id) { res.push_back(id); });
+        return res;
+    }
+
+    std::set<int64_t> to_set() const
+    {
+        std::set<int64_t> res;
+        for_each([&res](int64_t id) { res.emplace_hint(res.end(), id); });
+        return res;
+    }
+
+    /// Members as runs of consecutive ids: pairs of first id and length
+    std::vector<std::pair<int64_t, int64_t>> runs() const
+    {
+        std::vector<std::pair<int64_t, int64_t>> res;
+        for_each([&res](int64_t id) {
+            if (!res.empty() && res.back().first + res.back().second == id)
+                res.back().second++;
+            else
+                res.emplace_back(id, 1);
+        });
+        return res;
+    }
+
+private:
+    /// Position of id in the universe or -1
+    ptrdiff_t position(int64_t id) const
+    {
+        if (_universe.empty() || id < _universe.front() || id > _universe.back())
+            return -1;
+        if (_contiguous)
+            return (ptrdiff_t)(id - _universe.front());
+        auto it = std::lower_bound(_universe.begin(), _universe.end(), id);
+        if (*it != id)
+            return -1;
+        return it - _universe.begin();
+    }
+
+    static size_t ctz(uint64_t word)
+    {
+#if defined __GNUC__ || defined __clang__
+        return (size_t)__builtin_ctzll(word);
+#elif defined _MSC_VER && defined _M_X64
+        unsigned long n;
+        _BitScanForward64(&n, word);
+        return n;
+#else
+        size_t n = 0;
+        for (; !(word & 1); word >>= 1)
+            n++;
+        return n;
+#endif
+    }
+
+    std::vector<int64_t> _universe; // sorted, unique
+    bool _contiguous = true;
+    std::vector<uint64_t> _bits;    // one bit per position in _universe
+    size_t _count = 0;              // number of set bits
+    std::set<int64_t> _overflow;    // members that are not in _universe
+};
+
+#endif // _LOCATIONSET_HPP
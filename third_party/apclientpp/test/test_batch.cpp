@@ -0,0 +1,208 @@
+// Checks batched with set_batch_commands(true) must survive the socket closing before flush().
+
+#include <apclient.hpp>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <websocketpp/server.hpp>
+#include <websocketpp/config/asio_no_tls.hpp>
+
+#define usleep(usec) std::this_thread::sleep_for(std::chrono::microseconds(usec))
+
+typedef websocketpp::server<websocketpp::config::asio> Server;
+
+class TestServer final {
+public:
+    explicit TestServer(const uint16_t preferredPort, const uint16_t maxPort=0)
+        : port(preferredPort), maxPort(maxPort == 0 ? preferredPort : maxPort)
+    {
+        server.set_error_channels(websocketpp::log::elevel::fatal);
+        server.set_access_channels(websocketpp::log::alevel::none);
+        server.init_asio();
+
+        server.set_open_handler([this](const websocketpp::connection_hdl& hdl){on_open(hdl);});
+        server.set_message_handler([this](const websocketpp::connection_hdl& hdl, const Server::message_ptr& msg){
+            on_message(hdl, msg);
+        });
+    }
+
+    ~TestServer()
+    {
+        try {
+            if (running)
+                stop();
+        } catch (...) {}
+    }
+
+    void run()
+    {
+        running = true;
+        while (true) {
+            try {
+                server.listen(port);
+                break;
+            } catch (const websocketpp::exception&) {
+                if (port == maxPort)
+                    throw;
+                port += 1;
+            }
+        }
+        server.start_accept();
+        server.run();
+    }
+
+    void stop()
+    {
+        server.stop_listening();
+        server.stop();
+        running = false;
+    }
+
+    bool is_listening() const
+    {
+        return server.is_listening();
+    }
+
+    uint16_t get_port() const
+    {
+        return port;
+    }
+
+    std::set<int64_t> get_checks()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return checks;
+    }
+
+private:
+    Server server;
+    uint16_t port;
+    uint16_t maxPort;
+    bool running = false;
+    std::mutex mutex;
+    std::set<int64_t> checks;
+
+    void on_open(const websocketpp::connection_hdl& hdl)
+    {
+        const std::string roomInfo = R""""(
+[{
+    "cmd": "RoomInfo",
+    "seed_name": "seed_name",
+    "time": 0,
+    "version": {"major": 0, "minor": 6, "build": 3, "class": "Version"}
+}]
+)"""";
+        server.send(hdl, roomInfo, websocketpp::frame::opcode::text);
+    }
+
+    void on_message(const websocketpp::connection_hdl& hdl, const Server::message_ptr& msg)
+    {
+        const std::string connected = R""""(
+[{
+    "cmd": "Connected",
+    "team": 0,
+    "slot": 1,
+    "players": [],
+    "missing_locations": [1, 2, 3],
+    "checked_locations": [],
+    "slot_data": {},
+    "slot_info": {},
+    "hint_points": 0
+}]
+)"""";
+        for (const auto& command: nlohmann::json::parse(msg->get_payload())) {
+            const std::string cmd = command["cmd"];
+            if (cmd == "Connect") {
+                server.send(hdl, connected, websocketpp::frame::opcode::text);
+            } else if (cmd == "LocationChecks") {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto& location: command["locations"])
+                    checks.insert(location.get<int64_t>());
+            } else if (cmd == "Say") {
+                // drop the connection without a close handshake, like a network failure
+                server.get_con_from_hdl(hdl)->get_raw_socket().close();
+            }
+        }
+    }
+};
+
+int main(int, char**)
+{
+    printf("Starting server...\n");
+    TestServer server{38292, 38302};
+    std::thread serverThread(&TestServer::run, &server);
+    for (int i=0; i<10; i++) {
+        usleep(2000); // wait for the server to be running before starting client
+        if (server.is_listening())
+            break;
+    }
+    if (!server.is_listening())
+        throw std::runtime_error("Timeout starting server");
+    printf("Server listening on %d\n", static_cast<int>(server.get_port()));
+
+    bool slotConnected = false;
+    int disconnects = 0;
+    size_t batched = 0;
+    std::set<int64_t> checks;
+    {
+        const std::string uri = "ws://localhost:" + std::to_string(server.get_port());
+
+        printf("Starting client for %s...\n", uri.c_str());
+        APClient ap{"", "", uri};
+        ap.set_batch_commands(true);
+        ap.set_reconnect_backoff(50, 50, 0);
+        ap.set_room_info_handler([&ap]() {
+            ap.ConnectSlot("Player1", "", 0b111);
+        });
+        ap.set_slot_connected_handler([&slotConnected](const nlohmann::json&) {
+            slotConnected = true;
+        });
+        ap.set_socket_disconnected_handler([&disconnects]() {
+            disconnects++;
+        });
+        for (int i = 0; i < 10000 && !slotConnected; ++i) {
+            ap.poll();
+            usleep(100);
+        }
+
+        if (slotConnected) {
+            ap.Say("drop");
+            ap.flush();
+            usleep(100000); // the server has closed the socket, the client didn't notice yet
+            ap.LocationChecks({1, 2});
+            batched = ap.get_batch_size();
+            for (int i = 0; i < 50000; ++i) {
+                ap.poll();
+                checks = server.get_checks();
+                if (checks.size() == 2)
+                    break;
+                usleep(100);
+            }
+        }
+        printf("Stopping client...\n");
+    }
+
+    printf("Stopping server...\n");
+    server.stop();
+    serverThread.join();
+
+    if (!slotConnected) {
+        fprintf(stderr, "FAIL: Could not connect slot\n");
+        return 1;
+    }
+    if (batched != 1) {
+        fprintf(stderr, "FAIL: LocationChecks was not batched\n");
+        return 1;
+    }
+    if (disconnects == 0) {
+        fprintf(stderr, "FAIL: Socket was not closed\n");
+        return 1;
+    }
+    if (checks != std::set<int64_t>{1, 2}) {
+        fprintf(stderr, "FAIL: Batched checks were not sent after reconnecting\n");
+        return 1;
+    }
+    return 0;
+}
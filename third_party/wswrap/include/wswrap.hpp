@@ -2,7 +2,22 @@
 #ifndef _WSWRAP_HPP
 #define _WSWRAP_HPP
 
-#define WSWRAP_VERSION 10300  // 1.03.00
+#define WSWRAP_VERSION 10400  // 1.04.00
+
+#include <stdint.h>
+
+
+namespace wswrap {
+
+    /// permessage-deflate settings of a connection. Ignored in the browser, which picks its own.
+    struct compression_options {
+        bool enabled = true;                     // offer permessage-deflate at all
+        uint8_t server_max_window_bits = 15;     // ask the server to compress with a window of at most 2^n (9..15)
+        uint8_t client_max_window_bits = 15;     // offer to compress outgoing messages with a window of at most 2^n (9..15)
+        bool client_no_context_takeover = false; // offer to compress every outgoing message on its own
+    };
+
+}; // namespace wswrap
 
 #ifdef __EMSCRIPTEN__
 #include "wswrap_wsjs.hpp"
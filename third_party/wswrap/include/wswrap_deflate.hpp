@@ -0,0 +1,184 @@
+// zlib codec for permessage-deflate (RFC 7692) with tunable window and memory settings
+#ifndef _WSWRAP_DEFLATE_HPP
+#define _WSWRAP_DEFLATE_HPP
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <zlib.h>
+
+
+namespace wswrap {
+
+    /**
+     * One connection's compressor and decompressor.
+     * Same contract as websocketpp's permessage_deflate::enabled: compress() output still ends in 00 00 ff ff
+     * and decompress() expects the caller to feed that trailer at the end of a message; the hybi13 processor does
+     * both. zlib's allocations are counted, see memory_usage() and total_memory_usage().
+     */
+    class deflate_codec final {
+    public:
+        deflate_codec()
+        {
+        }
+
+        ~deflate_codec()
+        {
+            close();
+        }
+
+        deflate_codec(const deflate_codec&) = delete;
+        deflate_codec& operator=(const deflate_codec&) = delete;
+
+        /// deflate_bits, inflate_bits: window of 2^n bytes (9..15), mem_level: 1..9
+        bool init(int deflate_bits, int inflate_bits, int mem_level, bool no_context_takeover)
+        {
+            close();
+            memset(&_dstate, 0, sizeof(_dstate));
+            _dstate.zalloc = &zalloc;
+            _dstate.zfree = &zfree;
+            _dstate.opaque = this;
+            // raw deflate does not support a window of 2^8
+            if (deflateInit2(&_dstate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -clamp(deflate_bits, 9, 15),
+                             clamp(mem_level, 1, 9), Z_DEFAULT_STRATEGY) != Z_OK)
+                return false;
+            _deflate_init = true;
+
+            memset(&_istate, 0, sizeof(_istate));
+            _istate.zalloc = &zalloc;
+            _istate.zfree = &zfree;
+            _istate.opaque = this;
+            if (inflateInit2(&_istate, -clamp(inflate_bits, 8, 15)) != Z_OK) {
+                close();
+                return false;
+            }
+            _inflate_init = true;
+
+            _flush = no_context_takeover ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+            _buffer.reset(new unsigned char[BUFFER_SIZE]);
+            total() += BUFFER_SIZE;
+            return true;
+        }
+
+        bool is_initialized() const
+        {
+            return _deflate_init && _inflate_init;
+        }
+
+        bool compress(const std::string& in, std::string& out)
+        {
+            if (!_deflate_init)
+                return false;
+            if (in.empty()) {
+                static const unsigned char empty[6] = {0x02, 0x00, 0x00, 0x00, 0xff, 0xff};
+                out.append((const char*)empty, sizeof(empty));
+                return true;
+            }
+            _dstate.next_in = (Bytef*)in.data();
+            _dstate.avail_in = (uInt)in.size();
+            do {
+                _dstate.next_out = _buffer.get();
+                _dstate.avail_out = BUFFER_SIZE;
+                if (deflate(&_dstate, _flush) == Z_STREAM_ERROR)
+                    return false;
+                out.append((const char*)_buffer.get(), BUFFER_SIZE - _dstate.avail_out);
+            } while (_dstate.avail_out == 0);
+            return true;
+        }
+
+        bool decompress(const uint8_t* buf, size_t len, std::string& out)
+        {
+            if (!_inflate_init)
+                return false;
+            _istate.next_in = (Bytef*)buf;
+            _istate.avail_in = (uInt)len;
+            do {
+                _istate.next_out = _buffer.get();
+                _istate.avail_out = BUFFER_SIZE;
+                int ret = inflate(&_istate, Z_SYNC_FLUSH);
+                if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR || ret == Z_STREAM_ERROR)
+                    return false;
+                out.append((const char*)_buffer.get(), BUFFER_SIZE - _istate.avail_out);
+            } while (_istate.avail_out == 0);
+            return true;
+        }
+
+        /// Bytes currently held by zlib and the i/o buffer. zlib allocates the inflate window on first use.
+        size_t memory_usage() const
+        {
+            return _zlib_bytes + (_buffer ? BUFFER_SIZE : 0);
+        }
+
+        /// Sum of memory_usage() of all codecs in the process
+        static size_t total_memory_usage()
+        {
+            return total();
+        }
+
+    private:
+        static constexpr uInt BUFFER_SIZE = 16384;
+        static constexpr size_t ALLOC_HEADER = 16; // keeps malloc's alignment
+
+        static std::atomic<size_t>& total()
+        {
+            static std::atomic<size_t> bytes{0};
+            return bytes;
+        }
+
+        static int clamp(int v, int lo, int hi)
+        {
+            return v < lo ? lo : v > hi ? hi : v;
+        }
+
+        static voidpf zalloc(voidpf opaque, uInt items, uInt size)
+        {
+            size_t n = (size_t)items * size;
+            char* p = (char*)malloc(n + ALLOC_HEADER);
+            if (!p)
+                return Z_NULL;
+            memcpy(p, &n, sizeof(n));
+            ((deflate_codec*)opaque)->_zlib_bytes += n;
+            total() += n;
+            return p + ALLOC_HEADER;
+        }
+
+        static void zfree(voidpf opaque, voidpf address)
+        {
+            if (!address)
+                return;
+            char* p = (char*)address - ALLOC_HEADER;
+            size_t n;
+            memcpy(&n, p, sizeof(n));
+            ((deflate_codec*)opaque)->_zlib_bytes -= n;
+            total() -= n;
+            free(p);
+        }
+
+        void close()
+        {
+            if (_deflate_init)
+                deflateEnd(&_dstate);
+            if (_inflate_init)
+                inflateEnd(&_istate);
+            _deflate_init = _inflate_init = false;
+            if (_buffer) {
+                total() -= BUFFER_SIZE;
+                _buffer.reset();
+            }
+        }
+
+        z_stream _dstate;
+        z_stream _istate;
+        bool _deflate_init = false;
+        bool _inflate_init = false;
+        int _flush = Z_SYNC_FLUSH;
+        size_t _zlib_bytes = 0;
+        std::unique_ptr<unsigned char[]> _buffer;
+    };
+
+}; // namespace wswrap
+
+#endif // _WSWRAP_DEFLATE_HPP
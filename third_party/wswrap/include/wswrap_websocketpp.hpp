@@ -29,6 +29,7 @@
 
 #ifndef WSWRAP_NO_COMPRESSION
 #include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#include "wswrap_deflate.hpp"
 #endif
 
 #include <websocketpp/client.hpp>
@@ -39,24 +40,194 @@
 #ifdef WSWRAP_ASYNC_CLEANUP
 #include <thread>
 #endif
+#ifdef WSWRAP_WITH_SSL
+#include <map>
+#include <mutex>
+#endif
 
 
 namespace wswrap {
 
+#ifdef WSWRAP_WITH_COMPRESSION
+    /**
+     * Client side permessage-deflate extension for websocketpp, same interface as permessage_deflate::enabled.
+     * websocketpp constructs it inside the connection's processor without arguments, so it has no options of its
+     * own: WS::connect() puts the offer built by make_offer() on the connection's handshake request, and
+     * negotiate() takes the windows from the server's response. The compressor's memLevel follows its window.
+     */
+    class deflate_extension {
+    public:
+        typedef std::pair<websocketpp::lib::error_code, std::string> err_str_pair;
+
+        /// Sec-WebSocket-Extensions offer for options, empty if compression is disabled
+        static std::string make_offer(const compression_options& options)
+        {
+            if (!options.enabled)
+                return "";
+            std::string offer = "permessage-deflate";
+            if (options.client_no_context_takeover)
+                offer += "; client_no_context_takeover";
+            if (options.server_max_window_bits < 15)
+                offer += "; server_max_window_bits=" + std::to_string(window_bits(options.server_max_window_bits));
+            if (options.client_max_window_bits < 15)
+                offer += "; client_max_window_bits=" + std::to_string(window_bits(options.client_max_window_bits));
+            else
+                offer += "; client_max_window_bits"; // we can compress with any window the server asks for
+            return offer;
+        }
+
+        bool is_implemented() const
+        {
+            return true;
+        }
+
+        bool is_enabled() const
+        {
+            return _enabled;
+        }
+
+        std::string generate_offer() const
+        {
+            return ""; // keeps the offer WS::connect() set on the request
+        }
+
+        websocketpp::lib::error_code validate_offer(websocketpp::http::attribute_list const&)
+        {
+            return websocketpp::lib::error_code();
+        }
+
+        /// Apply the server's response to our offer
+        err_str_pair negotiate(websocketpp::http::attribute_list const& response)
+        {
+            err_str_pair ret;
+            _deflate_bits = 15;
+            _inflate_bits = 15;
+            _no_context_takeover = false;
+            for (const auto& attribute: response) {
+                if (attribute.first == "server_no_context_takeover") {
+                    // nothing to do for the decompressor
+                } else if (attribute.first == "client_no_context_takeover") {
+                    _no_context_takeover = true;
+                } else if (attribute.first == "server_max_window_bits" || attribute.first == "client_max_window_bits") {
+                    int bits = atoi(attribute.second.c_str());
+                    if (bits < 8 || bits > 15) {
+                        ret.first = make_error_code(websocketpp::extensions::permessage_deflate::error::invalid_max_window_bits);
+                        return ret;
+                    }
+                    if (attribute.first == "server_max_window_bits")
+                        _inflate_bits = bits;
+                    else if (bits < _deflate_bits)
+                        _deflate_bits = bits;
+                } else {
+                    ret.first = make_error_code(websocketpp::extensions::permessage_deflate::error::unsupported_attributes);
+                    return ret;
+                }
+            }
+            _enabled = true;
+            return ret;
+        }
+
+        websocketpp::lib::error_code init(bool is_server)
+        {
+            if (is_server)
+                return make_error_code(websocketpp::extensions::permessage_deflate::error::general);
+            if (!_codec.init(_deflate_bits, _inflate_bits, _deflate_bits - 7, _no_context_takeover))
+                return make_error_code(websocketpp::extensions::permessage_deflate::error::zlib_error);
+            return websocketpp::lib::error_code();
+        }
+
+        websocketpp::lib::error_code compress(std::string const& in, std::string& out)
+        {
+            if (!_codec.is_initialized())
+                return make_error_code(websocketpp::extensions::permessage_deflate::error::uninitialized);
+            if (!_codec.compress(in, out))
+                return make_error_code(websocketpp::extensions::permessage_deflate::error::zlib_error);
+            return websocketpp::lib::error_code();
+        }
+
+        websocketpp::lib::error_code decompress(uint8_t const* buf, size_t len, std::string& out)
+        {
+            if (!_codec.is_initialized())
+                return make_error_code(websocketpp::extensions::permessage_deflate::error::uninitialized);
+            if (!_codec.decompress(buf, len, out))
+                return make_error_code(websocketpp::extensions::permessage_deflate::error::zlib_error);
+            return websocketpp::lib::error_code();
+        }
+
+    private:
+        static int window_bits(int bits)
+        {
+            return bits < 9 ? 9 : bits > 15 ? 15 : bits;
+        }
+
+        bool _enabled = false;
+        int _deflate_bits = 15;
+        int _inflate_bits = 15;
+        bool _no_context_takeover = false;
+        deflate_codec _codec;
+    };
+#endif
+
+#ifdef WSWRAP_WITH_SSL
+    /**
+     * Client TLS sessions of this process by host, so a reconnect can resume the session (session ticket)
+     * instead of doing a full handshake. Every WS has its own SSL context, so OpenSSL's own cache does not help.
+     */
+    class tls_session_cache final {
+    public:
+        /// Offer the last session of host on ssl, if there is one
+        static void resume(SSL* ssl, const std::string& host)
+        {
+            std::lock_guard<std::mutex> lock(instance()._mutex);
+            auto it = instance()._sessions.find(host);
+            if (it != instance()._sessions.end())
+                SSL_set_session(ssl, it->second);
+        }
+
+        /// SSL_CTX_sess_set_new_cb callback. Returns 1 if we took the reference to session.
+        static int on_new_session(SSL* ssl, SSL_SESSION* session)
+        {
+            const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+            if (!host)
+                return 0;
+            std::lock_guard<std::mutex> lock(instance()._mutex);
+            SSL_SESSION*& slot = instance()._sessions[host];
+            if (slot)
+                SSL_SESSION_free(slot);
+            slot = session;
+            return 1;
+        }
+
+    private:
+        tls_session_cache() = default;
+
+        ~tls_session_cache()
+        {
+            for (auto& pair: _sessions)
+                SSL_SESSION_free(pair.second);
+        }
+
+        static tls_session_cache& instance()
+        {
+            static tls_session_cache cache;
+            return cache;
+        }
+
+        std::mutex _mutex;
+        std::map<std::string, SSL_SESSION*> _sessions;
+    };
+#endif
+
     struct client_config: public websocketpp::config::asio_client {
 #ifdef WSWRAP_WITH_COMPRESSION
-        struct permessage_deflate_config {};
-        typedef websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config>
-            permessage_deflate_type;
+        typedef deflate_extension permessage_deflate_type;
 #endif
     };
 
 #ifdef WSWRAP_WITH_SSL
     struct tls_client_config: public websocketpp::config::asio_tls_client {
 #ifdef WSWRAP_WITH_COMPRESSION
-        struct permessage_deflate_config {};
-        typedef websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config>
-            permessage_deflate_type;
+        typedef deflate_extension permessage_deflate_type;
 #endif
     };
 #endif
@@ -87,16 +258,20 @@ namespace wswrap {
         typedef std::function<void(void)> onerror_handler;
         typedef std::function<void(const std::string&)> onerror_ex_handler;
         typedef std::function<void(const std::string&)> onmessage_handler;
+        typedef std::function<void(std::string&&)> onmessage_move_handler;
 
         WS(const std::string& uri_string, onopen_handler hopen, onclose_handler hclose, onmessage_handler hmessage,
-           onerror_handler herror=nullptr, const std::string& cert_store="")
-                : WS(uri_string, hopen, hclose, hmessage, [herror](const std::string&){herror();}, cert_store)
+           onerror_handler herror=nullptr, const std::string& cert_store="",
+           const compression_options& compression=compression_options())
+                : WS(uri_string, hopen, hclose, hmessage, [herror](const std::string&){herror();}, cert_store,
+                     compression)
         {
         }
 
         WS(const std::string& uri_string, onopen_handler hopen, onclose_handler hclose, onmessage_handler hmessage,
-           onerror_ex_handler herror=nullptr, const std::string& cert_store="")
-                : _hopen(hopen), _hclose(hclose), _hmessage(hmessage), _herror(herror)
+           onerror_ex_handler herror=nullptr, const std::string& cert_store="",
+           const compression_options& compression=compression_options())
+                : _hopen(hopen), _hclose(hclose), _hmessage(hmessage), _herror(herror), _compression(compression)
         {
             _service = new SERVICE();
             auto uri = websocketpp::uri(uri_string);
@@ -105,7 +280,7 @@ namespace wswrap {
 
             bool is_init;
             if (_secure)
-                is_init = init_wss(!is_localhost, cert_store);
+                is_init = init_wss(!is_localhost, cert_store, uri.get_host());
             else
                 is_init = init_ws();
 
@@ -132,6 +307,24 @@ namespace wswrap {
             return 1000;
         }
 
+        /// Bytes held by permessage-deflate (zlib and buffers) of all connections in the process, as counted by
+        /// deflate_codec
+        static size_t compression_memory_usage()
+        {
+            #ifdef WSWRAP_WITH_COMPRESSION
+            return deflate_codec::total_memory_usage();
+            #else
+            return 0;
+            #endif
+        }
+
+        /// Receive messages as owning string instead: the frame's payload buffer is handed over without copy.
+        /// Replaces hmessage while set.
+        void set_message_move_handler(onmessage_move_handler hmessage)
+        {
+            _hmessage_move = hmessage;
+        }
+
 #ifdef WSWRAP_SEND_EXCEPTIONS
         void send(const std::string& data)
         {
@@ -243,7 +436,9 @@ namespace wswrap {
             typedef typename T::Client::message_ptr message_ptr;
             client.set_message_handler([this] (websocketpp::connection_hdl, const message_ptr& msg) {
                 T* impl = (T*)_impl;
-                if (impl->second && _hmessage) _hmessage(msg->get_payload());
+                if (!impl->second) return;
+                if (_hmessage_move) _hmessage_move(std::move(msg->get_raw_payload()));
+                else if (_hmessage) _hmessage(msg->get_payload());
             });
             client.set_open_handler([this] (websocketpp::connection_hdl) {
                 T* impl = (T*)_impl;
@@ -296,7 +491,7 @@ namespace wswrap {
             return true;
         }
 
-        bool init_wss(bool validate_cert, const std::string& cert_store)
+        bool init_wss(bool validate_cert, const std::string& cert_store, const std::string& host)
         {
             #ifdef WSWRAP_WITH_SSL
             auto* impl = init<WSS_IMPL>();
@@ -304,6 +499,12 @@ namespace wswrap {
             if (!impl) return false;
             auto& client = impl->first;
 
+            client.set_socket_init_handler([host] (websocketpp::connection_hdl,
+                                                   asio::ssl::stream<asio::ip::tcp::socket>& socket) {
+                SSL_set_tlsext_host_name(socket.native_handle(), host.c_str()); // also the session cache key
+                tls_session_cache::resume(socket.native_handle(), host);
+            });
+
             std::string store_path = cert_store; // make a copy for capture
             client.set_tls_init_handler([this, validate_cert, store_path] (std::weak_ptr<void>) -> SSLContextPtr {
                 SSLContextPtr ctx = std::make_shared<SSLContext>(SSLContext::sslv23);
@@ -315,6 +516,10 @@ namespace wswrap {
                                  SSLContext::no_tlsv1_1 |
                                  SSLContext::single_dh_use, ec);
                 if (ec) warn("Error in ssl init: options: %s\n", ec.message().c_str());
+                // hand new sessions to tls_session_cache for the next connect to this host
+                SSL_CTX_set_session_cache_mode(ctx->native_handle(),
+                                               SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+                SSL_CTX_sess_set_new_cb(ctx->native_handle(), &tls_session_cache::on_new_session);
                 if (validate_cert) {
                     if (!store_path.empty()) {
                         ctx->load_verify_file(store_path, ec);
@@ -384,6 +589,11 @@ namespace wswrap {
                 #endif
                 return false;
             }
+            #ifdef WSWRAP_WITH_COMPRESSION
+            std::string offer = deflate_extension::make_offer(_compression);
+            if (!offer.empty())
+                conn->replace_header("Sec-WebSocket-Extensions", offer);
+            #endif
             if (!client.connect(conn)) {
                 #ifdef __cpp_exceptions
                 throw std::runtime_error("Connect failed");
@@ -539,7 +749,9 @@ namespace wswrap {
         onopen_handler _hopen;
         onclose_handler _hclose;
         onmessage_handler _hmessage;
+        onmessage_move_handler _hmessage_move;
         onerror_ex_handler _herror;
+        compression_options _compression;
 #ifndef __cpp_exceptions
         bool _connect_error = false;
         std::string _connect_error_message;
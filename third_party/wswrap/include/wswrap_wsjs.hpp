@@ -26,16 +26,21 @@ namespace wswrap {
         typedef std::function<void(void)> onerror_handler;
         typedef std::function<void(const std::string&)> onerror_ex_handler;
         typedef std::function<void(const std::string&)> onmessage_handler;
+        typedef std::function<void(std::string&&)> onmessage_move_handler;
 
         WS(const std::string& uri_string, onopen_handler hopen, onclose_handler hclose, onmessage_handler hmessage,
-           onerror_ex_handler herror=nullptr, const std::string& = "")
+           onerror_ex_handler herror=nullptr, const std::string& = "", const compression_options& = compression_options())
                 : WS(uri_string, hopen, hclose, hmessage, [herror](){herror("Unknown");})
         {
         }
 
-        WS(const std::string& uri, onopen_handler hopen, onclose_handler hclose, onmessage_handler hmessage, onerror_handler herror=nullptr, const std::string& = "")
+        WS(const std::string& uri, onopen_handler hopen, onclose_handler hclose, onmessage_handler hmessage, onerror_handler herror=nullptr, const std::string& = "",
+           const compression_options& = compression_options())
         {
-            _impl = new IMPL(uri, hopen, hclose, hmessage, herror);
+            _impl = new IMPL(uri, hopen, hclose, [this, hmessage](const std::string& msg) {
+                if (_hmessage_move) _hmessage_move(std::string(msg)); // JS strings have to be copied anyway
+                else if (hmessage) hmessage(msg);
+            }, herror);
         }
 
         virtual ~WS()
@@ -49,6 +54,18 @@ namespace wswrap {
             return _impl->get_ok_connect_interval();
         }
 
+        /// The browser does the compression, nothing to count
+        static size_t compression_memory_usage()
+        {
+            return 0;
+        }
+
+        /// Receive messages as owning string instead. Replaces hmessage while set.
+        void set_message_move_handler(onmessage_move_handler hmessage)
+        {
+            _hmessage_move = hmessage;
+        }
+
 #ifdef WSWRAP_SEND_EXCEPTIONS
         void send(const std::string& data)
         {
@@ -123,6 +140,7 @@ namespace wswrap {
 
         IMPL *_impl;
         SERVICE *_service;
+        onmessage_move_handler _hmessage_move;
     };
 
 }; // namespace wsrap